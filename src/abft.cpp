@@ -0,0 +1,182 @@
+// Copyright (c) 2024 Jaebaek Seo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "abft.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include "parallel.h"
+#include "tt_metal/common/bfloat16.hpp"
+#include "utils.h"
+
+namespace {
+
+template <typename T>
+double GetUnitRoundoff() {
+  return std::ldexp(1.0, -24);
+}
+
+template <>
+double GetUnitRoundoff<bfloat16>() {
+  return std::ldexp(1.0, -8);
+}
+
+/* Returns (tile row, tile column) of every tile on |rows| and |columns|. */
+std::vector<std::pair<uint32_t, uint32_t>> GetCrossingTiles(
+    const std::vector<uint32_t>& rows, const std::vector<uint32_t>& columns) {
+  std::vector<std::pair<uint32_t, uint32_t>> tiles;
+  for (uint32_t i : rows) {
+    for (uint32_t j : columns) {
+      tiles.push_back({i / tiny::TileHeight(), j / tiny::TileWidth()});
+    }
+  }
+  std::sort(tiles.begin(), tiles.end());
+  tiles.erase(std::unique(tiles.begin(), tiles.end()), tiles.end());
+  return tiles;
+}
+
+} /* namespace */
+
+namespace tiny {
+
+template <typename T>
+MatrixMultiplicationChecksums<T>::MatrixMultiplicationChecksums(
+    std::shared_ptr<Buffer<T>> a, std::shared_ptr<Buffer<T>> b, uint32_t m,
+    uint32_t k, uint32_t n, bool accumulated_in_float)
+    : m_(m),
+      k_(k),
+      n_(n),
+      unit_roundoff_(GetUnitRoundoff<T>()),
+      a_checksum_(k, 0.0),
+      b_checksum_(k, 0.0),
+      row_sums_(m, 0.0),
+      column_sums_(n, 0.0),
+      row_magnitudes_(m, 0.0),
+      column_magnitudes_(n, 0.0) {
+  assert(a->GetNumberOfElements() == m * k);
+  assert(b->GetNumberOfElements() == k * n);
+  assert(!a->IsTilized() && !b->IsTilized());
+
+  const double accumulator_roundoff = accumulated_in_float
+                                          ? GetUnitRoundoff<float>()
+                                          : GetUnitRoundoff<T>();
+  accumulation_error_ = unit_roundoff_ + k * accumulator_roundoff;
+
+  const T* a_data = a->GetVector().data();
+  const T* b_data = b->GetVector().data();
+
+  // 1^T A and 1^T |A|, B 1 and |B| 1.
+  std::vector<double> a_magnitude(k, 0.0);
+  std::vector<double> b_magnitude(k, 0.0);
+  ParallelFor(k, [&](uint32_t l) {
+    for (uint32_t i = 0; i < m; ++i) {
+      const double value = ToFloat(a_data[i * k + l]);
+      a_checksum_[l] += value;
+      a_magnitude[l] += std::fabs(value);
+    }
+    for (uint32_t j = 0; j < n; ++j) {
+      const double value = ToFloat(b_data[l * n + j]);
+      b_checksum_[l] += value;
+      b_magnitude[l] += std::fabs(value);
+    }
+  });
+
+  // A (B 1) and |A| (|B| 1).
+  ParallelFor(m, [&](uint32_t i) {
+    for (uint32_t l = 0; l < k; ++l) {
+      const double value = ToFloat(a_data[i * k + l]);
+      row_sums_[i] += value * b_checksum_[l];
+      row_magnitudes_[i] += std::fabs(value) * b_magnitude[l];
+    }
+  });
+
+  // (1^T A) B and (1^T |A|) |B|.
+  ParallelFor(n, [&](uint32_t j) {
+    for (uint32_t l = 0; l < k; ++l) {
+      const double value = ToFloat(b_data[l * n + j]);
+      column_sums_[j] += a_checksum_[l] * value;
+      column_magnitudes_[j] += a_magnitude[l] * std::fabs(value);
+    }
+  });
+}
+
+template <typename T>
+ChecksumCheck MatrixMultiplicationChecksums<T>::Verify(
+    std::shared_ptr<Buffer<T>> c) const {
+  assert(c->GetNumberOfElements() == m_ * n_);
+  assert(!c->IsTilized());
+  const T* c_data = c->GetVector().data();
+
+  // Not std::vector<bool>, whose elements cannot be set from many threads.
+  std::vector<uint8_t> bad_row(m_, 0);
+  std::vector<uint8_t> bad_column(n_, 0);
+  // u |c_ij| is bounded with |c_ij| <= (1 + u + k v) sum_l |a_il| |b_lj|, so
+  // the bounds come from the inputs only, and a wrong element of C cannot
+  // widen the bound of its own row or column.
+  const double relative_error =
+      unit_roundoff_ * (1.0 + accumulation_error_) + accumulation_error_;
+  ParallelFor(m_, [&](uint32_t i) {
+    double sum = 0.0;
+    bool finite = true;
+    for (uint32_t j = 0; j < n_; ++j) {
+      const double value = ToFloat(c_data[i * n_ + j]);
+      sum += value;
+      finite = finite && std::isfinite(value);
+    }
+    const double bound = relative_error * row_magnitudes_[i];
+    if (!finite || !(std::fabs(sum - row_sums_[i]) <= bound)) bad_row[i] = 1;
+  });
+  ParallelFor(n_, [&](uint32_t j) {
+    double sum = 0.0;
+    bool finite = true;
+    for (uint32_t i = 0; i < m_; ++i) {
+      const double value = ToFloat(c_data[i * n_ + j]);
+      sum += value;
+      finite = finite && std::isfinite(value);
+    }
+    const double bound = relative_error * column_magnitudes_[j];
+    if (!finite || !(std::fabs(sum - column_sums_[j]) <= bound)) {
+      bad_column[j] = 1;
+    }
+  });
+
+  ChecksumCheck check;
+  for (uint32_t i = 0; i < m_; ++i) {
+    if (bad_row[i]) check.bad_rows.push_back(i);
+  }
+  for (uint32_t j = 0; j < n_; ++j) {
+    if (bad_column[j]) check.bad_columns.push_back(j);
+  }
+  check.passed = check.bad_rows.empty() && check.bad_columns.empty();
+  if (check.passed) return check;
+
+  // When errors cancel out in the sums of one direction, fall back to every
+  // row or column of the other.
+  std::vector<uint32_t> all;
+  if (check.bad_rows.empty() || check.bad_columns.empty()) {
+    all.resize(check.bad_rows.empty() ? m_ : n_);
+    for (uint32_t i = 0; i < all.size(); ++i) all[i] = i;
+  }
+  check.bad_tiles = GetCrossingTiles(
+      check.bad_rows.empty() ? all : check.bad_rows,
+      check.bad_columns.empty() ? all : check.bad_columns);
+  return check;
+}
+
+template class MatrixMultiplicationChecksums<float>;
+template class MatrixMultiplicationChecksums<bfloat16>;
+
+} /* namespace tiny */
@@ -0,0 +1,101 @@
+// Copyright (c) 2024 Jaebaek Seo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef abft_h_
+#define abft_h_
+
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "buffer.h"
+
+namespace tiny {
+
+/* Result of MatrixMultiplicationChecksums::Verify(). */
+struct ChecksumCheck {
+  bool passed = true;
+
+  /* Output rows and columns whose sums are off, in ascending order. */
+  std::vector<uint32_t> bad_rows;
+  std::vector<uint32_t> bad_columns;
+
+  /*
+   * (tile row, tile column) of the output tiles that hold both a bad row and
+   * a bad column, in ascending order. An error in a single tile, or in a
+   * single tile row or column, is located exactly. Errors spread over several
+   * tile rows and columns also report the healthy tiles at the crossings.
+   */
+  std::vector<std::pair<uint32_t, uint32_t>> bad_tiles;
+};
+
+/*
+ * Algorithm-based fault tolerance (ABFT) checksums of the product of the |m|
+ * by |k| matrix A and the |k| by |n| matrix B.
+ *
+ * The constructor encodes the inputs with the column checksum 1^T A of A and
+ * the row checksum B 1 of B, and derives the row sums A (B 1) and the column
+ * sums (1^T A) B that the output C = AB must have, in O(mk + kn). Verify()
+ * compares them with the row and column sums of C in O(mn), so device and
+ * CPU outputs are checked without a reference matrix multiplication.
+ *
+ * Tolerances follow the rounding error bound of the product: each element of
+ * C may differ from the exact product by
+ *   u |c_ij| + (u + k v) sum_l |a_il| |b_lj|,
+ * where u is the unit roundoff of T (2^-8 for bfloat16, 2^-24 for float) for
+ * the rounded products and output, and v is the unit roundoff of the
+ * accumulator (float unless |accumulated_in_float| is false, in which case
+ * T). A row or column fails when its sum is off by more than the sum of these
+ * bounds, so a correct output never fails, and a corrupted element is caught
+ * when its error exceeds the bound of its row or column. Since |c_ij| is at
+ * most (1 + u + k v) sum_l |a_il| |b_lj|, the bounds are computed from A and
+ * B only: a huge or non-finite element of C cannot widen its own bound, and
+ * rows and columns with a non-finite element always fail.
+ */
+template <typename T>
+class MatrixMultiplicationChecksums {
+ public:
+  MatrixMultiplicationChecksums(std::shared_ptr<Buffer<T>> a,
+                                std::shared_ptr<Buffer<T>> b, uint32_t m,
+                                uint32_t k, uint32_t n,
+                                bool accumulated_in_float = true);
+
+  ChecksumCheck Verify(std::shared_ptr<Buffer<T>> c) const;
+
+  /* 1^T A and B 1. */
+  const std::vector<double>& GetColumnChecksumOfA() const {
+    return a_checksum_;
+  }
+  const std::vector<double>& GetRowChecksumOfB() const { return b_checksum_; }
+
+ private:
+  uint32_t m_;
+  uint32_t k_;
+  uint32_t n_;
+  double unit_roundoff_;
+  double accumulation_error_;
+  std::vector<double> a_checksum_;
+  std::vector<double> b_checksum_;
+
+  /* Expected row and column sums of C and the sums of |A| |B| for bounds. */
+  std::vector<double> row_sums_;
+  std::vector<double> column_sums_;
+  std::vector<double> row_magnitudes_;
+  std::vector<double> column_magnitudes_;
+};
+
+} /* namespace tiny */
+
+#endif /* ifndef abft_h_ */
@@ -0,0 +1,497 @@
+// Copyright (c) 2024 Jaebaek Seo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "autotune.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "log.h"
+#include "parallel.h"
+
+namespace {
+
+static constexpr uint32_t kNumberOfShapeClasses = 4;
+
+static constexpr tiny::GemmShapeClass kShapeClasses[kNumberOfShapeClasses] = {
+    tiny::GemmShapeClass::kGemv, tiny::GemmShapeClass::kOuterProduct,
+    tiny::GemmShapeClass::kTallSkinny, tiny::GemmShapeClass::kSquare};
+
+/* Number of timed runs of a candidate. The fastest one is used. */
+static constexpr uint32_t kAutotuneRepetitions = 3;
+
+/* Configs of all shape classes, indexed by GemmShapeClass. */
+struct ConfigTable {
+  std::mutex mutex;
+  tiny::CPUGemmConfig configs[kNumberOfShapeClasses];
+};
+
+ConfigTable& GetConfigTable() {
+  static ConfigTable table;
+  return table;
+}
+
+void StoreConfig(tiny::GemmShapeClass shape_class,
+                 const tiny::CPUGemmConfig& config) {
+  ConfigTable& table = GetConfigTable();
+  std::lock_guard<std::mutex> lock(table.mutex);
+  table.configs[static_cast<uint32_t>(shape_class)] = config;
+}
+
+tiny::CPUGemmConfig LoadConfig(tiny::GemmShapeClass shape_class) {
+  ConfigTable& table = GetConfigTable();
+  std::lock_guard<std::mutex> lock(table.mutex);
+  return table.configs[static_cast<uint32_t>(shape_class)];
+}
+
+/*
+ * Minimal JSON value for the cache file. Only objects, strings and numbers
+ * are supported.
+ */
+struct JsonValue {
+  enum class Type { kNumber, kString, kObject } type = Type::kObject;
+  double number = 0.0;
+  std::string string;
+  std::vector<std::pair<std::string, JsonValue>> members;
+
+  const JsonValue* Find(const std::string& key) const {
+    for (const auto& member : members) {
+      if (member.first == key) return &member.second;
+    }
+    return nullptr;
+  }
+
+  JsonValue& GetOrAdd(const std::string& key) {
+    for (auto& member : members) {
+      if (member.first == key) return member.second;
+    }
+    members.emplace_back(key, JsonValue());
+    return members.back().second;
+  }
+};
+
+class JsonParser {
+ public:
+  explicit JsonParser(const std::string& text) : text_(text), pos_(0) {}
+
+  /* Returns false when |text_| is not a single valid value. */
+  bool Parse(JsonValue& value) {
+    if (!ParseValue(value)) return false;
+    SkipSpaces();
+    return pos_ == text_.size();
+  }
+
+ private:
+  void SkipSpaces() {
+    while (pos_ < text_.size() && std::isspace(text_[pos_])) ++pos_;
+  }
+
+  bool Consume(char c) {
+    SkipSpaces();
+    if (pos_ >= text_.size() || text_[pos_] != c) return false;
+    ++pos_;
+    return true;
+  }
+
+  bool ParseValue(JsonValue& value) {
+    SkipSpaces();
+    if (pos_ >= text_.size()) return false;
+    if (text_[pos_] == '{') {
+      value.type = JsonValue::Type::kObject;
+      return ParseObject(value);
+    }
+    if (text_[pos_] == '"') {
+      value.type = JsonValue::Type::kString;
+      return ParseString(value.string);
+    }
+    value.type = JsonValue::Type::kNumber;
+    return ParseNumber(value.number);
+  }
+
+  bool ParseObject(JsonValue& value) {
+    if (!Consume('{')) return false;
+    if (Consume('}')) return true;
+    do {
+      std::string key;
+      SkipSpaces();
+      if (!ParseString(key) || !Consume(':')) return false;
+      if (!ParseValue(value.GetOrAdd(key))) return false;
+    } while (Consume(','));
+    return Consume('}');
+  }
+
+  bool ParseString(std::string& string) {
+    if (pos_ >= text_.size() || text_[pos_] != '"') return false;
+    for (++pos_; pos_ < text_.size(); ++pos_) {
+      char c = text_[pos_];
+      if (c == '"') {
+        ++pos_;
+        return true;
+      }
+      if (c == '\\') {
+        if (++pos_ >= text_.size()) return false;
+        c = text_[pos_];
+      }
+      string.push_back(c);
+    }
+    return false;
+  }
+
+  bool ParseNumber(double& number) {
+    const char* begin = text_.c_str() + pos_;
+    char* end = nullptr;
+    number = std::strtod(begin, &end);
+    if (end == begin) return false;
+    pos_ += end - begin;
+    return true;
+  }
+
+  const std::string& text_;
+  size_t pos_;
+};
+
+std::string EscapeJsonString(const std::string& string) {
+  std::string escaped = "\"";
+  for (char c : string) {
+    if (c == '"' || c == '\\') escaped.push_back('\\');
+    escaped.push_back(c);
+  }
+  return escaped + "\"";
+}
+
+void WriteJson(const JsonValue& value, uint32_t indent, std::ostream& out) {
+  switch (value.type) {
+    case JsonValue::Type::kNumber:
+      if (value.number == std::floor(value.number)) {
+        out << static_cast<int64_t>(value.number);
+      } else {
+        out << value.number;
+      }
+      return;
+    case JsonValue::Type::kString:
+      out << EscapeJsonString(value.string);
+      return;
+    case JsonValue::Type::kObject:
+      break;
+  }
+
+  // Objects of numbers (i.e., configs) are written in a single line.
+  bool flat = std::all_of(
+      value.members.begin(), value.members.end(), [](const auto& member) {
+        return member.second.type != JsonValue::Type::kObject;
+      });
+  const std::string spaces(indent + 2, ' ');
+  out << "{";
+  for (size_t i = 0; i < value.members.size(); ++i) {
+    out << (i == 0 ? "" : ",");
+    if (flat) {
+      out << (i == 0 ? "" : " ");
+    } else {
+      out << "\n" << spaces;
+    }
+    out << EscapeJsonString(value.members[i].first) << ": ";
+    WriteJson(value.members[i].second, indent + 2, out);
+  }
+  if (!flat && !value.members.empty()) out << "\n" << std::string(indent, ' ');
+  out << "}";
+}
+
+bool ReadJsonFile(const std::string& path, JsonValue& value) {
+  std::ifstream file(path);
+  if (!file) return false;
+  std::stringstream text;
+  text << file.rdbuf();
+  return JsonParser(text.str()).Parse(value) &&
+         value.type == JsonValue::Type::kObject;
+}
+
+/* Field names of CPUGemmConfig in the cache. */
+static const char* kConfigFieldNames[] = {"tile_h", "tile_w", "block_h",
+                                          "block_w", "num_threads"};
+
+uint32_t* GetConfigFields(tiny::CPUGemmConfig& config, uint32_t index) {
+  uint32_t* fields[] = {&config.tile_h, &config.tile_w, &config.block_h,
+                        &config.block_w, &config.num_threads};
+  return fields[index];
+}
+
+bool LoadConfigs(const std::string& path) {
+  JsonValue root;
+  if (!ReadJsonFile(path, root)) return false;
+
+  const JsonValue* host = root.Find(tiny::GetAutotuneHostName());
+  const JsonValue* gemm = host != nullptr ? host->Find("gemm") : nullptr;
+  if (gemm == nullptr) return true;
+
+  for (tiny::GemmShapeClass shape_class : kShapeClasses) {
+    const JsonValue* entry =
+        gemm->Find(tiny::GetGemmShapeClassName(shape_class));
+    if (entry == nullptr) continue;
+
+    tiny::CPUGemmConfig config = LoadConfig(shape_class);
+    bool valid = true;
+    for (uint32_t i = 0; i < std::size(kConfigFieldNames); ++i) {
+      const JsonValue* field = entry->Find(kConfigFieldNames[i]);
+      if (field == nullptr || field->type != JsonValue::Type::kNumber ||
+          field->number < 0.0) {
+        valid = false;
+        break;
+      }
+      *GetConfigFields(config, i) = static_cast<uint32_t>(field->number);
+    }
+    if (valid && config.block_h > 0 && config.block_w > 0) {
+      StoreConfig(shape_class, config);
+    }
+  }
+  return true;
+}
+
+bool SaveConfigs(const std::string& path) {
+  // Keep the entries of the other hosts. An unreadable file is overwritten.
+  JsonValue root;
+  if (!ReadJsonFile(path, root)) root = JsonValue();
+
+  JsonValue& gemm = root.GetOrAdd(tiny::GetAutotuneHostName()).GetOrAdd("gemm");
+  for (tiny::GemmShapeClass shape_class : kShapeClasses) {
+    tiny::CPUGemmConfig config = LoadConfig(shape_class);
+    JsonValue& entry = gemm.GetOrAdd(tiny::GetGemmShapeClassName(shape_class));
+    entry = JsonValue();
+    for (uint32_t i = 0; i < std::size(kConfigFieldNames); ++i) {
+      JsonValue& field = entry.GetOrAdd(kConfigFieldNames[i]);
+      field.type = JsonValue::Type::kNumber;
+      field.number = *GetConfigFields(config, i);
+    }
+  }
+
+  std::error_code error;
+  std::filesystem::path parent = std::filesystem::path(path).parent_path();
+  if (!parent.empty()) std::filesystem::create_directories(parent, error);
+  std::ofstream file(path);
+  if (!file) return false;
+  WriteJson(root, 0, file);
+  file << "\n";
+  return static_cast<bool>(file);
+}
+
+/* Representative m by k by n shapes of each shape class. */
+struct TuningShape {
+  uint32_t m;
+  uint32_t k;
+  uint32_t n;
+};
+
+std::vector<TuningShape> GetTuningShapes(tiny::GemmShapeClass shape_class) {
+  switch (shape_class) {
+    case tiny::GemmShapeClass::kGemv:
+      return {{1, 4096, 4096}, {4096, 4096, 1}};
+    case tiny::GemmShapeClass::kOuterProduct:
+      return {{1024, 32, 1024}};
+    case tiny::GemmShapeClass::kTallSkinny:
+      return {{4096, 1024, 16}, {16, 1024, 4096}};
+    case tiny::GemmShapeClass::kSquare:
+      break;
+  }
+  return {{512, 512, 512}};
+}
+
+/* Returns the total time of the fastest runs of |shapes| with |config|. */
+double MeasureConfig(const std::vector<TuningShape>& shapes,
+                     const tiny::CPUGemmConfig& config,
+                     std::vector<std::vector<float>>& operands) {
+  double total_seconds = 0.0;
+  for (size_t i = 0; i < shapes.size(); ++i) {
+    const TuningShape& shape = shapes[i];
+    tiny::GemmParams params = {.m = shape.m,
+                               .n = shape.n,
+                               .k = shape.k,
+                               .lda = shape.k,
+                               .ldb = shape.n,
+                               .ldc = shape.n};
+    const float* a = operands[3 * i].data();
+    const float* b = operands[3 * i + 1].data();
+    float* c = operands[3 * i + 2].data();
+
+    // The first run warms up caches and threads.
+    tiny::GemmWithConfig<float>(params, config, a, b, c);
+    double best_seconds = 0.0;
+    for (uint32_t r = 0; r < kAutotuneRepetitions; ++r) {
+      auto start = std::chrono::steady_clock::now();
+      tiny::GemmWithConfig<float>(params, config, a, b, c);
+      double seconds = std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+      if (r == 0 || seconds < best_seconds) best_seconds = seconds;
+    }
+    total_seconds += best_seconds;
+  }
+  return total_seconds;
+}
+
+void AutotuneConfigs() {
+  const uint32_t num_threads = tiny::GetNumberOfHostThreads();
+  std::vector<uint32_t> thread_candidates = {0};
+  for (uint32_t divisor : {2u, 4u}) {
+    if (num_threads / divisor > 0) {
+      thread_candidates.push_back(num_threads / divisor);
+    }
+  }
+  const std::vector<std::pair<uint32_t, uint32_t>> tile_candidates = {
+      {4, 8}, {8, 8}, {4, 16}, {8, 16}};
+  const std::vector<uint32_t> block_h_candidates = {16,  32,  64,
+                                                    128, 256, 512};
+  const std::vector<uint32_t> block_w_candidates = {64,  128,  256, 512,
+                                                    1024, 2048, 4096};
+
+  for (tiny::GemmShapeClass shape_class : kShapeClasses) {
+    const std::vector<TuningShape> shapes = GetTuningShapes(shape_class);
+    std::vector<std::vector<float>> operands;
+    for (const TuningShape& shape : shapes) {
+      operands.emplace_back(static_cast<size_t>(shape.m) * shape.k, 0.5f);
+      operands.emplace_back(static_cast<size_t>(shape.k) * shape.n, 0.25f);
+      operands.emplace_back(static_cast<size_t>(shape.m) * shape.n, 0.0f);
+    }
+
+    tiny::CPUGemmConfig best = LoadConfig(shape_class);
+    double best_seconds = MeasureConfig(shapes, best, operands);
+    auto try_candidate = [&](const tiny::CPUGemmConfig& candidate) {
+      double seconds = MeasureConfig(shapes, candidate, operands);
+      if (seconds < best_seconds) {
+        best_seconds = seconds;
+        best = candidate;
+      }
+    };
+
+    // kGemv and kOuterProduct kernels do not use the register tile.
+    if (shape_class == tiny::GemmShapeClass::kSquare ||
+        shape_class == tiny::GemmShapeClass::kTallSkinny) {
+      for (const auto& tile : tile_candidates) {
+        tiny::CPUGemmConfig candidate = best;
+        candidate.tile_h = tile.first;
+        candidate.tile_w = tile.second;
+        try_candidate(candidate);
+      }
+    }
+    for (uint32_t block_h : block_h_candidates) {
+      tiny::CPUGemmConfig candidate = best;
+      candidate.block_h = block_h;
+      try_candidate(candidate);
+    }
+    for (uint32_t block_w : block_w_candidates) {
+      tiny::CPUGemmConfig candidate = best;
+      candidate.block_w = block_w;
+      try_candidate(candidate);
+    }
+    for (uint32_t threads : thread_candidates) {
+      tiny::CPUGemmConfig candidate = best;
+      candidate.num_threads = threads;
+      try_candidate(candidate);
+    }
+
+    StoreConfig(shape_class, best);
+    log_blue("Autotuned {}: tile {}x{}, block {}x{}, {} threads, {} ms",
+             tiny::GetGemmShapeClassName(shape_class), best.tile_h,
+             best.tile_w, best.block_h, best.block_w, best.num_threads,
+             best_seconds * 1e3);
+  }
+}
+
+/*
+ * Sets the default configs and loads the cache (or autotunes) on the first
+ * call.
+ */
+void EnsureInitialized() {
+  static std::once_flag once;
+  std::call_once(once, [] {
+    for (tiny::GemmShapeClass shape_class : kShapeClasses) {
+      StoreConfig(shape_class, tiny::GetDefaultCPUGemmConfig(shape_class));
+    }
+
+    const std::string path = tiny::GetAutotuneCachePath();
+    LoadConfigs(path);
+
+    const char* env = std::getenv("TINY_AUTOTUNE");
+    if (env != nullptr && std::atoi(env) == 1) {
+      AutotuneConfigs();
+      if (!SaveConfigs(path)) {
+        log_error("Failed to save the autotune cache to {}", path);
+      }
+    }
+  });
+}
+
+} /* namespace */
+
+namespace tiny {
+
+std::string GetAutotuneCachePath() {
+  const char* env = std::getenv("TINY_AUTOTUNE_CACHE");
+  if (env != nullptr && env[0] != '\0') return env;
+  const char* home = std::getenv("HOME");
+  return std::string(home != nullptr ? home : ".") +
+         "/.cache/tiny/autotune.json";
+}
+
+std::string GetAutotuneHostName() {
+  std::string model = "unknown CPU";
+  std::ifstream cpuinfo("/proc/cpuinfo");
+  std::string line;
+  while (std::getline(cpuinfo, line)) {
+    if (line.rfind("model name", 0) != 0) continue;
+    size_t colon = line.find(':');
+    if (colon != std::string::npos && colon + 2 <= line.size()) {
+      model = line.substr(colon + 2);
+    }
+    break;
+  }
+  return model + " (" + std::to_string(std::thread::hardware_concurrency()) +
+         " threads)";
+}
+
+CPUGemmConfig GetCPUGemmConfig(GemmShapeClass shape_class) {
+  EnsureInitialized();
+  return LoadConfig(shape_class);
+}
+
+void SetCPUGemmConfig(GemmShapeClass shape_class,
+                      const CPUGemmConfig& config) {
+  EnsureInitialized();
+  StoreConfig(shape_class, config);
+}
+
+bool LoadAutotuneCache(const std::string& path) {
+  EnsureInitialized();
+  return LoadConfigs(path);
+}
+
+bool SaveAutotuneCache(const std::string& path) {
+  EnsureInitialized();
+  return SaveConfigs(path);
+}
+
+void AutotuneCPUGemm() {
+  EnsureInitialized();
+  AutotuneConfigs();
+}
+
+} /* namespace tiny */
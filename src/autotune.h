@@ -0,0 +1,84 @@
+// Copyright (c) 2024 Jaebaek Seo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef autotune_h_
+#define autotune_h_
+
+#include <string>
+
+#include "matmul_cpu.h"
+
+namespace tiny {
+
+/*
+ * Autotuning of the CPU GEMM blocking (CPUGemmConfig) for the host.
+ *
+ * The best register tile, block size and number of threads differ between
+ * hosts (e.g., AMD and Intel CPUs), so the tuned configs are kept in a JSON
+ * cache file with an entry for each host:
+ *
+ *   {
+ *     "<CPU model name> (<number of threads> threads)": {
+ *       "gemm": {
+ *         "square": {"tile_h": 8, "tile_w": 8, "block_h": 64, ...},
+ *         ...
+ *       }
+ *     }
+ *   }
+ *
+ * The cache is GetAutotuneCachePath(). The first GetCPUGemmConfig() call loads
+ * the entry of the host from it, so every CPU op built on Gemm() (e.g.,
+ * CPUMatrixMultiplication) runs with the tuned blocking. When TINY_AUTOTUNE
+ * environment variable is set to 1, the first call runs AutotuneCPUGemm()
+ * and saves the result to the cache instead.
+ */
+
+/*
+ * Returns TINY_AUTOTUNE_CACHE environment variable if it is set, otherwise
+ * $HOME/.cache/tiny/autotune.json.
+ */
+std::string GetAutotuneCachePath();
+
+/* Returns the key of the host in the cache. */
+std::string GetAutotuneHostName();
+
+/* Returns the blocking of |shape_class| for the host. */
+CPUGemmConfig GetCPUGemmConfig(GemmShapeClass shape_class);
+
+void SetCPUGemmConfig(GemmShapeClass shape_class,
+                      const CPUGemmConfig& config);
+
+/*
+ * Loads the configs of the host from |path|. Returns false when the file
+ * cannot be read or parsed. Missing or invalid configs are left unchanged.
+ */
+bool LoadAutotuneCache(const std::string& path);
+
+/*
+ * Saves the current configs as the entry of the host in |path|, keeping the
+ * entries of other hosts.
+ */
+bool SaveAutotuneCache(const std::string& path);
+
+/*
+ * Benchmarks candidate configs on representative shapes of each shape class
+ * and sets the fastest ones with SetCPUGemmConfig(). The tile, the block
+ * height, the block width and the number of threads are tuned one after
+ * another, each keeping the best values found so far.
+ */
+void AutotuneCPUGemm();
+
+} /* namespace tiny */
+
+#endif /* ifndef autotune_h_ */
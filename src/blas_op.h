@@ -15,8 +15,12 @@
 #ifndef blas_op_
 #define blas_op_
 
+#include <memory>
+
 namespace tiny {
 
+class Epilogue;
+
 enum Result {
   kSuccess,
   kFail,
@@ -25,6 +29,18 @@ enum Result {
 class BLASOp {
  public:
   virtual Result Run() = 0;
+
+  /*
+   * Sets the element-wise post-processing (see epilogue.h) fused into the
+   * output of Run(). Ops that expose it via `using BLASOp::SetEpilogue;`
+   * support it.
+   */
+  void SetEpilogue(std::shared_ptr<const Epilogue> epilogue) {
+    epilogue_ = epilogue;
+  }
+
+ protected:
+  std::shared_ptr<const Epilogue> epilogue_;
 };
 
 } /* namespace tiny */
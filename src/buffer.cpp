@@ -49,7 +49,7 @@ Buffer<int>::Buffer(size_t number_of_elems, int seed) {
 
   int rand_max = 200;
   int offset = 100;
-  auto rand_elem = std::bind(std::uniform_real_distribution<int>(0, rand_max),
+  auto rand_elem = std::bind(std::uniform_int_distribution<int>(0, rand_max),
                              std::mt19937(seed));
   for (size_t i = 0; i < number_of_elems; ++i) {
     int elem = rand_elem() + offset;
@@ -57,6 +57,21 @@ Buffer<int>::Buffer(size_t number_of_elems, int seed) {
   }
 }
 
+template <>
+Buffer<int8_t>::Buffer(size_t number_of_elems, int seed) {
+  tilized_ = false;
+  all_zeros_ = false;
+
+  buffer_.clear();
+  buffer_.resize(number_of_elems);
+
+  auto rand_elem = std::bind(std::uniform_int_distribution<int>(-127, 127),
+                             std::mt19937(seed));
+  for (size_t i = 0; i < number_of_elems; ++i) {
+    buffer_[i] = static_cast<int8_t>(rand_elem());
+  }
+}
+
 template <>
 Buffer<bfloat16>::Buffer(size_t number_of_elems, int seed) {
   tilized_ = false;
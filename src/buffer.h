@@ -15,13 +15,18 @@
 #ifndef buffer_h_
 #define buffer_h_
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <utility>
 #include <vector>
 
 #include "utils.h"
 
 namespace tiny {
 
-/* Support only bfloat16, float, int. */
+/* Support only bfloat16, float, int, int8_t. */
 template <typename T>
 class Buffer {
  public:
@@ -50,31 +55,174 @@ class Buffer {
 
   std::vector<T>& GetVector() { return buffer_; }
 
-  void Tilize(uint32_t width, uint32_t height) {
+  /*
+   * See TilizeForTTDevice() for |order|. Device kernels read tiles in
+   * TileOrder::kRowMajor, and TileOrder::kMorton is for host ops.
+   */
+  void Tilize(uint32_t width, uint32_t height,
+              TileOrder order = TileOrder::kRowMajor) {
     // Return if it is already tilized.
     if (tilized_) return;
 
-    TilizeForTTDevice<T>(buffer_, width, height);
+    TilizeForTTDevice<T>(buffer_, width, height, order);
     tilized_ = true;
+    tile_order_ = order;
   }
 
   void Untilize(uint32_t width, uint32_t height) {
-    UnTilizeForTTDevice<T>(buffer_, width, height);
+    UnTilizeForTTDevice<T>(buffer_, width, height, tile_order_);
     tilized_ = false;
   }
 
+  /* Marks the elements as tilized e.g., when an op writes tiles directly. */
+  void SetTilized(TileOrder order) {
+    tilized_ = true;
+    tile_order_ = order;
+  }
+
   bool IsTilized() const { return tilized_; }
 
+  TileOrder GetTileOrder() const { return tile_order_; }
+
   bool AllZeros() const { return all_zeros_; }
 
+  /*
+   * Dirty tracking for incremental ops such as
+   * CPUIncrementalMatrixMultiplication. A writer that changes elements
+   * [|begin|, |end|) through GetVector() marks them with MarkDirty(). The op
+   * that consumes the buffer reads the ranges changed since its last run and
+   * clears them, so a buffer tracks changes for a single consumer. Ranges
+   * are kept sorted and merged.
+   *
+   * Each MarkDirty() also bumps the version of the buffer, which consumers
+   * that only need to know whether the buffer changed (e.g., caches of
+   * derived data shared by many ops) compare instead of clearing the ranges.
+   */
+  void MarkDirty(size_t begin, size_t end) {
+    assert(begin <= end && end <= buffer_.size());
+    if (begin == end) return;
+    ++version_;
+    auto it = std::lower_bound(
+        dirty_ranges_.begin(), dirty_ranges_.end(), begin,
+        [](const auto& range, size_t value) { return range.second < value; });
+    while (it != dirty_ranges_.end() && it->first <= end) {
+      begin = std::min(begin, it->first);
+      end = std::max(end, it->second);
+      it = dirty_ranges_.erase(it);
+    }
+    dirty_ranges_.insert(it, {begin, end});
+  }
+
+  const std::vector<std::pair<size_t, size_t>>& GetDirtyRanges() const {
+    return dirty_ranges_;
+  }
+
+  void ClearDirty() { dirty_ranges_.clear(); }
+
+  uint64_t GetVersion() const { return version_; }
+
   ~Buffer() {}
 
  private:
   std::vector<T> buffer_;
   bool tilized_;
   bool all_zeros_;
+  TileOrder tile_order_ = TileOrder::kRowMajor;
+  std::vector<std::pair<size_t, size_t>> dirty_ranges_;
+  uint64_t version_ = 0;
 };
 
+/*
+ * Symmetric int8 quantization helpers. A quantized value q represents
+ * |scale| * q where q is in [-127, 127].
+ *
+ * |input| is a |height| by |width| matrix. The per-channel variants use one
+ * scale for each column i.e., each output channel of a |k| by |n| weight
+ * matrix.
+ */
+inline float GetQuantizationScale(float max_abs) {
+  return max_abs == 0.0f ? 1.0f : max_abs / 127.0f;
+}
+
+inline int8_t QuantizeValue(float value, float scale) {
+  float q = std::nearbyint(value / scale);
+  return static_cast<int8_t>(std::clamp(q, -127.0f, 127.0f));
+}
+
+/* Returns the scale of the quantized |output|. */
+template <typename T>
+float QuantizePerTensor(std::shared_ptr<Buffer<T>> input,
+                        std::shared_ptr<Buffer<int8_t>> output) {
+  auto& input_vec = input->GetVector();
+  auto& output_vec = output->GetVector();
+  assert(input_vec.size() == output_vec.size());
+
+  float max_abs = 0.0f;
+  for (const T& value : input_vec) {
+    max_abs = std::max(max_abs, std::fabs(ToFloat<T>(value)));
+  }
+  float scale = GetQuantizationScale(max_abs);
+  for (size_t i = 0; i < input_vec.size(); ++i) {
+    output_vec[i] = QuantizeValue(ToFloat<T>(input_vec[i]), scale);
+  }
+  return scale;
+}
+
+/* Returns |width| scales, one for each column of the quantized |output|. */
+template <typename T>
+std::vector<float> QuantizePerChannel(std::shared_ptr<Buffer<T>> input,
+                                      uint32_t width, uint32_t height,
+                                      std::shared_ptr<Buffer<int8_t>> output) {
+  auto& input_vec = input->GetVector();
+  auto& output_vec = output->GetVector();
+  assert(input_vec.size() == width * height);
+  assert(output_vec.size() == width * height);
+
+  std::vector<float> scales(width, 0.0f);
+  for (uint32_t i = 0; i < height; ++i) {
+    for (uint32_t j = 0; j < width; ++j) {
+      scales[j] =
+          std::max(scales[j], std::fabs(ToFloat<T>(input_vec[i * width + j])));
+    }
+  }
+  for (float& scale : scales) scale = GetQuantizationScale(scale);
+  for (uint32_t i = 0; i < height; ++i) {
+    for (uint32_t j = 0; j < width; ++j) {
+      output_vec[i * width + j] =
+          QuantizeValue(ToFloat<T>(input_vec[i * width + j]), scales[j]);
+    }
+  }
+  return scales;
+}
+
+/*
+ * Converts quantized |input| (int8_t values or int accumulators of an int8
+ * matmul) back to T. Element (i, j) is multiplied by |scale| *
+ * |channel_scales[j]|. |channel_scales| can be empty for per-tensor scaling.
+ *
+ * For an int8 matmul output, |scale| is the scale of the first input and
+ * |channel_scales| are the scales of the second input.
+ */
+template <typename Q, typename T>
+void Dequantize(std::shared_ptr<Buffer<Q>> input, uint32_t width,
+                uint32_t height, float scale,
+                const std::vector<float>& channel_scales,
+                std::shared_ptr<Buffer<T>> output) {
+  auto& input_vec = input->GetVector();
+  auto& output_vec = output->GetVector();
+  assert(input_vec.size() == width * height);
+  assert(output_vec.size() == width * height);
+  assert(channel_scales.empty() || channel_scales.size() == width);
+
+  for (uint32_t i = 0; i < height; ++i) {
+    for (uint32_t j = 0; j < width; ++j) {
+      float s = channel_scales.empty() ? scale : scale * channel_scales[j];
+      output_vec[i * width + j] =
+          FromFloat<T>(static_cast<float>(input_vec[i * width + j]) * s);
+    }
+  }
+}
+
 } /* namespace tiny */
 
 #endif /* ifndef buffer_h_ */
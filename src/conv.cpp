@@ -32,33 +32,6 @@
 namespace tiny {
 namespace {
 
-constexpr std::uint32_t input_h = 64;
-constexpr std::uint32_t input_w = 96;
-constexpr std::uint32_t input_c = 32;
-constexpr std::uint32_t weight_h = 4;
-constexpr std::uint32_t weight_w = 4;
-constexpr std::uint32_t slide_h = 1;
-constexpr std::uint32_t slide_w = 1;
-constexpr std::uint32_t padding_h = weight_h / 2;
-constexpr std::uint32_t padding_w = weight_w / 2;
-constexpr std::uint32_t output_h =
-    (input_h + 2 * padding_h - weight_h) / slide_h;
-constexpr std::uint32_t output_w =
-    (input_w + 2 * padding_w - weight_w) / slide_w;
-constexpr std::uint32_t output_c = 128;
-
-inline void CheckInputDimension(uint32_t number_of_elems) {
-  assert(number_of_elems == input_h * input_w * input_c);
-}
-
-inline void CheckWeightDimension(uint32_t number_of_elems) {
-  assert(number_of_elems == weight_h * weight_w * input_c * output_c);
-}
-
-inline void CheckOutputDimension(uint32_t number_of_elems) {
-  assert(number_of_elems == output_h * output_w * output_c);
-}
-
 template <typename T>
 tiny::Result RunTT(std::shared_ptr<tiny::Buffer<T>> input,
                    std::shared_ptr<tiny::Buffer<T>> weight,
@@ -74,69 +47,6 @@ tiny::Result RunTT(std::shared_ptr<tiny::Buffer<T>> input,
   return tiny::Result::kSuccess;
 }
 
-template <typename T>
-inline float accumulate(float a, T b, T c) {
-  return a + b * c;
-}
-
-template <>
-inline float accumulate<bfloat16>(float a, bfloat16 b, bfloat16 c) {
-  return a + b.to_float() * c.to_float();
-}
-
-template <typename T>
-inline T convert_to_type(float a) {
-  return static_cast<T>(a);
-}
-
-template <>
-inline bfloat16 convert_to_type<bfloat16>(float a) {
-  return bfloat16(a);
-}
-
-template <typename T>
-tiny::Result RunCpu(std::shared_ptr<tiny::Buffer<T>> input_buffer,
-                    std::shared_ptr<tiny::Buffer<T>> weight_buffer,
-                    std::shared_ptr<tiny::Buffer<T>> output_buffer) {
-  auto& input = input_buffer->GetVector();
-  auto& weight = weight_buffer->GetVector();
-  auto& output = output_buffer->GetVector();
-
-  // oc = output channel
-  for (uint32_t oc = 0; oc < output_c; ++oc) {
-    for (uint32_t i = 0; i < output_h; ++i) {
-      for (uint32_t j = 0; j < output_w; ++j) {
-        float output_element = 0;
-
-        // ic = input channel
-        for (uint32_t ic = 0; ic < input_c; ++ic) {
-          // Assuming that padding_h = weight_h / 2 and padding_w = weight_w / 2
-          for (uint32_t row = i - padding_h; row < i + padding_h; ++row) {
-            for (uint32_t col = j - padding_w; col < j + padding_w; ++col) {
-              T input_value = 0;
-              if (0 <= row && row < output_h && 0 <= col && col < output_w) {
-                input_value =
-                    input[ic * input_h * input_w + row * input_w + col];
-              }
-              int wr = row - i + padding_h;
-              int wc = col - j + padding_w;
-              T weight_value =
-                  weight[ic * weight_h * weight_w + wr * weight_w + wc];
-
-              output_element =
-                  accumulate<T>(output_element, input_value, weight_value);
-            }
-          }
-        }
-
-        output[oc * output_h * output_w + i * output_w + j] =
-            convert_to_type<T>(output_element);
-      }
-    }
-  }
-  return tiny::Result::kSuccess;
-}
-
 } /* namespace  */
 
 template <>
@@ -149,30 +59,6 @@ Result Conv<float>::Run() {
   return RunTT<float>(input_, weight_, output_);
 }
 
-template <>
-Result CpuConv<bfloat16>::Run() {
-  return RunCpu<bfloat16>(input_, weight_, output_);
-}
-
-template <>
-Result CpuConv<float>::Run() {
-  return RunCpu<float>(input_, weight_, output_);
-}
-
-template <>
-void Conv<bfloat16>::CheckDimension() {
-  CheckInputDimension(input_->GetNumberOfElements());
-  CheckWeightDimension(weight_->GetNumberOfElements());
-  CheckOutputDimension(output_->GetNumberOfElements());
-}
-
-template <>
-void Conv<float>::CheckDimension() {
-  CheckInputDimension(input_->GetNumberOfElements());
-  CheckWeightDimension(weight_->GetNumberOfElements());
-  CheckOutputDimension(output_->GetNumberOfElements());
-}
-
 } /* namespace tiny */
 
 using namespace tt::constants;
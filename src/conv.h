@@ -16,16 +16,23 @@
 #define conv_h_
 
 #include <cassert>
+#include <map>
 #include <memory>
 
 #include "blas_op.h"
 #include "buffer.h"
+#include "conv_epilogue.h"
+#include "conv_plan.h"
+#include "conv_weight_cache.h"
 #include "utils.h"
 
 namespace tiny {
 
 /**
- * Class for simple convolution operation example.
+ * Class for 2D convolution. See Conv2dParams for the shape and the layouts of
+ * the buffers.
+ *
+ * Example of the shape:
  *
  * Input dimension: (64, 96, 32)
  *   height = 64
@@ -41,22 +48,31 @@ namespace tiny {
  * Slide: (1, 1) - one by one slide for both horizontal and virtical directions.
  * Padding: (2, 2)
  *
- * Output dimension: (64, 96, 128)
- *   output_h = (input_h + 2 * padding_h - weight_h) / slide_h
- *   output_w = (input_w + 2 * padding_w - weight_w) / slide_w
+ * Output dimension: (65, 97, 128)
+ *   output_h = (input_h + 2 * padding_h - weight_h) / slide_h + 1
+ *   output_w = (input_w + 2 * padding_w - weight_w) / slide_w + 1
  *
- * For both Conv and CpuConv, we assume that the given input buffer has an
+ * With Conv2dLayout::kNCHW (the default), the given input buffer has an
  * order of elements based on the following rule:
  *  - The first row of the first channel matrix is placed first.
- *  - The second row of the second channel matrix is placed second.
+ *  - The second row of the first channel matrix is placed second.
  *  - ...
  *
  * The given weight buffer has the same order of elements i.e., the first row
- * of the first first channel matrix is placed first.
+ * of the first input channel of the first output channel is placed first.
+ *
+ * The plan of the shape (see conv_plan.h) is looked up once, when the op is
+ * created.
  */
 template <typename T>
 class Conv : BLASOp {
  public:
+  explicit Conv(const Conv2dParams& params)
+      : params_(params),
+        plan_(GetConv2dPlan(params)),
+        algorithm_(plan_->algorithm),
+        output_size_(params.GetOutputSize()) {}
+
   Result Run();
 
   void SetBuffers(std::shared_ptr<Buffer<T>> input,
@@ -68,19 +84,143 @@ class Conv : BLASOp {
     CheckDimension();
   }
 
+  const Conv2dParams& GetParams() const { return params_; }
+
+  Conv2dAlgorithm GetAlgorithm() const { return algorithm_; }
+
  protected:
+  Conv2dParams params_;
+  std::shared_ptr<const Conv2dPlan> plan_;
+  Conv2dAlgorithm algorithm_;
+
+  /* Number of elements of the output buffer. */
+  size_t output_size_;
   std::shared_ptr<Buffer<T>> input_;
   std::shared_ptr<Buffer<T>> weight_;
   std::shared_ptr<Buffer<T>> output_;
 
  private:
-  void CheckDimension();
+  void CheckDimension() {
+    assert(input_->GetNumberOfElements() == params_.GetInputSize());
+    assert(weight_->GetNumberOfElements() == params_.GetWeightSize());
+    assert(output_->GetNumberOfElements() == output_size_);
+  }
 };
 
 template <typename T>
 class CpuConv : public Conv<T> {
  public:
+  explicit CpuConv(const Conv2dParams& params) : Conv<T>(params) {}
+
   Result Run();
+
+  /*
+   * Overrides the algorithm of the plan e.g., to compare algorithms. See
+   * IsConv2dAlgorithmSupported().
+   */
+  void SetAlgorithm(Conv2dAlgorithm algorithm) {
+    assert(IsConv2dAlgorithmSupported(this->params_, algorithm));
+    this->algorithm_ = algorithm;
+  }
+
+  /*
+   * Upper bound of the memory for the lowered matrix of kIm2col, in bytes.
+   * The pixels are lowered and multiplied block by block to stay in the
+   * budget. A block has at least one pixel, or two output rows with
+   * pooling.
+   */
+  void SetIm2colMemoryBudget(size_t bytes) { im2col_memory_budget_ = bytes; }
+
+  /*
+   * Runs |epilogue| on the output (see Conv2dEpilogue). The kernels apply it
+   * as they store the output, pooling pairs of output rows and columns while
+   * they are still in registers or in a block of a GEMM product. With
+   * pooling, the output buffer has the pooled shape, so this must be called
+   * before SetBuffers(), or the output buffer already set must have that
+   * shape.
+   */
+  void SetEpilogue(const Conv2dEpilogue& epilogue) {
+    assert(epilogue.IsValid(this->params_));
+    epilogue_ = epilogue;
+    output_stage_ =
+        GetConv2dOutputStage(this->params_, epilogue, IsBatchNormFolded());
+    this->output_size_ = epilogue.GetOutputSize(this->params_);
+    assert(this->output_ == nullptr ||
+           this->output_->GetNumberOfElements() == this->output_size_);
+    folded_weight_source_ = nullptr;
+
+    // Tiles hold whole pooling windows.
+    SetSpatialTileBudget(spatial_tile_budget_);
+  }
+
+  /*
+   * Runs the convolution tile by tile, with tiles whose input footprint and
+   * output fit in |bytes| (see PlanConv2dSpatialTiling()). Each tile gathers
+   * its footprint, including the halo and the padding, into a small input
+   * and runs as a convolution of its own, with the epilogue of this op. 0
+   * (the default) runs the whole output at once.
+   */
+  void SetSpatialTileBudget(size_t bytes) {
+    spatial_tile_budget_ = bytes;
+    if (bytes > 0) {
+      spatial_tiling_ = PlanConv2dSpatialTiling(
+          this->params_, bytes, sizeof(T),
+          epilogue_.pooling != Conv2dPooling::kNone);
+    }
+    tile_ops_.clear();
+  }
+
+  /* The tiling of the last SetSpatialTileBudget() with a budget. */
+  const Conv2dSpatialTiling& GetSpatialTiling() const {
+    return spatial_tiling_;
+  }
+
+ private:
+  bool IsBatchNormFolded() const {
+    return epilogue_.fold_batch_norm && epilogue_.HasBatchNorm();
+  }
+
+  /*
+   * Returns the weight to run with: the weight buffer, or the weight with the
+   * batch norm folded in. The folded weight is computed again only when the
+   * weight buffer, its version (see Buffer::GetVersion()) or the epilogue
+   * changed. Packed forms of the returned weight are cached by
+   * GetPackedConv2dWeight().
+   */
+  std::shared_ptr<Buffer<T>> PrepareWeight();
+
+  /* Runs the convolution and the epilogue of the op. */
+  Result RunOnHost();
+
+  /*
+   * Runs the convolution with |weight| (see PrepareWeight()) tile by tile
+   * into |output|. The ops of the tiles run the output stage of this op,
+   * including the pooling, on |weight|, so the batch norm is folded once for
+   * all tiles, and they share the packed forms of |weight| (see
+   * GetPackedConv2dWeight()).
+   */
+  Result RunSpatialTiles(std::shared_ptr<Buffer<T>> weight, T* output);
+
+  /*
+   * An op and its buffers for the tiles of a shape. The op has no epilogue of
+   * its own, and its weight is bound on every run.
+   */
+  struct TileOp {
+    std::unique_ptr<CpuConv<T>> op;
+    std::shared_ptr<Buffer<T>> input;
+    std::shared_ptr<Buffer<T>> output;
+  };
+
+  size_t im2col_memory_budget_ = kDefaultIm2colMemoryBudgetCPU;
+  Conv2dEpilogue epilogue_;
+  Conv2dOutputStage output_stage_;
+  std::shared_ptr<Buffer<T>> folded_weight_;
+  std::shared_ptr<Buffer<T>> folded_weight_source_;
+  uint64_t folded_weight_version_ = 0;
+
+  size_t spatial_tile_budget_ = 0;
+  Conv2dSpatialTiling spatial_tiling_;
+  std::map<Conv2dParams, TileOp> tile_ops_;
 };
 
 } /* namespace tiny */
@@ -0,0 +1,990 @@
+// Copyright (c) 2024 Jaebaek Seo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "conv.h"
+
+#include <algorithm>
+#include <cassert>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "conv_epilogue.h"
+#include "conv_winograd.h"
+#include "epilogue.h"
+#include "matmul_cpu.h"
+#include "parallel.h"
+#include "tt_metal/common/bfloat16.hpp"
+#include "utils.h"
+
+namespace tiny {
+namespace {
+
+/*
+ * Returns |stage| for output channels [|channel|, |channel| + |count|) as the
+ * epilogue of a GEMM, which applies it to the float accumulators before the
+ * store. The channels are the rows of the product with kNCHW and its columns
+ * with kNHWC. Returns nullptr when |stage| does nothing.
+ */
+std::unique_ptr<Epilogue> GetOutputStageEpilogue(
+    const Conv2dOutputStage& stage, Conv2dLayout layout, uint32_t channel,
+    uint32_t count) {
+  if (stage.IsIdentity()) return nullptr;
+  auto slice = [=](const std::vector<float>& values) {
+    if (values.empty()) return std::vector<float>();
+    return std::vector<float>(values.begin() + channel,
+                              values.begin() + channel + count);
+  };
+  auto epilogue = std::make_unique<Epilogue>();
+  epilogue->AddScaleShift(slice(stage.scale), slice(stage.shift),
+                          layout == Conv2dLayout::kNCHW);
+  if (stage.activation != Activation::kNone) {
+    epilogue->AddActivation(stage.activation);
+  }
+  return epilogue;
+}
+
+/* Distances between neighbouring channels, rows and columns, in elements. */
+struct PlaneStrides {
+  size_t channel;
+  size_t row;
+  size_t col;
+};
+
+/*
+ * Pools |rows| by |cols| elements of |channels| channels of |src|, which went
+ * through |stage| already, into |dst| with the pooling of |stage|. |rows| is
+ * even, and an odd last column is dropped. Used by the GEMM paths on each
+ * block of their product.
+ */
+template <typename T>
+void PoolPlanes(const Conv2dOutputStage& stage, uint32_t channels,
+                uint32_t rows, uint32_t cols, const T* src,
+                const PlaneStrides& src_strides, T* dst,
+                const PlaneStrides& dst_strides) {
+  assert(rows % 2 == 0);
+  ParallelFor(rows / 2 * channels, [&](uint32_t item) {
+    const uint32_t h = item / channels;
+    const uint32_t c = item % channels;
+    const T* src_row =
+        src + c * src_strides.channel + 2 * h * src_strides.row;
+    T* dst_row = dst + c * dst_strides.channel + h * dst_strides.row;
+    for (uint32_t w = 0; w < cols / 2; ++w) {
+      const T* x = src_row + 2 * w * src_strides.col;
+      dst_row[w * dst_strides.col] = FromFloat<T>(stage.Pool(
+          ToFloat(x[0]), ToFloat(x[src_strides.col]),
+          ToFloat(x[src_strides.row]),
+          ToFloat(x[src_strides.row + src_strides.col])));
+    }
+  });
+}
+
+/*
+ * Stores |width| columns from |ow| of output row |oh| of output channel |oc|
+ * of image |n| with kNCHW, from the accumulators |acc|. With pooling, |oh|,
+ * |ow| and |width| are even, |next_acc| has output row |oh| + 1, and the 2x2
+ * windows of the two rows are stored into the pooled output.
+ */
+template <typename T>
+void StoreOutputRow(const Conv2dPlan& plan, const Conv2dOutputStage& stage,
+                    const float* acc, const float* next_acc, T* output,
+                    uint32_t n, uint32_t oc, uint32_t oh, uint32_t ow,
+                    uint32_t width) {
+  const uint32_t s = stage.GetPoolingSize();
+  const uint32_t output_w = plan.output_w / s;
+  T* output_row =
+      output +
+      ((static_cast<size_t>(n) * plan.params.output_c + oc) *
+           (plan.output_h / s) +
+       oh / s) * output_w +
+      ow / s;
+  if (s == 1) {
+    for (uint32_t i = 0; i < width; ++i) {
+      output_row[i] = FromFloat<T>(stage.Apply(oc, acc[i]));
+    }
+    return;
+  }
+  for (uint32_t i = 0; i < width / 2; ++i) {
+    output_row[i] = FromFloat<T>(stage.Pool(
+        stage.Apply(oc, acc[2 * i]), stage.Apply(oc, acc[2 * i + 1]),
+        stage.Apply(oc, next_acc[2 * i]),
+        stage.Apply(oc, next_acc[2 * i + 1])));
+  }
+}
+
+/*
+ * Stores the register tile |acc| of |pixels| pixels from column |ow| of
+ * output row |oh| of image |n| with kNHWC, for |channels| output channels
+ * from |oc|. With pooling, |oh|, |ow| and |pixels| are even, acc[1] has
+ * output row |oh| + 1, and the 2x2 windows of the two rows are stored into
+ * the pooled output.
+ */
+template <typename T>
+void StoreOutputTile(
+    const Conv2dPlan& plan, const Conv2dOutputStage& stage,
+    const float (*acc)[kNHWCTilePixelsCPU][kNHWCTileChannelsCPU], T* output,
+    uint32_t n, uint32_t oh, uint32_t ow, uint32_t pixels, uint32_t oc,
+    uint32_t channels) {
+  const uint32_t s = stage.GetPoolingSize();
+  const uint32_t output_w = plan.output_w / s;
+  for (uint32_t i = 0; i < pixels / s; ++i) {
+    T* output_pixel =
+        output +
+        ((static_cast<size_t>(n) * (plan.output_h / s) + oh / s) * output_w +
+         ow / s + i) * plan.params.output_c +
+        oc;
+    for (uint32_t j = 0; j < channels; ++j) {
+      if (s == 1) {
+        output_pixel[j] = FromFloat<T>(stage.Apply(oc + j, acc[0][i][j]));
+        continue;
+      }
+      output_pixel[j] = FromFloat<T>(stage.Pool(
+          stage.Apply(oc + j, acc[0][2 * i][j]),
+          stage.Apply(oc + j, acc[0][2 * i + 1][j]),
+          stage.Apply(oc + j, acc[1][2 * i][j]),
+          stage.Apply(oc + j, acc[1][2 * i + 1][j])));
+    }
+  }
+}
+
+/*
+ * The output of each group is weight (ocg x icg) * input (icg x pixels). With
+ * pooling, the product of a group of an image, without an odd last row, goes
+ * to a scratch buffer and is pooled into the output.
+ */
+template <typename T>
+Result RunPointwise(const Conv2dPlan& plan, const Conv2dOutputStage& stage,
+                    const T* input, const T* weight, T* output) {
+  const Conv2dParams& p = plan.params;
+  const uint32_t icg = p.input_c / p.groups;
+  const uint32_t ocg = p.output_c / p.groups;
+  const uint32_t pixels = p.input_h * p.input_w;
+  const uint32_t s = stage.GetPoolingSize();
+  const uint32_t rows = plan.output_h / s * s;
+  const uint32_t pooled_pixels = plan.output_h / s * (plan.output_w / s);
+  GemmParams params = {.m = ocg,
+                       .n = rows * plan.output_w,
+                       .k = icg,
+                       .lda = icg,
+                       .ldb = pixels,
+                       .ldc = rows * plan.output_w};
+  std::vector<T> product(s == 1 ? 0 : static_cast<size_t>(ocg) * params.n);
+  for (uint32_t g = 0; g < p.groups; ++g) {
+    auto epilogue = GetOutputStageEpilogue(stage, p.layout, g * ocg, ocg);
+    for (uint32_t n = 0; n < p.batch; ++n) {
+      T* dst = output + (static_cast<size_t>(n) * p.output_c + g * ocg) *
+                            pooled_pixels;
+      Result result = Gemm<T>(
+          params, weight + static_cast<size_t>(g) * ocg * icg,
+          input + (static_cast<size_t>(n) * p.input_c + g * icg) * pixels,
+          s == 1 ? dst : product.data(), epilogue.get());
+      if (result != Result::kSuccess) return result;
+      if (s > 1) {
+        PoolPlanes<T>(stage, ocg, rows, plan.output_w, product.data(),
+                      {params.n, plan.output_w, 1}, dst,
+                      {pooled_pixels, plan.output_w / 2, 1});
+      }
+    }
+  }
+  return Result::kSuccess;
+}
+
+/*
+ * Lowers pixels [|pixel_begin|, |pixel_end|) of group |g| into |lowered|, a
+ * (input channels of a group * kernel_h * kernel_w) by pixels matrix. The
+ * pixels of the images of the batch are numbered one after another i.e.,
+ * pixel q is pixel q % (output_h * output_w) of image q / (output_h *
+ * output_w). Rows of the lowered matrix are filled in parallel.
+ */
+template <typename T>
+void Im2col(const Conv2dPlan& plan, const T* input, uint32_t g,
+            uint32_t pixel_begin, uint32_t pixel_end, T* lowered) {
+  const Conv2dParams& p = plan.params;
+  const uint32_t icg = p.input_c / p.groups;
+  const uint32_t kernel_size = p.kernel_h * p.kernel_w;
+  const uint32_t image_pixels = plan.output_h * plan.output_w;
+  const uint32_t pixels = pixel_end - pixel_begin;
+  ParallelFor(icg * kernel_size, [&](uint32_t r) {
+    const uint32_t ic = r / kernel_size;
+    const uint32_t kh = r % kernel_size / p.kernel_w;
+    const uint32_t kw = r % p.kernel_w;
+    T* dst = lowered + static_cast<size_t>(r) * pixels;
+
+    // Walk the block one output row at a time. A row never crosses images.
+    for (uint32_t pixel = pixel_begin; pixel < pixel_end;) {
+      const uint32_t n = pixel / image_pixels;
+      const uint32_t oh = pixel % image_pixels / plan.output_w;
+      const uint32_t ow_begin = pixel % plan.output_w;
+      const uint32_t ow_end =
+          std::min(plan.output_w, ow_begin + (pixel_end - pixel));
+      const T* channel =
+          input + (static_cast<size_t>(n) * p.input_c + g * icg + ic) *
+                      p.input_h * p.input_w;
+      const int32_t row = plan.input_rows[oh * p.kernel_h + kh];
+      for (uint32_t ow = ow_begin; ow < ow_end; ++ow) {
+        const int32_t col = plan.input_cols[ow * p.kernel_w + kw];
+        *dst++ = row < 0 || col < 0
+                     ? FromFloat<T>(0.0f)
+                     : channel[static_cast<size_t>(row) * p.input_w + col];
+      }
+      pixel += ow_end - ow_begin;
+    }
+  });
+}
+
+/*
+ * The output of each group is weight (ocg x depth) * lowered input (depth x
+ * pixels). Pixels are lowered and multiplied in blocks whose lowered matrix
+ * fits in |memory_budget| bytes. A block smaller than an image stays in the
+ * image, and its product is stored into the output directly. Otherwise a
+ * block holds whole images, so the weight is multiplied once for several
+ * small images, and the product is copied to the images afterwards.
+ *
+ * With pooling, a block smaller than an image holds pairs of output rows,
+ * and skips an odd last row. The product of every block goes to a scratch
+ * buffer and is pooled into the output instead of being copied.
+ */
+template <typename T>
+Result RunIm2col(const Conv2dPlan& plan, const Conv2dOutputStage& stage,
+                 const T* input, const T* weight, T* output,
+                 size_t memory_budget) {
+  const Conv2dParams& p = plan.params;
+  const uint32_t ocg = p.output_c / p.groups;
+  const uint32_t depth = p.input_c / p.groups * p.kernel_h * p.kernel_w;
+  const uint32_t pixels = plan.output_h * plan.output_w;
+  const uint32_t total_pixels = p.batch * pixels;
+  const uint32_t s = stage.GetPoolingSize();
+  const uint32_t rows = plan.output_h / s * s;
+  const uint32_t pooled_w = plan.output_w / s;
+  const uint32_t pooled_pixels = plan.output_h / s * pooled_w;
+  uint32_t block_pixels = static_cast<uint32_t>(std::clamp<size_t>(
+      memory_budget / (static_cast<size_t>(depth) * sizeof(T)), 1,
+      total_pixels));
+  const bool whole_images = block_pixels >= pixels;
+  if (whole_images) {
+    block_pixels = block_pixels / pixels * pixels;
+  } else if (s > 1) {
+    const uint32_t row_pair = 2 * plan.output_w;
+    block_pixels = std::max(block_pixels / row_pair, 1u) * row_pair;
+  }
+  const bool to_product = whole_images || s > 1;
+  std::vector<T> lowered(static_cast<size_t>(depth) * block_pixels);
+  std::vector<T> product(to_product ? static_cast<size_t>(ocg) * block_pixels
+                                    : 0);
+
+  for (uint32_t g = 0; g < p.groups; ++g) {
+    auto epilogue = GetOutputStageEpilogue(stage, p.layout, g * ocg, ocg);
+    for (uint32_t pixel_begin = 0; pixel_begin < total_pixels;) {
+      uint32_t pixel_end = std::min(total_pixels, pixel_begin + block_pixels);
+      if (!whole_images) {
+        pixel_end = std::min(pixel_end,
+                             pixel_begin / pixels * pixels +
+                                 rows * plan.output_w);
+      }
+      Im2col(plan, input, g, pixel_begin, pixel_end, lowered.data());
+
+      const uint32_t width = pixel_end - pixel_begin;
+      const uint32_t n = pixel_begin / pixels;
+      T* dst = to_product
+                   ? product.data()
+                   : output +
+                         (static_cast<size_t>(n) * p.output_c + g * ocg) *
+                             pixels +
+                         pixel_begin % pixels;
+      GemmParams params = {.m = ocg,
+                           .n = width,
+                           .k = depth,
+                           .lda = depth,
+                           .ldb = width,
+                           .ldc = to_product ? width : pixels};
+      Result result =
+          Gemm<T>(params, weight + static_cast<size_t>(g) * ocg * depth,
+                  lowered.data(), dst, epilogue.get());
+      if (result != Result::kSuccess) return result;
+
+      if (whole_images && s == 1) {
+        const uint32_t images = width / pixels;
+        ParallelFor(images * ocg, [&](uint32_t item) {
+          const uint32_t i = item / ocg;
+          const uint32_t o = item % ocg;
+          std::copy_n(product.data() + static_cast<size_t>(o) * width +
+                          i * pixels,
+                      pixels,
+                      output + (static_cast<size_t>(n + i) * p.output_c +
+                                g * ocg + o) *
+                                   pixels);
+        });
+      } else if (whole_images) {
+        for (uint32_t i = 0; i < width / pixels; ++i) {
+          PoolPlanes<T>(stage, ocg, rows, plan.output_w,
+                        product.data() + static_cast<size_t>(i) * pixels,
+                        {width, plan.output_w, 1},
+                        output + (static_cast<size_t>(n + i) * p.output_c +
+                                  g * ocg) *
+                                     pooled_pixels,
+                        {pooled_pixels, pooled_w, 1});
+        }
+      } else if (s > 1) {
+        const uint32_t oh = pixel_begin % pixels / plan.output_w;
+        PoolPlanes<T>(stage, ocg, width / plan.output_w, plan.output_w,
+                      product.data(), {width, plan.output_w, 1},
+                      output +
+                          (static_cast<size_t>(n) * p.output_c + g * ocg) *
+                              pooled_pixels +
+                          oh / 2 * pooled_w,
+                      {pooled_pixels, pooled_w, 1});
+      }
+
+      // Skip an odd last row, which the pooling drops.
+      pixel_begin = pixel_end;
+      if (!whole_images && pixel_begin % pixels == rows * plan.output_w) {
+        pixel_begin += pixels - rows * plan.output_w;
+      }
+    }
+  }
+  return Result::kSuccess;
+}
+
+/*
+ * Computes output channels [|oc_begin|, |oc_begin| + |count|) of columns
+ * [|ow_first|, |ow_last|) of output row |oh| of image |n|,
+ * |plan.block_output_w| columns at a time. With pooling, it computes rows
+ * |oh| and |oh| + 1 and pools them as it stores them (see StoreOutputRow()).
+ */
+template <typename T>
+void RunDirectRow(const Conv2dPlan& plan, const Conv2dOutputStage& stage,
+                  const T* input, const T* weight, T* output, uint32_t n,
+                  uint32_t oh, uint32_t oc_begin, uint32_t count,
+                  uint32_t ow_first, uint32_t ow_last) {
+  const Conv2dParams& p = plan.params;
+  const uint32_t icg = p.input_c / p.groups;
+  const uint32_t ocg = p.output_c / p.groups;
+  const uint32_t g = oc_begin / ocg;
+  const uint32_t kernel_size = p.kernel_h * p.kernel_w;
+  const uint32_t s = stage.GetPoolingSize();
+  const uint32_t block_w = plan.block_output_w / s * s;
+
+  float acc[2][kMaxConvBlockOutputChannelsCPU][kMaxConvBlockOutputWidthCPU];
+  float pixels[kMaxConvBlockOutputWidthCPU];
+  for (uint32_t ow_begin = ow_first; ow_begin < ow_last;
+       ow_begin += block_w) {
+    const uint32_t width = std::min(block_w, ow_last - ow_begin);
+    for (uint32_t r = 0; r < s; ++r) {
+      for (uint32_t o = 0; o < count; ++o) std::fill_n(acc[r][o], width, 0.0f);
+    }
+
+    for (uint32_t ic = 0; ic < icg; ++ic) {
+      const T* channel =
+          input + (static_cast<size_t>(n) * p.input_c + g * icg + ic) *
+                      p.input_h * p.input_w;
+      for (uint32_t r = 0; r < s; ++r) {
+        for (uint32_t kh = 0; kh < p.kernel_h; ++kh) {
+          const int32_t row = plan.input_rows[(oh + r) * p.kernel_h + kh];
+          if (row < 0) continue;
+          const T* input_row = channel + static_cast<size_t>(row) * p.input_w;
+          for (uint32_t kw = 0; kw < p.kernel_w; ++kw) {
+            for (uint32_t ow = 0; ow < width; ++ow) {
+              const int32_t col =
+                  plan.input_cols[(ow_begin + ow) * p.kernel_w + kw];
+              pixels[ow] = col < 0 ? 0.0f : ToFloat(input_row[col]);
+            }
+            for (uint32_t o = 0; o < count; ++o) {
+              const float w = ToFloat(
+                  weight[(static_cast<size_t>(oc_begin + o) * icg + ic) *
+                             kernel_size +
+                         kh * p.kernel_w + kw]);
+              for (uint32_t ow = 0; ow < width; ++ow) {
+                acc[r][o][ow] += w * pixels[ow];
+              }
+            }
+          }
+        }
+      }
+    }
+
+    for (uint32_t o = 0; o < count; ++o) {
+      StoreOutputRow(plan, stage, acc[0][o], acc[1][o], output, n,
+                     oc_begin + o, oh, ow_begin, width);
+    }
+  }
+}
+
+/*
+ * Work items are from PartitionConv2d(). With pooling, they hold pairs of
+ * rows.
+ */
+template <typename T>
+Result RunDirect(const Conv2dPlan& plan, const Conv2dOutputStage& stage,
+                 const T* input, const T* weight, T* output) {
+  const uint32_t s = stage.GetPoolingSize();
+  const Conv2dPartition partition = PartitionConv2d(
+      plan, plan.block_output_c, 1, kMinConvTileWidthCPU, 0, false, s > 1);
+  ParallelFor(partition.GetNumberOfItems(), [&](uint32_t index) {
+    const Conv2dWorkItem item = partition.GetItem(index);
+    for (uint32_t oh = item.oh_begin; oh < item.oh_end; oh += s) {
+      RunDirectRow(plan, stage, input, weight, output, item.n, oh,
+                   item.oc_begin, item.oc_end - item.oc_begin, item.ow_begin,
+                   item.ow_end);
+    }
+  });
+  return Result::kSuccess;
+}
+
+/*
+ * The output pixels of each group are input pixels (pixels x icg) * weight
+ * (icg x ocg), with the images of the batch as more rows of the input. With
+ * pooling, the product of a group of an image, without an odd last row, goes
+ * to a scratch buffer and is pooled into the output.
+ */
+template <typename T>
+Result RunPointwiseNHWC(const Conv2dPlan& plan,
+                        const Conv2dOutputStage& stage, const T* input,
+                        const T* weight, T* output) {
+  const Conv2dParams& p = plan.params;
+  const uint32_t icg = p.input_c / p.groups;
+  const uint32_t ocg = p.output_c / p.groups;
+  const uint32_t pixels = p.input_h * p.input_w;
+  const uint32_t s = stage.GetPoolingSize();
+  GemmParams params = {.m = p.batch * pixels,
+                       .n = ocg,
+                       .k = icg,
+                       .lda = p.input_c,
+                       .ldb = p.output_c,
+                       .ldc = p.output_c};
+  if (s == 1) {
+    for (uint32_t g = 0; g < p.groups; ++g) {
+      auto epilogue = GetOutputStageEpilogue(stage, p.layout, g * ocg, ocg);
+      Result result = Gemm<T>(params, input + g * icg, weight + g * ocg,
+                              output + g * ocg, epilogue.get());
+      if (result != Result::kSuccess) return result;
+    }
+    return Result::kSuccess;
+  }
+
+  const uint32_t rows = plan.output_h / 2 * 2;
+  const uint32_t pooled_w = plan.output_w / 2;
+  const uint32_t pooled_pixels = plan.output_h / 2 * pooled_w;
+  params.m = rows * plan.output_w;
+  params.ldc = ocg;
+  std::vector<T> product(static_cast<size_t>(params.m) * ocg);
+  for (uint32_t g = 0; g < p.groups; ++g) {
+    auto epilogue = GetOutputStageEpilogue(stage, p.layout, g * ocg, ocg);
+    for (uint32_t n = 0; n < p.batch; ++n) {
+      Result result = Gemm<T>(
+          params, input + static_cast<size_t>(n) * pixels * p.input_c + g * icg,
+          weight + g * ocg, product.data(), epilogue.get());
+      if (result != Result::kSuccess) return result;
+      PoolPlanes<T>(
+          stage, ocg, rows, plan.output_w, product.data(),
+          {1, static_cast<size_t>(plan.output_w) * ocg, ocg},
+          output + static_cast<size_t>(n) * pooled_pixels * p.output_c +
+              g * ocg,
+          {1, static_cast<size_t>(pooled_w) * p.output_c, p.output_c});
+    }
+  }
+  return Result::kSuccess;
+}
+
+/*
+ * Computes up to kNHWCTilePixelsCPU output pixels of columns [|ow|, |ow_end|)
+ * of output row |oh| of image |n|, for up to kNHWCTileChannelsCPU output
+ * channels of [|oc|, |oc_end|), which are in a single group. The inner loops
+ * run over contiguous channels. With pooling, it computes the tile of rows
+ * |oh| and |oh| + 1 and pools them as it stores them (see StoreOutputTile()).
+ */
+template <typename T>
+void RunDirectNHWCTile(const Conv2dPlan& plan, const Conv2dOutputStage& stage,
+                       const T* input, const T* weight, T* output, uint32_t n,
+                       uint32_t oh, uint32_t ow, uint32_t ow_end, uint32_t oc,
+                       uint32_t oc_end) {
+  const Conv2dParams& p = plan.params;
+  const uint32_t icg = p.input_c / p.groups;
+  const uint32_t g = oc / (p.output_c / p.groups);
+  const uint32_t pixels = std::min(kNHWCTilePixelsCPU, ow_end - ow);
+  const uint32_t channels = std::min(kNHWCTileChannelsCPU, oc_end - oc);
+  const uint32_t s = stage.GetPoolingSize();
+
+  float acc[2][kNHWCTilePixelsCPU][kNHWCTileChannelsCPU] = {};
+  float w[kNHWCTileChannelsCPU] = {};
+  for (uint32_t r = 0; r < s; ++r) {
+    for (uint32_t kh = 0; kh < p.kernel_h; ++kh) {
+      const int32_t row = plan.input_rows[(oh + r) * p.kernel_h + kh];
+      if (row < 0) continue;
+      const T* input_row =
+          input + (static_cast<size_t>(n) * p.input_h + row) * p.input_w *
+                      p.input_c +
+          g * icg;
+      for (uint32_t kw = 0; kw < p.kernel_w; ++kw) {
+        const T* pixel[kNHWCTilePixelsCPU];
+        for (uint32_t i = 0; i < pixels; ++i) {
+          const int32_t col = plan.input_cols[(ow + i) * p.kernel_w + kw];
+          pixel[i] = col < 0 ? nullptr
+                             : input_row + static_cast<size_t>(col) * p.input_c;
+        }
+        const T* weight_element =
+            weight + static_cast<size_t>(kh * p.kernel_w + kw) * icg *
+                         p.output_c +
+            oc;
+        for (uint32_t ic = 0; ic < icg; ++ic) {
+          const T* weight_row = weight_element + ic * p.output_c;
+          for (uint32_t j = 0; j < channels; ++j) w[j] = ToFloat(weight_row[j]);
+          for (uint32_t i = 0; i < pixels; ++i) {
+            if (pixel[i] == nullptr) continue;
+            const float x = ToFloat(pixel[i][ic]);
+            for (uint32_t j = 0; j < kNHWCTileChannelsCPU; ++j) {
+              acc[r][i][j] += x * w[j];
+            }
+          }
+        }
+      }
+    }
+  }
+
+  StoreOutputTile(plan, stage, acc, output, n, oh, ow, pixels, oc, channels);
+}
+
+/*
+ * Work items are from PartitionConv2d(), with at most kNHWCBlockChannelsCPU
+ * output channels and whole register tiles where possible. With pooling,
+ * they hold pairs of rows.
+ */
+template <typename T>
+Result RunDirectNHWC(const Conv2dPlan& plan, const Conv2dOutputStage& stage,
+                     const T* input, const T* weight, T* output) {
+  const uint32_t s = stage.GetPoolingSize();
+  const Conv2dPartition partition =
+      PartitionConv2d(plan, kNHWCBlockChannelsCPU, kNHWCTileChannelsCPU,
+                      kNHWCTilePixelsCPU, 0, false, s > 1);
+  ParallelFor(partition.GetNumberOfItems(), [&](uint32_t index) {
+    const Conv2dWorkItem item = partition.GetItem(index);
+    for (uint32_t oh = item.oh_begin; oh < item.oh_end; oh += s) {
+      for (uint32_t ow = item.ow_begin; ow < item.ow_end;
+           ow += kNHWCTilePixelsCPU) {
+        for (uint32_t oc = item.oc_begin; oc < item.oc_end;
+             oc += kNHWCTileChannelsCPU) {
+          RunDirectNHWCTile(plan, stage, input, weight, output, item.n, oh,
+                            ow, item.ow_end, oc, item.oc_end);
+        }
+      }
+    }
+  });
+  return Result::kSuccess;
+}
+
+/*
+ * Returns, for each kernel column kw, the range of output columns whose
+ * input column of kw is not in the padding.
+ */
+std::vector<std::pair<uint32_t, uint32_t>> GetValidOutputColumns(
+    const Conv2dPlan& plan) {
+  const uint32_t kernel_w = plan.params.kernel_w;
+  std::vector<std::pair<uint32_t, uint32_t>> valid_cols(kernel_w, {0, 0});
+  for (uint32_t kw = 0; kw < kernel_w; ++kw) {
+    uint32_t begin = 0;
+    while (begin < plan.output_w &&
+           plan.input_cols[begin * kernel_w + kw] < 0) {
+      ++begin;
+    }
+    uint32_t end = begin;
+    while (end < plan.output_w && plan.input_cols[end * kernel_w + kw] >= 0) {
+      ++end;
+    }
+    valid_cols[kw] = {begin, end};
+  }
+  return valid_cols;
+}
+
+/*
+ * Computes output channels [|oc_begin|, |oc_end|) of columns [|ow_first|,
+ * |ow_last|) of output row |oh| of image |n| for kGrouped, one channel and
+ * |plan.block_output_w| columns at a time. |valid_cols| is from
+ * GetValidOutputColumns(). With pooling, it computes rows |oh| and |oh| + 1
+ * and pools them as it stores them (see StoreOutputRow()).
+ */
+template <typename T>
+void RunGroupedRow(const Conv2dPlan& plan, const Conv2dOutputStage& stage,
+                   const std::vector<std::pair<uint32_t, uint32_t>>& valid_cols,
+                   const T* input, const T* weight, T* output, uint32_t n,
+                   uint32_t oh, uint32_t oc_begin, uint32_t oc_end,
+                   uint32_t ow_first, uint32_t ow_last) {
+  const Conv2dParams& p = plan.params;
+  const uint32_t icg = p.input_c / p.groups;
+  const uint32_t ocg = p.output_c / p.groups;
+  const uint32_t kernel_size = p.kernel_h * p.kernel_w;
+  const uint32_t s = stage.GetPoolingSize();
+  const uint32_t block_w = plan.block_output_w / s * s;
+
+  float acc[2][kMaxConvBlockOutputWidthCPU];
+  for (uint32_t oc = oc_begin; oc < oc_end; ++oc) {
+    const uint32_t g = oc / ocg;
+    for (uint32_t ow_begin = ow_first; ow_begin < ow_last;
+         ow_begin += block_w) {
+      const uint32_t ow_end = std::min(ow_last, ow_begin + block_w);
+      for (uint32_t r = 0; r < s; ++r) {
+        std::fill_n(acc[r], ow_end - ow_begin, 0.0f);
+      }
+
+      for (uint32_t ic = 0; ic < icg; ++ic) {
+        const T* channel =
+            input + (static_cast<size_t>(n) * p.input_c + g * icg + ic) *
+                        p.input_h * p.input_w;
+        for (uint32_t r = 0; r < s; ++r) {
+          for (uint32_t kh = 0; kh < p.kernel_h; ++kh) {
+            const int32_t row = plan.input_rows[(oh + r) * p.kernel_h + kh];
+            if (row < 0) continue;
+            const T* input_row = channel + static_cast<size_t>(row) * p.input_w;
+            for (uint32_t kw = 0; kw < p.kernel_w; ++kw) {
+              const uint32_t begin = std::max(ow_begin, valid_cols[kw].first);
+              const uint32_t end = std::min(ow_end, valid_cols[kw].second);
+              if (begin >= end) continue;
+              const float w = ToFloat(
+                  weight[(static_cast<size_t>(oc) * icg + ic) * kernel_size +
+                         kh * p.kernel_w + kw]);
+              const T* src =
+                  input_row + plan.input_cols[begin * p.kernel_w + kw];
+              float* dst = acc[r] + (begin - ow_begin);
+              if (p.stride_w == 1) {
+                for (uint32_t i = 0; i < end - begin; ++i) {
+                  dst[i] += w * ToFloat(src[i]);
+                }
+              } else {
+                for (uint32_t i = 0; i < end - begin; ++i) {
+                  dst[i] += w * ToFloat(src[i * p.stride_w]);
+                }
+              }
+            }
+          }
+        }
+      }
+
+      StoreOutputRow(plan, stage, acc[0], acc[1], output, n, oc, oh,
+                     ow_begin, ow_end - ow_begin);
+    }
+  }
+}
+
+/*
+ * Work items are from PartitionConv2d(). With pooling, they hold pairs of
+ * rows.
+ */
+template <typename T>
+Result RunGrouped(const Conv2dPlan& plan, const Conv2dOutputStage& stage,
+                  const T* input, const T* weight, T* output) {
+  const auto valid_cols = GetValidOutputColumns(plan);
+  const uint32_t s = stage.GetPoolingSize();
+  const Conv2dPartition partition = PartitionConv2d(
+      plan, plan.block_output_c, 1, kMinConvTileWidthCPU, 0, false, s > 1);
+  ParallelFor(partition.GetNumberOfItems(), [&](uint32_t index) {
+    const Conv2dWorkItem item = partition.GetItem(index);
+    for (uint32_t oh = item.oh_begin; oh < item.oh_end; oh += s) {
+      RunGroupedRow(plan, stage, valid_cols, input, weight, output, item.n,
+                    oh, item.oc_begin, item.oc_end, item.ow_begin,
+                    item.ow_end);
+    }
+  });
+  return Result::kSuccess;
+}
+
+/*
+ * Computes up to kNHWCTilePixelsCPU output pixels of columns [|ow|, |ow_end|)
+ * of output row |oh| of image |n|, for up to kNHWCTileChannelsCPU output
+ * channels of [|oc|, |oc_end|) for kGrouped. The channels may be in
+ * different groups, and lane j of the tile reads the input channels of the
+ * group of channel |oc| + j. With a single input and output channel per
+ * group (depthwise), the lanes read contiguous input channels. With pooling,
+ * it computes the tile of rows |oh| and |oh| + 1 and pools them as it stores
+ * them (see StoreOutputTile()).
+ */
+template <typename T>
+void RunGroupedNHWCTile(const Conv2dPlan& plan, const Conv2dOutputStage& stage,
+                        const T* input, const T* weight, T* output, uint32_t n,
+                        uint32_t oh, uint32_t ow, uint32_t ow_end, uint32_t oc,
+                        uint32_t oc_end) {
+  const Conv2dParams& p = plan.params;
+  const uint32_t icg = p.input_c / p.groups;
+  const uint32_t ocg = p.output_c / p.groups;
+  const bool depthwise = icg == 1 && ocg == 1;
+  const uint32_t pixels = std::min(kNHWCTilePixelsCPU, ow_end - ow);
+  const uint32_t channels = std::min(kNHWCTileChannelsCPU, oc_end - oc);
+  const uint32_t s = stage.GetPoolingSize();
+
+  // The first input channel of the group of each lane. Lanes past |channels|
+  // repeat the first lane so that they stay in the input.
+  uint32_t first_ic[kNHWCTileChannelsCPU];
+  for (uint32_t j = 0; j < kNHWCTileChannelsCPU; ++j) {
+    first_ic[j] = (oc + (j < channels ? j : 0)) / ocg * icg;
+  }
+
+  float acc[2][kNHWCTilePixelsCPU][kNHWCTileChannelsCPU] = {};
+  float w[kNHWCTileChannelsCPU] = {};
+  for (uint32_t r = 0; r < s; ++r) {
+    for (uint32_t kh = 0; kh < p.kernel_h; ++kh) {
+      const int32_t row = plan.input_rows[(oh + r) * p.kernel_h + kh];
+      if (row < 0) continue;
+      const T* input_row =
+          input +
+          (static_cast<size_t>(n) * p.input_h + row) * p.input_w * p.input_c;
+      for (uint32_t kw = 0; kw < p.kernel_w; ++kw) {
+        const T* pixel[kNHWCTilePixelsCPU];
+        for (uint32_t i = 0; i < pixels; ++i) {
+          const int32_t col = plan.input_cols[(ow + i) * p.kernel_w + kw];
+          pixel[i] = col < 0 ? nullptr
+                             : input_row + static_cast<size_t>(col) * p.input_c;
+        }
+        const T* weight_element =
+            weight + static_cast<size_t>(kh * p.kernel_w + kw) * icg *
+                         p.output_c +
+            oc;
+        for (uint32_t ic = 0; ic < icg; ++ic) {
+          const T* weight_row = weight_element + ic * p.output_c;
+          for (uint32_t j = 0; j < channels; ++j) w[j] = ToFloat(weight_row[j]);
+          for (uint32_t i = 0; i < pixels; ++i) {
+            if (pixel[i] == nullptr) continue;
+            if (depthwise) {
+              const T* x = pixel[i] + oc;
+              for (uint32_t j = 0; j < channels; ++j) {
+                acc[r][i][j] += ToFloat(x[j]) * w[j];
+              }
+            } else {
+              for (uint32_t j = 0; j < kNHWCTileChannelsCPU; ++j) {
+                acc[r][i][j] += ToFloat(pixel[i][first_ic[j] + ic]) * w[j];
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+
+  StoreOutputTile(plan, stage, acc, output, n, oh, ow, pixels, oc, channels);
+}
+
+/*
+ * Work items are from PartitionConv2d() with channel blocks across groups,
+ * with at most kNHWCBlockChannelsCPU output channels. With pooling, they hold
+ * pairs of rows.
+ */
+template <typename T>
+Result RunGroupedNHWC(const Conv2dPlan& plan, const Conv2dOutputStage& stage,
+                      const T* input, const T* weight, T* output) {
+  const uint32_t s = stage.GetPoolingSize();
+  const Conv2dPartition partition = PartitionConv2d(
+      plan, kNHWCBlockChannelsCPU, kNHWCTileChannelsCPU, kNHWCTilePixelsCPU, 0,
+      true, s > 1);
+  ParallelFor(partition.GetNumberOfItems(), [&](uint32_t index) {
+    const Conv2dWorkItem item = partition.GetItem(index);
+    for (uint32_t oh = item.oh_begin; oh < item.oh_end; oh += s) {
+      for (uint32_t ow = item.ow_begin; ow < item.ow_end;
+           ow += kNHWCTilePixelsCPU) {
+        for (uint32_t oc = item.oc_begin; oc < item.oc_end;
+             oc += kNHWCTileChannelsCPU) {
+          RunGroupedNHWCTile(plan, stage, input, weight, output, item.n, oh,
+                             ow, item.ow_end, oc, item.oc_end);
+        }
+      }
+    }
+  });
+  return Result::kSuccess;
+}
+
+template <typename T>
+Result RunCpu(const Conv2dPlan& plan, Conv2dAlgorithm algorithm,
+              const Conv2dOutputStage& stage, size_t im2col_memory_budget,
+              const float* winograd_weight, const T* input, const T* weight,
+              T* output) {
+  if (plan.params.layout == Conv2dLayout::kNHWC) {
+    assert(IsConv2dAlgorithmSupported(plan.params, algorithm));
+    switch (algorithm) {
+      case Conv2dAlgorithm::kPointwise:
+        return RunPointwiseNHWC<T>(plan, stage, input, weight, output);
+      case Conv2dAlgorithm::kGrouped:
+        return RunGroupedNHWC<T>(plan, stage, input, weight, output);
+      default:
+        return RunDirectNHWC<T>(plan, stage, input, weight, output);
+    }
+  }
+  switch (algorithm) {
+    case Conv2dAlgorithm::kPointwise:
+      return RunPointwise<T>(plan, stage, input, weight, output);
+    case Conv2dAlgorithm::kIm2col:
+      return RunIm2col<T>(plan, stage, input, weight, output,
+                          im2col_memory_budget);
+    case Conv2dAlgorithm::kWinograd2x2:
+    case Conv2dAlgorithm::kWinograd4x4:
+      return RunWinograd<T>(plan, algorithm, stage, input, winograd_weight,
+                            output);
+    case Conv2dAlgorithm::kGrouped:
+      return RunGrouped<T>(plan, stage, input, weight, output);
+    case Conv2dAlgorithm::kDirect:
+      return RunDirect<T>(plan, stage, input, weight, output);
+  }
+  return Result::kFail;
+}
+
+bool IsWinograd(Conv2dAlgorithm algorithm) {
+  return algorithm == Conv2dAlgorithm::kWinograd2x2 ||
+         algorithm == Conv2dAlgorithm::kWinograd4x4;
+}
+
+} /* namespace */
+
+template <typename T>
+std::shared_ptr<Buffer<T>> CpuConv<T>::PrepareWeight() {
+  if (!IsBatchNormFolded()) return this->weight_;
+  if (folded_weight_source_ != this->weight_ ||
+      folded_weight_version_ != this->weight_->GetVersion()) {
+    const size_t size = this->params_.GetWeightSize();
+    if (folded_weight_ == nullptr) {
+      folded_weight_ = std::make_shared<Buffer<T>>(size);
+    }
+    FoldBatchNorm<T>(this->params_, epilogue_,
+                     this->weight_->GetVector().data(),
+                     folded_weight_->GetVector().data());
+    folded_weight_->MarkDirty(0, size);
+    folded_weight_source_ = this->weight_;
+    folded_weight_version_ = this->weight_->GetVersion();
+  }
+  return folded_weight_;
+}
+
+template <typename T>
+Result CpuConv<T>::RunSpatialTiles(std::shared_ptr<Buffer<T>> weight,
+                                   T* output) {
+  const Conv2dParams& p = this->params_;
+  const Conv2dSpatialTiling& tiling = spatial_tiling_;
+  const bool nchw = p.layout == Conv2dLayout::kNCHW;
+  const uint32_t s = output_stage_.GetPoolingSize();
+  const uint32_t output_h = this->plan_->output_h / s;
+  const uint32_t output_w = this->plan_->output_w / s;
+  const T* input = this->input_->GetVector().data();
+
+  for (uint32_t n = 0; n < p.batch; ++n) {
+    for (uint32_t index = 0; index < tiling.GetNumberOfTiles(); ++index) {
+      // With pooling, the tiles have even sizes except the last ones, whose
+      // odd last row or column is dropped as it is for the whole output.
+      const Conv2dSpatialTile tile = tiling.GetTile(index);
+      const uint32_t tile_h = (tile.oh_end - tile.oh_begin) / s;
+      const uint32_t tile_w = (tile.ow_end - tile.ow_begin) / s;
+      if (tile_h == 0 || tile_w == 0) continue;
+      Conv2dParams tile_params = p;
+      tile_params.batch = 1;
+      tile_params.input_h = tile.ih_end - tile.ih_begin;
+      tile_params.input_w = tile.iw_end - tile.iw_begin;
+      tile_params.padding_h = 0;
+      tile_params.padding_w = 0;
+      TileOp& tile_op = tile_ops_[tile_params];
+      if (tile_op.op == nullptr) {
+        // The tile runs the output stage of this op, with its pooling, on
+        // |weight|, which already has the batch norm folded in when it is
+        // folded.
+        tile_op.op = std::make_unique<CpuConv<T>>(tile_params);
+        tile_op.op->output_stage_ = output_stage_;
+        tile_op.op->output_size_ =
+            static_cast<size_t>(p.output_c) * tile_h * tile_w;
+        tile_op.input =
+            std::make_shared<Buffer<T>>(tile_params.GetInputSize());
+        tile_op.output =
+            std::make_shared<Buffer<T>>(tile_op.op->output_size_);
+      }
+      // Bound on every run, so the tiles follow SetBuffers() of this op.
+      tile_op.op->SetBuffers(tile_op.input, weight, tile_op.output);
+      tile_op.op->SetAlgorithm(this->algorithm_);
+      tile_op.op->SetIm2colMemoryBudget(im2col_memory_budget_);
+
+      // Gather the footprint. The padding, and the halo past the input, are
+      // zeros.
+      const uint32_t rows = tile_params.input_h;
+      const uint32_t cols = tile_params.input_w;
+      const uint32_t col_begin = std::max(tile.iw_begin, 0);
+      const uint32_t col_end =
+          std::min(tile.iw_end, static_cast<int32_t>(p.input_w));
+      T* tile_input = tile_op.input->GetVector().data();
+      ParallelFor(nchw ? p.input_c * rows : rows, [&](uint32_t item) {
+        const uint32_t c = nchw ? item / rows : 0;
+        const int32_t row = tile.ih_begin + static_cast<int32_t>(item % rows);
+        const uint32_t channels = nchw ? 1 : p.input_c;
+        T* dst = tile_input + static_cast<size_t>(item) * cols * channels;
+        std::fill_n(dst, static_cast<size_t>(cols) * channels,
+                    FromFloat<T>(0.0f));
+        if (row < 0 || row >= static_cast<int32_t>(p.input_h) ||
+            col_begin >= col_end) {
+          return;
+        }
+        const T* src =
+            input +
+            ((static_cast<size_t>(n) * (nchw ? p.input_c : 1) + c) *
+                 p.input_h +
+             row) * p.input_w * channels;
+        std::copy(src + static_cast<size_t>(col_begin) * channels,
+                  src + static_cast<size_t>(col_end) * channels,
+                  dst + static_cast<size_t>(col_begin - tile.iw_begin) *
+                            channels);
+      });
+
+      Result result = tile_op.op->Run();
+      if (result != Result::kSuccess) return result;
+
+      // Scatter the output of the tile.
+      const T* tile_output = tile_op.output->GetVector().data();
+      ParallelFor(nchw ? p.output_c * tile_h : tile_h, [&](uint32_t item) {
+        const uint32_t c = nchw ? item / tile_h : 0;
+        const uint32_t oh = tile.oh_begin / s + item % tile_h;
+        const uint32_t channels = nchw ? 1 : p.output_c;
+        std::copy_n(
+            tile_output + static_cast<size_t>(item) * tile_w * channels,
+            static_cast<size_t>(tile_w) * channels,
+            output + (((static_cast<size_t>(n) * (nchw ? p.output_c : 1) + c) *
+                           output_h +
+                       oh) *
+                          output_w +
+                      tile.ow_begin / s) *
+                         channels);
+      });
+    }
+  }
+  return Result::kSuccess;
+}
+
+template <typename T>
+Result CpuConv<T>::RunOnHost() {
+  T* output = this->output_->GetVector().data();
+  std::shared_ptr<Buffer<T>> weight = PrepareWeight();
+  if (spatial_tile_budget_ > 0) return RunSpatialTiles(weight, output);
+
+  std::shared_ptr<const PackedConv2dWeight<T>> winograd_weight;
+  if (IsWinograd(this->algorithm_)) {
+    winograd_weight = GetPackedConv2dWeight<T>(
+        *this->plan_,
+        this->algorithm_ == Conv2dAlgorithm::kWinograd2x2
+            ? Conv2dWeightLayout::kWinograd2x2
+            : Conv2dWeightLayout::kWinograd4x4,
+        weight);
+  }
+  return RunCpu<T>(
+      *this->plan_, this->algorithm_, output_stage_, im2col_memory_budget_,
+      winograd_weight ? winograd_weight->winograd.data() : nullptr,
+      this->input_->GetVector().data(), weight->GetVector().data(), output);
+}
+
+template <>
+Result CpuConv<bfloat16>::Run() {
+  return RunOnHost();
+}
+
+template <>
+Result CpuConv<float>::Run() {
+  return RunOnHost();
+}
+
+} /* namespace tiny */
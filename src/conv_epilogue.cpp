@@ -0,0 +1,101 @@
+// Copyright (c) 2024 Jaebaek Seo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "conv_epilogue.h"
+
+#include <cassert>
+#include <cmath>
+
+#include "tt_metal/common/bfloat16.hpp"
+#include "utils.h"
+
+namespace tiny {
+namespace {
+
+float GetBatchNormScale(const Conv2dEpilogue& epilogue, uint32_t channel) {
+  return epilogue.batch_norm_gamma[channel] /
+         std::sqrt(epilogue.batch_norm_variance[channel] +
+                   epilogue.batch_norm_epsilon);
+}
+
+} /* namespace */
+
+bool Conv2dEpilogue::IsValid(const Conv2dParams& params) const {
+  const size_t channels = params.output_c;
+  if (!bias.empty() && bias.size() != channels) return false;
+  if (HasBatchNorm() &&
+      (batch_norm_mean.size() != channels ||
+       batch_norm_variance.size() != channels ||
+       batch_norm_gamma.size() != channels ||
+       batch_norm_beta.size() != channels)) {
+    return false;
+  }
+  return pooling == Conv2dPooling::kNone ||
+         (params.GetOutputHeight() >= 2 && params.GetOutputWidth() >= 2);
+}
+
+Conv2dOutputStage GetConv2dOutputStage(const Conv2dParams& params,
+                                       const Conv2dEpilogue& epilogue,
+                                       bool batch_norm_folded) {
+  assert(epilogue.IsValid(params));
+  Conv2dOutputStage stage;
+  stage.activation = epilogue.activation;
+  stage.pooling = epilogue.pooling;
+  if (!epilogue.HasBatchNorm()) {
+    stage.shift = epilogue.bias;
+    return stage;
+  }
+
+  // ((x + bias) - mean) * scale + beta = x * scale + shift.
+  if (!batch_norm_folded) stage.scale.resize(params.output_c);
+  stage.shift.resize(params.output_c);
+  for (uint32_t c = 0; c < params.output_c; ++c) {
+    const float scale = GetBatchNormScale(epilogue, c);
+    const float bias = epilogue.bias.empty() ? 0.0f : epilogue.bias[c];
+    if (!batch_norm_folded) stage.scale[c] = scale;
+    stage.shift[c] = (bias - epilogue.batch_norm_mean[c]) * scale +
+                     epilogue.batch_norm_beta[c];
+  }
+  return stage;
+}
+
+template <typename T>
+void FoldBatchNorm(const Conv2dParams& params, const Conv2dEpilogue& epilogue,
+                   const T* weight, T* folded) {
+  assert(epilogue.HasBatchNorm() && epilogue.IsValid(params));
+  std::vector<float> scale(params.output_c);
+  for (uint32_t c = 0; c < params.output_c; ++c) {
+    scale[c] = GetBatchNormScale(epilogue, c);
+  }
+
+  // A filter is contiguous in OIHW, and the output channel is the innermost
+  // index of HWIO.
+  const size_t filter_size = params.GetWeightSize() / params.output_c;
+  for (size_t i = 0; i < params.GetWeightSize(); ++i) {
+    const uint32_t c = params.layout == Conv2dLayout::kNCHW
+                           ? i / filter_size
+                           : i % params.output_c;
+    folded[i] = FromFloat<T>(ToFloat(weight[i]) * scale[c]);
+  }
+}
+
+template void FoldBatchNorm<float>(const Conv2dParams& params,
+                                   const Conv2dEpilogue& epilogue,
+                                   const float* weight, float* folded);
+template void FoldBatchNorm<bfloat16>(const Conv2dParams& params,
+                                      const Conv2dEpilogue& epilogue,
+                                      const bfloat16* weight,
+                                      bfloat16* folded);
+
+} /* namespace tiny */
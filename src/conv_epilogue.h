@@ -0,0 +1,147 @@
+// Copyright (c) 2024 Jaebaek Seo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef conv_epilogue_h_
+#define conv_epilogue_h_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "conv_plan.h"
+#include "epilogue.h"
+
+namespace tiny {
+
+/*
+ * Pooling with 2x2 windows and stride 2. An odd last row or column of the
+ * convolution output is dropped.
+ */
+enum class Conv2dPooling {
+  kNone,
+  kMax2x2,
+  kAverage2x2,
+};
+
+/*
+ * What runs on the output of a convolution, in this order: |bias|, batch
+ * norm in inference mode, |activation| and |pooling|. The batch norm of
+ * output channel c is
+ *
+ *   (x - batch_norm_mean[c]) / sqrt(batch_norm_variance[c] +
+ *   batch_norm_epsilon) * batch_norm_gamma[c] + batch_norm_beta[c]
+ *
+ * An empty |bias| or |batch_norm_mean| means no bias or batch norm. Otherwise
+ * they, and all the batch norm vectors, have an element per output channel.
+ *
+ * With |fold_batch_norm|, the scale of the batch norm is multiplied into the
+ * weight once, when the op prepares the weight, instead of into every output
+ * element.
+ *
+ * The bias, batch norm, activation and pooling are all fused into the store
+ * of the output (see Conv2dOutputStage), so the output before the pooling is
+ * never written to memory.
+ */
+struct Conv2dEpilogue {
+  std::vector<float> bias;
+  std::vector<float> batch_norm_mean;
+  std::vector<float> batch_norm_variance;
+  std::vector<float> batch_norm_gamma;
+  std::vector<float> batch_norm_beta;
+  float batch_norm_epsilon = 1e-5f;
+  Activation activation = Activation::kNone;
+  Conv2dPooling pooling = Conv2dPooling::kNone;
+  bool fold_batch_norm = false;
+
+  bool HasBatchNorm() const { return !batch_norm_mean.empty(); }
+
+  bool IsValid(const Conv2dParams& params) const;
+
+  /* Shape of the output of |params| after the pooling. */
+  uint32_t GetOutputHeight(const Conv2dParams& params) const {
+    return pooling == Conv2dPooling::kNone ? params.GetOutputHeight()
+                                           : params.GetOutputHeight() / 2;
+  }
+
+  uint32_t GetOutputWidth(const Conv2dParams& params) const {
+    return pooling == Conv2dPooling::kNone ? params.GetOutputWidth()
+                                           : params.GetOutputWidth() / 2;
+  }
+
+  size_t GetOutputSize(const Conv2dParams& params) const {
+    return static_cast<size_t>(params.batch) * params.output_c *
+           GetOutputHeight(params) * GetOutputWidth(params);
+  }
+};
+
+/*
+ * The bias, batch norm and activation of an epilogue combined into
+ * activation(x * scale[c] + shift[c]) for output channel c, and its pooling.
+ * The CPU kernels apply it to the float accumulator of each output element
+ * before storing it, and the GEMM paths pass it to Gemm() as an Epilogue. An
+ * empty |scale| or |shift| means 1 or 0.
+ *
+ * With |pooling|, the kernels compute the output in pairs of rows and
+ * columns, and store Pool() of each 2x2 window of Apply() results instead.
+ * GEMM paths pool each block of their product right after Gemm().
+ * IsIdentity() is about Apply() only.
+ */
+struct Conv2dOutputStage {
+  std::vector<float> scale;
+  std::vector<float> shift;
+  Activation activation = Activation::kNone;
+  Conv2dPooling pooling = Conv2dPooling::kNone;
+
+  bool IsIdentity() const {
+    return scale.empty() && shift.empty() && activation == Activation::kNone;
+  }
+
+  float Apply(uint32_t channel, float x) const {
+    if (!scale.empty()) x *= scale[channel];
+    if (!shift.empty()) x += shift[channel];
+    return Activate(activation, x);
+  }
+
+  /* Rows and columns of a pooling window: 2 with pooling, 1 otherwise. */
+  uint32_t GetPoolingSize() const {
+    return pooling == Conv2dPooling::kNone ? 1 : 2;
+  }
+
+  float Pool(float x00, float x01, float x10, float x11) const {
+    return pooling == Conv2dPooling::kMax2x2
+               ? std::max({x00, x01, x10, x11})
+               : (x00 + x01 + x10 + x11) * 0.25f;
+  }
+};
+
+/*
+ * Returns the output stage of |epilogue|. With |batch_norm_folded|, the
+ * scale of the batch norm is already in the weight (see FoldBatchNorm()).
+ */
+Conv2dOutputStage GetConv2dOutputStage(const Conv2dParams& params,
+                                       const Conv2dEpilogue& epilogue,
+                                       bool batch_norm_folded);
+
+/*
+ * Writes |weight| with each filter multiplied by the batch norm scale of its
+ * output channel to |folded|, in the layout of |params|.
+ */
+template <typename T>
+void FoldBatchNorm(const Conv2dParams& params, const Conv2dEpilogue& epilogue,
+                   const T* weight, T* folded);
+
+} /* namespace tiny */
+
+#endif /* ifndef conv_epilogue_h_ */
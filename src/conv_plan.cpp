@@ -0,0 +1,366 @@
+// Copyright (c) 2024 Jaebaek Seo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "conv_plan.h"
+
+#include <algorithm>
+#include <cassert>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <utility>
+
+#include "parallel.h"
+
+namespace {
+
+struct PlanCache {
+  std::mutex mutex;
+  std::map<tiny::Conv2dParams, std::shared_ptr<const tiny::Conv2dPlan>> plans;
+};
+
+PlanCache& GetPlanCache() {
+  static PlanCache cache;
+  return cache;
+}
+
+/* Rounds |value| up to a multiple of |step|. */
+uint32_t RoundUp(uint32_t value, uint32_t step) {
+  return (value + step - 1) / step * step;
+}
+
+/*
+ * Returns the input index read by kernel element |kernel_index| for output
+ * index |output_index| along a dimension, or -1 for the padding.
+ */
+int32_t GetInputIndex(uint32_t output_index, uint32_t kernel_index,
+                      uint32_t stride, uint32_t padding, uint32_t dilation,
+                      uint32_t input_size) {
+  int64_t index = static_cast<int64_t>(output_index) * stride +
+                  static_cast<int64_t>(kernel_index) * dilation - padding;
+  if (index < 0 || index >= input_size) return -1;
+  return static_cast<int32_t>(index);
+}
+
+/*
+ * Returns the range of input indices read by output indices [|begin|, |end|)
+ * along a dimension, including the padding i.e., before clipping to the
+ * input.
+ */
+std::pair<int32_t, int32_t> GetInputRange(uint32_t begin, uint32_t end,
+                                          uint32_t kernel, uint32_t stride,
+                                          uint32_t padding,
+                                          uint32_t dilation) {
+  const int64_t first = static_cast<int64_t>(begin) * stride - padding;
+  const int64_t last = static_cast<int64_t>(end - 1) * stride +
+                       static_cast<int64_t>(kernel - 1) * dilation - padding;
+  return {static_cast<int32_t>(first), static_cast<int32_t>(last + 1)};
+}
+
+/*
+ * Returns the sum of the footprints of the tiles of |size| / |tile| along a
+ * dimension, and the footprint of the whole dimension, both clipped to the
+ * input.
+ */
+std::pair<uint64_t, uint64_t> GetFootprints(uint32_t size, uint32_t tile,
+                                            uint32_t input_size,
+                                            uint32_t kernel, uint32_t stride,
+                                            uint32_t padding,
+                                            uint32_t dilation) {
+  auto clipped = [&](uint32_t begin, uint32_t end) {
+    auto range = GetInputRange(begin, end, kernel, stride, padding, dilation);
+    return static_cast<uint64_t>(
+        std::max<int32_t>(std::min<int32_t>(range.second, input_size) -
+                              std::max<int32_t>(range.first, 0),
+                          0));
+  };
+  uint64_t sum = 0;
+  for (uint32_t begin = 0; begin < size; begin += tile) {
+    sum += clipped(begin, std::min(size, begin + tile));
+  }
+  return {sum, clipped(0, size)};
+}
+
+size_t GetTileWorkingSet(const tiny::Conv2dParams& p, uint32_t tile_h,
+                         uint32_t tile_w, size_t element_size) {
+  const auto rows =
+      GetInputRange(0, tile_h, p.kernel_h, p.stride_h, 0, p.dilation_h);
+  const auto cols =
+      GetInputRange(0, tile_w, p.kernel_w, p.stride_w, 0, p.dilation_w);
+  return element_size *
+         (static_cast<size_t>(p.input_c) * (rows.second - rows.first) *
+              (cols.second - cols.first) +
+          static_cast<size_t>(p.output_c) * tile_h * tile_w);
+}
+
+bool IsPointwise(const tiny::Conv2dParams& p) {
+  return p.kernel_h == 1 && p.kernel_w == 1 && p.stride_h == 1 &&
+         p.stride_w == 1 && p.padding_h == 0 && p.padding_w == 0;
+}
+
+bool IsWinogradShape(const tiny::Conv2dParams& p) {
+  return p.kernel_h == 3 && p.kernel_w == 3 && p.stride_h == 1 &&
+         p.stride_w == 1 && p.dilation_h == 1 && p.dilation_w == 1;
+}
+
+bool IsGroupedShape(const tiny::Conv2dParams& p) {
+  return p.groups > 1 && p.input_c / p.groups <= tiny::kMaxGroupedChannelsCPU &&
+         p.output_c / p.groups <= tiny::kMaxGroupedChannelsCPU;
+}
+
+tiny::Conv2dAlgorithm ChooseAlgorithm(const tiny::Conv2dParams& p) {
+  if (IsPointwise(p)) return tiny::Conv2dAlgorithm::kPointwise;
+  if (p.layout == tiny::Conv2dLayout::kNCHW && IsWinogradShape(p) &&
+      p.input_c / p.groups >= tiny::kMinWinogradChannelsCPU &&
+      p.output_c / p.groups >= tiny::kMinWinogradChannelsCPU) {
+    return p.GetOutputHeight() >= tiny::kMinWinograd4x4Size &&
+                   p.GetOutputWidth() >= tiny::kMinWinograd4x4Size
+               ? tiny::Conv2dAlgorithm::kWinograd4x4
+               : tiny::Conv2dAlgorithm::kWinograd2x2;
+  }
+  if (IsGroupedShape(p)) return tiny::Conv2dAlgorithm::kGrouped;
+  if (p.layout == tiny::Conv2dLayout::kNHWC) {
+    return tiny::Conv2dAlgorithm::kDirect;
+  }
+  const uint32_t depth = p.input_c / p.groups * p.kernel_h * p.kernel_w;
+  if (depth >= tiny::kMinIm2colDepthCPU &&
+      p.output_c / p.groups >= tiny::kMinIm2colOutputChannelsCPU) {
+    return tiny::Conv2dAlgorithm::kIm2col;
+  }
+  return tiny::Conv2dAlgorithm::kDirect;
+}
+
+std::shared_ptr<const tiny::Conv2dPlan> BuildPlan(
+    const tiny::Conv2dParams& p) {
+  auto plan = std::make_shared<tiny::Conv2dPlan>();
+  plan->params = p;
+  plan->output_h = p.GetOutputHeight();
+  plan->output_w = p.GetOutputWidth();
+  plan->algorithm = ChooseAlgorithm(p);
+
+  plan->input_rows.resize(plan->output_h * p.kernel_h);
+  for (uint32_t oh = 0; oh < plan->output_h; ++oh) {
+    for (uint32_t kh = 0; kh < p.kernel_h; ++kh) {
+      plan->input_rows[oh * p.kernel_h + kh] = GetInputIndex(
+          oh, kh, p.stride_h, p.padding_h, p.dilation_h, p.input_h);
+    }
+  }
+  plan->input_cols.resize(plan->output_w * p.kernel_w);
+  for (uint32_t ow = 0; ow < plan->output_w; ++ow) {
+    for (uint32_t kw = 0; kw < p.kernel_w; ++kw) {
+      plan->input_cols[ow * p.kernel_w + kw] = GetInputIndex(
+          ow, kw, p.stride_w, p.padding_w, p.dilation_w, p.input_w);
+    }
+  }
+
+  plan->block_output_c =
+      std::min(p.output_c / p.groups, tiny::kMaxConvBlockOutputChannelsCPU);
+  plan->block_output_w =
+      std::min(plan->output_w, tiny::kMaxConvBlockOutputWidthCPU);
+  return plan;
+}
+
+} /* namespace */
+
+namespace tiny {
+
+const char* GetConv2dAlgorithmName(Conv2dAlgorithm algorithm) {
+  switch (algorithm) {
+    case Conv2dAlgorithm::kPointwise:
+      return "pointwise";
+    case Conv2dAlgorithm::kIm2col:
+      return "im2col";
+    case Conv2dAlgorithm::kWinograd2x2:
+      return "winograd 2x2";
+    case Conv2dAlgorithm::kWinograd4x4:
+      return "winograd 4x4";
+    case Conv2dAlgorithm::kGrouped:
+      return "grouped";
+    case Conv2dAlgorithm::kDirect:
+      return "direct";
+  }
+  return "unknown";
+}
+
+bool IsConv2dAlgorithmSupported(const Conv2dParams& params,
+                                Conv2dAlgorithm algorithm) {
+  if (params.layout == Conv2dLayout::kNHWC &&
+      algorithm != Conv2dAlgorithm::kPointwise &&
+      algorithm != Conv2dAlgorithm::kGrouped &&
+      algorithm != Conv2dAlgorithm::kDirect) {
+    return false;
+  }
+  switch (algorithm) {
+    case Conv2dAlgorithm::kPointwise:
+      return IsPointwise(params);
+    case Conv2dAlgorithm::kWinograd2x2:
+    case Conv2dAlgorithm::kWinograd4x4:
+      return IsWinogradShape(params);
+    case Conv2dAlgorithm::kGrouped:
+      return IsGroupedShape(params);
+    case Conv2dAlgorithm::kIm2col:
+    case Conv2dAlgorithm::kDirect:
+      return true;
+  }
+  return false;
+}
+
+Conv2dWorkItem Conv2dPartition::GetItem(uint32_t index) const {
+  const uint32_t tiles_per_row = GetTilesPerRow();
+  const uint32_t tiles_per_column = GetTilesPerColumn();
+  const uint32_t blocks_per_group = GetBlocksPerGroup();
+  const uint32_t ocg = output_c / groups;
+
+  const uint32_t tile_col = index % tiles_per_row;
+  index /= tiles_per_row;
+  const uint32_t tile_row = index % tiles_per_column;
+  index /= tiles_per_column;
+  const uint32_t block = index % blocks_per_group;
+  index /= blocks_per_group;
+  const uint32_t g = index % groups;
+
+  Conv2dWorkItem item;
+  item.n = index / groups;
+  item.oc_begin = g * ocg + block * block_output_c;
+  item.oc_end = std::min(item.oc_begin + block_output_c, (g + 1) * ocg);
+  item.oh_begin = tile_row * tile_h;
+  item.oh_end = std::min(item.oh_begin + tile_h, output_h);
+  item.ow_begin = tile_col * tile_w;
+  item.ow_end = std::min(item.ow_begin + tile_w, output_w);
+  return item;
+}
+
+Conv2dPartition PartitionConv2d(const Conv2dPlan& plan,
+                                uint32_t max_block_output_c,
+                                uint32_t min_block_output_c,
+                                uint32_t min_tile_w, uint32_t num_threads,
+                                bool across_groups, bool pooled) {
+  const Conv2dParams& p = plan.params;
+  if (num_threads == 0) num_threads = GetNumberOfHostThreads();
+  const uint32_t groups = across_groups ? 1 : p.groups;
+  const uint32_t ocg = p.output_c / groups;
+  const uint32_t step = pooled ? 2 : 1;
+  const uint32_t output_h = plan.output_h / step * step;
+  const uint32_t output_w = plan.output_w / step * step;
+
+  Conv2dPartition partition = {.batch = p.batch,
+                               .groups = groups,
+                               .output_c = p.output_c,
+                               .output_h = output_h,
+                               .output_w = output_w,
+                               .block_output_c = std::min(ocg,
+                                                          max_block_output_c),
+                               .tile_h = output_h,
+                               .tile_w = output_w};
+  min_block_output_c = std::min(min_block_output_c, partition.block_output_c);
+  min_tile_w = std::min(RoundUp(min_tile_w, step), partition.tile_w);
+
+  // Halve one dimension at a time. Halving rounds up, to a multiple of
+  // |step|, and channel blocks stay multiples of |min_block_output_c| to
+  // keep full register tiles.
+  const uint32_t target = num_threads * kConvWorkItemsPerThreadCPU;
+  while (partition.GetNumberOfItems() < target) {
+    if (partition.tile_h > step) {
+      partition.tile_h = RoundUp((partition.tile_h + 1) / 2, step);
+    } else if (partition.block_output_c > min_block_output_c) {
+      uint32_t half = (partition.block_output_c + 1) / 2;
+      half = (half + min_block_output_c - 1) / min_block_output_c *
+             min_block_output_c;
+      partition.block_output_c =
+          std::max(min_block_output_c,
+                   std::min(half, partition.block_output_c - 1));
+    } else if (partition.tile_w > min_tile_w) {
+      partition.tile_w =
+          std::max(min_tile_w, RoundUp((partition.tile_w + 1) / 2, step));
+    } else {
+      break;
+    }
+  }
+  return partition;
+}
+
+Conv2dSpatialTile Conv2dSpatialTiling::GetTile(uint32_t index) const {
+  const uint32_t tiles_per_row = GetTilesPerRow();
+  Conv2dSpatialTile tile;
+  tile.oh_begin = index / tiles_per_row * tile_h;
+  tile.oh_end = std::min(tile.oh_begin + tile_h, params.GetOutputHeight());
+  tile.ow_begin = index % tiles_per_row * tile_w;
+  tile.ow_end = std::min(tile.ow_begin + tile_w, params.GetOutputWidth());
+  std::tie(tile.ih_begin, tile.ih_end) =
+      GetInputRange(tile.oh_begin, tile.oh_end, params.kernel_h,
+                    params.stride_h, params.padding_h, params.dilation_h);
+  std::tie(tile.iw_begin, tile.iw_end) =
+      GetInputRange(tile.ow_begin, tile.ow_end, params.kernel_w,
+                    params.stride_w, params.padding_w, params.dilation_w);
+  return tile;
+}
+
+Conv2dSpatialTiling PlanConv2dSpatialTiling(const Conv2dParams& params,
+                                            size_t budget_bytes,
+                                            size_t element_size,
+                                            bool pooled) {
+  assert(params.IsValid());
+  const uint32_t output_h = params.GetOutputHeight();
+  const uint32_t output_w = params.GetOutputWidth();
+  const uint32_t step = pooled ? 2 : 1;
+  Conv2dSpatialTiling tiling = {
+      .params = params, .tile_h = output_h, .tile_w = output_w};
+  while (GetTileWorkingSet(params, tiling.tile_h, tiling.tile_w,
+                           element_size) > budget_bytes &&
+         (tiling.tile_h > step || tiling.tile_w > step)) {
+    if (tiling.tile_h >= tiling.tile_w) {
+      tiling.tile_h = RoundUp((tiling.tile_h + 1) / 2, step);
+    } else {
+      tiling.tile_w = RoundUp((tiling.tile_w + 1) / 2, step);
+    }
+  }
+  tiling.working_set_bytes =
+      GetTileWorkingSet(params, tiling.tile_h, tiling.tile_w, element_size);
+
+  // Rows and columns are independent, so the input read by all tiles is the
+  // product of the sums along each dimension.
+  const auto rows = GetFootprints(output_h, tiling.tile_h, params.input_h,
+                                  params.kernel_h, params.stride_h,
+                                  params.padding_h, params.dilation_h);
+  const auto cols = GetFootprints(output_w, tiling.tile_w, params.input_w,
+                                  params.kernel_w, params.stride_w,
+                                  params.padding_w, params.dilation_w);
+  const double whole = static_cast<double>(rows.second) * cols.second;
+  tiling.halo_overhead =
+      whole == 0.0 ? 0.0 : rows.first * cols.first / whole - 1.0;
+  return tiling;
+}
+
+std::shared_ptr<const Conv2dPlan> GetConv2dPlan(const Conv2dParams& params) {
+  assert(params.IsValid());
+  PlanCache& cache = GetPlanCache();
+  std::lock_guard<std::mutex> lock(cache.mutex);
+  auto& plan = cache.plans[params];
+  if (!plan) plan = BuildPlan(params);
+  return plan;
+}
+
+uint32_t GetConv2dPlanCacheSize() {
+  PlanCache& cache = GetPlanCache();
+  std::lock_guard<std::mutex> lock(cache.mutex);
+  return cache.plans.size();
+}
+
+void ClearConv2dPlanCache() {
+  PlanCache& cache = GetPlanCache();
+  std::lock_guard<std::mutex> lock(cache.mutex);
+  cache.plans.clear();
+}
+
+} /* namespace tiny */
@@ -0,0 +1,380 @@
+// Copyright (c) 2024 Jaebaek Seo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef conv_plan_h_
+#define conv_plan_h_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <tuple>
+#include <vector>
+
+namespace tiny {
+
+/*
+ * Layouts of the buffers of a convolution.
+ *  - kNCHW: the input and output are images of channels, and each channel is
+ *    a row-major matrix. The weight is filters of input channels of kernel
+ *    rows (OIHW).
+ *  - kNHWC: the input and output are images of rows of pixels, and each pixel
+ *    has all its channels next to each other. The weight is kernel rows of
+ *    kernel columns of input channels of a group of all output channels
+ *    (HWIO), so the output channels of a weight element are contiguous.
+ */
+enum class Conv2dLayout {
+  kNCHW,
+  kNHWC,
+};
+
+/*
+ * Shape of a 2D convolution.
+ *
+ * The input is |batch| images of |input_c| channels of |input_h| by
+ * |input_w|. The weight is |output_c| filters of |input_c| / |groups| channels
+ * of |kernel_h| by |kernel_w|. The output is |batch| images of |output_c|
+ * channels of GetOutputHeight() by GetOutputWidth(). See Conv2dLayout for
+ * how they are placed in the buffers.
+ *
+ * The input and output channels are split into |groups| groups, and output
+ * channels of a group only read the input channels of the same group.
+ */
+struct Conv2dParams {
+  uint32_t batch = 1;
+  uint32_t input_h;
+  uint32_t input_w;
+  uint32_t input_c;
+  uint32_t output_c;
+  uint32_t kernel_h;
+  uint32_t kernel_w;
+  uint32_t stride_h = 1;
+  uint32_t stride_w = 1;
+  uint32_t padding_h = 0;
+  uint32_t padding_w = 0;
+  uint32_t dilation_h = 1;
+  uint32_t dilation_w = 1;
+  uint32_t groups = 1;
+  Conv2dLayout layout = Conv2dLayout::kNCHW;
+
+  uint32_t GetOutputHeight() const {
+    return (input_h + 2 * padding_h - dilation_h * (kernel_h - 1) - 1) /
+               stride_h +
+           1;
+  }
+
+  uint32_t GetOutputWidth() const {
+    return (input_w + 2 * padding_w - dilation_w * (kernel_w - 1) - 1) /
+               stride_w +
+           1;
+  }
+
+  size_t GetInputSize() const {
+    return static_cast<size_t>(batch) * input_c * input_h * input_w;
+  }
+
+  size_t GetWeightSize() const {
+    return static_cast<size_t>(output_c) * (input_c / groups) * kernel_h *
+           kernel_w;
+  }
+
+  size_t GetOutputSize() const {
+    return static_cast<size_t>(batch) * output_c * GetOutputHeight() *
+           GetOutputWidth();
+  }
+
+  bool IsValid() const {
+    return batch > 0 && input_c > 0 && output_c > 0 && kernel_h > 0 &&
+           kernel_w > 0 && stride_h > 0 && stride_w > 0 && dilation_h > 0 &&
+           dilation_w > 0 && groups > 0 && input_c % groups == 0 &&
+           output_c % groups == 0 &&
+           input_h + 2 * padding_h >= dilation_h * (kernel_h - 1) + 1 &&
+           input_w + 2 * padding_w >= dilation_w * (kernel_w - 1) + 1;
+  }
+
+  auto GetKey() const {
+    return std::make_tuple(batch, input_h, input_w, input_c, output_c,
+                           kernel_h, kernel_w, stride_h, stride_w, padding_h,
+                           padding_w, dilation_h, dilation_w, groups,
+                           layout);
+  }
+
+  bool operator==(const Conv2dParams& other) const {
+    return GetKey() == other.GetKey();
+  }
+
+  bool operator<(const Conv2dParams& other) const {
+    return GetKey() < other.GetKey();
+  }
+};
+
+/*
+ * Algorithms of the CPU convolution.
+ *  - kPointwise: 1x1 kernel without stride, padding or dilation. The output
+ *    of a group is the product of the weight (output channels by input
+ *    channels) and the input (input channels by pixels), so it runs as GEMM.
+ *  - kIm2col: the input patches of a group are lowered into a (input
+ *    channels * kernel_h * kernel_w) by pixels matrix, and the output is the
+ *    product of the weight and the lowered matrix, run as GEMM. Used when
+ *    the product is deep and wide enough for the GEMM kernels to pay for the
+ *    lowering.
+ *  - kWinograd2x2, kWinograd4x4: Winograd F(2x2, 3x3) and F(4x4, 3x3) for
+ *    3x3 kernels with stride 1 and dilation 1 (see conv_winograd.h).
+ *    kWinograd4x4 is used when the output has at least kMinWinograd4x4Size
+ *    rows and columns.
+ *  - kGrouped: grouped convolutions with at most kMaxGroupedChannelsCPU input
+ *    and output channels per group, e.g., depthwise ones (a single input
+ *    channel per group). Dense paths waste most of their work on such small
+ *    groups: a GEMM per group is tiny, and a register tile of the direct
+ *    kernels is mostly idle. With kNCHW, each output row is accumulated from
+ *    the contiguous input rows over the range of columns that does not hit
+ *    the padding, vectorized over the output columns. With kNHWC, a register
+ *    tile of output channels spans several groups, and each channel reads
+ *    the input channels of its own group, so it is vectorized over the
+ *    channels of all groups. Grouped shapes that Winograd takes with kNCHW
+ *    run as Winograd.
+ *  - kDirect: everything else. Each output row is accumulated from the
+ *    kernel rows that hit the input, using the index tables of the plan.
+ *    With kNHWC, the reduction runs over contiguous input channels and
+ *    the register tile spans output pixels by contiguous output channels,
+ *    so the compiler vectorizes it over the channels.
+ *
+ * kNHWC supports kPointwise, kGrouped and kDirect only.
+ */
+enum class Conv2dAlgorithm {
+  kPointwise,
+  kIm2col,
+  kWinograd2x2,
+  kWinograd4x4,
+  kGrouped,
+  kDirect,
+};
+
+const char* GetConv2dAlgorithmName(Conv2dAlgorithm algorithm);
+
+/* Returns true if |algorithm| can run the shape of |params|. */
+bool IsConv2dAlgorithmSupported(const Conv2dParams& params,
+                                Conv2dAlgorithm algorithm);
+
+/*
+ * Everything about a shape that does not depend on the data. A plan is built
+ * once per Conv2dParams by GetConv2dPlan() and shared by all ops of the shape.
+ */
+struct Conv2dPlan {
+  Conv2dParams params;
+  uint32_t output_h;
+  uint32_t output_w;
+  Conv2dAlgorithm algorithm;
+
+  /*
+   * Index tables. input_rows[oh * kernel_h + kh] is the input row read by
+   * kernel row kh for output row oh, and input_cols[ow * kernel_w + kw] is
+   * the input column read by kernel column kw for output column ow. -1 means
+   * the padding.
+   */
+  std::vector<int32_t> input_rows;
+  std::vector<int32_t> input_cols;
+
+  /*
+   * Blocking of kDirect. A work item of a host thread computes
+   * |block_output_c| output channels of an output row, |block_output_w|
+   * columns at a time.
+   */
+  uint32_t block_output_c;
+  uint32_t block_output_w;
+};
+
+/*
+ * Smallest depth (input channels of a group * kernel_h * kernel_w) and
+ * output channels of a group for kIm2col.
+ */
+static constexpr uint32_t kMinIm2colDepthCPU = 64;
+static constexpr uint32_t kMinIm2colOutputChannelsCPU = 16;
+
+/*
+ * Smallest input and output channels of a group for Winograd, and the
+ * smallest output size for kWinograd4x4.
+ */
+static constexpr uint32_t kMinWinogradChannelsCPU = 8;
+static constexpr uint32_t kMinWinograd4x4Size = 8;
+
+/* Largest input and output channels of a group for kGrouped. */
+static constexpr uint32_t kMaxGroupedChannelsCPU = 8;
+
+/*
+ * Register tile (output pixels by output channels) of kDirect with kNHWC, and
+ * the output channels of a work item.
+ */
+static constexpr uint32_t kNHWCTilePixelsCPU = 4;
+static constexpr uint32_t kNHWCTileChannelsCPU = 16;
+static constexpr uint32_t kNHWCBlockChannelsCPU = 64;
+
+/*
+ * Upper bounds of the blocking of kDirect with kNCHW, and the narrowest
+ * spatial tile of its work items.
+ */
+static constexpr uint32_t kMaxConvBlockOutputChannelsCPU = 8;
+static constexpr uint32_t kMaxConvBlockOutputWidthCPU = 64;
+static constexpr uint32_t kMinConvTileWidthCPU = 16;
+
+/* Default upper bound of the lowered matrix of kIm2col, in bytes. */
+static constexpr size_t kDefaultIm2colMemoryBudgetCPU = 8 << 20;
+
+/*
+ * Work of a host thread in a convolution: output channels [oc_begin, oc_end)
+ * of a single group (see PartitionConv2d() for the exception), output rows
+ * [oh_begin, oh_end) and output columns [ow_begin, ow_end) of image n.
+ */
+struct Conv2dWorkItem {
+  uint32_t n;
+  uint32_t oc_begin;
+  uint32_t oc_end;
+  uint32_t oh_begin;
+  uint32_t oh_end;
+  uint32_t ow_begin;
+  uint32_t ow_end;
+};
+
+/*
+ * Split of a convolution into work items over batch x output channel blocks
+ * x spatial tiles. A work item reads the weights of its channels once for
+ * the whole tile, so items are kept as large as possible while there are
+ * enough of them for every host thread to get several. Work items are handed
+ * out one by one (see ParallelFor()), so the cheaper items at the padded
+ * border do not leave threads idle.
+ */
+struct Conv2dPartition {
+  uint32_t batch;
+  uint32_t groups;
+  uint32_t output_c;
+  uint32_t output_h;
+  uint32_t output_w;
+  uint32_t block_output_c;
+  uint32_t tile_h;
+  uint32_t tile_w;
+
+  uint32_t GetBlocksPerGroup() const {
+    return (output_c / groups + block_output_c - 1) / block_output_c;
+  }
+  uint32_t GetTilesPerColumn() const {
+    return (output_h + tile_h - 1) / tile_h;
+  }
+  uint32_t GetTilesPerRow() const { return (output_w + tile_w - 1) / tile_w; }
+
+  uint32_t GetNumberOfItems() const {
+    return batch * groups * GetBlocksPerGroup() * GetTilesPerColumn() *
+           GetTilesPerRow();
+  }
+
+  Conv2dWorkItem GetItem(uint32_t index) const;
+};
+
+/*
+ * Number of work items per host thread that PartitionConv2d() aims for, so
+ * that the dynamic hand-out can balance uneven items.
+ */
+static constexpr uint32_t kConvWorkItemsPerThreadCPU = 4;
+
+/*
+ * Partitions the output of |plan| for |num_threads| host threads (0 means
+ * GetNumberOfHostThreads()). Output channel blocks have at most
+ * |max_block_output_c| channels. When there are too few items, tiles are
+ * split by rows first, then the channel blocks down to
+ * |min_block_output_c|, then the columns down to |min_tile_w|. With
+ * |across_groups|, the output channels are blocked as if there were a single
+ * group, for kernels that handle the group of each channel. With |pooled|,
+ * the partition covers the rows and columns read by 2x2 pooling, i.e., not
+ * an odd last one, with tiles of even heights and widths.
+ */
+Conv2dPartition PartitionConv2d(const Conv2dPlan& plan,
+                                uint32_t max_block_output_c,
+                                uint32_t min_block_output_c,
+                                uint32_t min_tile_w, uint32_t num_threads = 0,
+                                bool across_groups = false,
+                                bool pooled = false);
+
+/*
+ * Tile of a spatially tiled convolution: output rows [oh_begin, oh_end) and
+ * columns [ow_begin, ow_end) of all output channels, and the input rows
+ * [ih_begin, ih_end) and columns [iw_begin, iw_end) they read. The input
+ * range includes the halo shared with the neighbouring tiles, and the
+ * padding, so it may start before the input or end after it.
+ */
+struct Conv2dSpatialTile {
+  uint32_t oh_begin;
+  uint32_t oh_end;
+  uint32_t ow_begin;
+  uint32_t ow_end;
+  int32_t ih_begin;
+  int32_t ih_end;
+  int32_t iw_begin;
+  int32_t iw_end;
+};
+
+/*
+ * Split of the output of each image into |tile_h| by |tile_w| tiles, so that
+ * the input footprint of a tile and its output, for all channels, fit in a
+ * cache (or a device L1) budget. The weight is shared by all tiles and is
+ * not counted.
+ *
+ * |working_set_bytes| is the footprint and output of the largest tile.
+ * |halo_overhead| is the input read by all tiles over the input read by the
+ * whole output at once, minus 1, i.e., the fraction of the input that is read
+ * again because of the halos.
+ */
+struct Conv2dSpatialTiling {
+  Conv2dParams params;
+  uint32_t tile_h;
+  uint32_t tile_w;
+  size_t working_set_bytes;
+  double halo_overhead;
+
+  uint32_t GetTilesPerColumn() const {
+    return (params.GetOutputHeight() + tile_h - 1) / tile_h;
+  }
+  uint32_t GetTilesPerRow() const {
+    return (params.GetOutputWidth() + tile_w - 1) / tile_w;
+  }
+  uint32_t GetNumberOfTiles() const {
+    return GetTilesPerColumn() * GetTilesPerRow();
+  }
+
+  /* Tiles are numbered row by row. */
+  Conv2dSpatialTile GetTile(uint32_t index) const;
+};
+
+/*
+ * Plans the tiles of |params| with elements of |element_size| bytes for
+ * |budget_bytes|. Starting from the whole output, the longer side of the
+ * tile is halved until the working set fits, or the tile is a single pixel.
+ * With |pooled|, a halved side is rounded up to an even size, and the tile
+ * stops at 2x2 pixels, so that tiles hold whole 2x2 pooling windows.
+ */
+Conv2dSpatialTiling PlanConv2dSpatialTiling(const Conv2dParams& params,
+                                            size_t budget_bytes,
+                                            size_t element_size,
+                                            bool pooled = false);
+
+/*
+ * Returns the plan of |params|, building it on the first call for the shape.
+ * Thread-safe.
+ */
+std::shared_ptr<const Conv2dPlan> GetConv2dPlan(const Conv2dParams& params);
+
+/* Number of cached plans, and clearing them e.g., to bound the memory use. */
+uint32_t GetConv2dPlanCacheSize();
+void ClearConv2dPlanCache();
+
+} /* namespace tiny */
+
+#endif /* ifndef conv_plan_h_ */
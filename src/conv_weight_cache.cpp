@@ -0,0 +1,176 @@
+// Copyright (c) 2024 Jaebaek Seo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "conv_weight_cache.h"
+
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <tuple>
+
+#include "conv_winograd.h"
+#include "tt_metal/common/bfloat16.hpp"
+#include "utils.h"
+
+namespace {
+
+/*
+ * Entries are keyed by the address of the weight buffer, the fields of the
+ * shape that the packed weight depends on and the layout, so ops of any
+ * batch size, input size, stride or padding share the packing of a weight.
+ * |source| tells whether the buffer at the address is still the one that
+ * was packed.
+ */
+struct WeightCacheEntry {
+  std::weak_ptr<const void> source;
+  uint64_t version;
+  std::shared_ptr<const void> packed;
+};
+
+using WeightCacheKey =
+    std::tuple<const void*, tiny::Conv2dLayout, uint32_t, uint32_t, uint32_t,
+               uint32_t, uint32_t, tiny::Conv2dWeightLayout>;
+
+WeightCacheKey GetWeightCacheKey(const void* weight,
+                                 const tiny::Conv2dParams& p,
+                                 tiny::Conv2dWeightLayout layout) {
+  return {weight,     p.layout,   p.input_c, p.output_c,
+          p.kernel_h, p.kernel_w, p.groups,  layout};
+}
+
+struct WeightCache {
+  std::mutex mutex;
+  std::map<WeightCacheKey, WeightCacheEntry> entries;
+};
+
+WeightCache& GetWeightCache() {
+  static WeightCache cache;
+  return cache;
+}
+
+uint32_t RoundUp(uint32_t value, uint32_t multiple) {
+  return (value + multiple - 1) / multiple * multiple;
+}
+
+} /* namespace */
+
+namespace tiny {
+
+template <typename T>
+std::shared_ptr<const PackedConv2dWeight<T>> PackConv2dWeight(
+    const Conv2dPlan& plan, Conv2dWeightLayout layout, const T* weight) {
+  const Conv2dParams& p = plan.params;
+  auto packed = std::make_shared<PackedConv2dWeight<T>>();
+  packed->layout = layout;
+  if (layout != Conv2dWeightLayout::kTilized) {
+    assert(p.layout == Conv2dLayout::kNCHW);
+    TransformWinogradWeight<T>(plan,
+                               layout == Conv2dWeightLayout::kWinograd2x2
+                                   ? Conv2dAlgorithm::kWinograd2x2
+                                   : Conv2dAlgorithm::kWinograd4x4,
+                               weight, packed->winograd);
+    return packed;
+  }
+
+  const uint32_t icg = p.input_c / p.groups;
+  const uint32_t ocg = p.output_c / p.groups;
+  const uint32_t kernel_size = p.kernel_h * p.kernel_w;
+  const uint32_t width = RoundUp(ocg, TileWidth());
+  const uint32_t height = RoundUp(kernel_size * icg, TileHeight());
+  packed->tilized_width = width;
+  packed->tilized_height = height;
+  packed->tilized.resize(static_cast<size_t>(p.groups) * width * height);
+  for (uint32_t g = 0; g < p.groups; ++g) {
+    std::vector<T> matrix(static_cast<size_t>(width) * height,
+                          FromFloat<T>(0.0f));
+    for (uint32_t k = 0; k < kernel_size; ++k) {
+      for (uint32_t ic = 0; ic < icg; ++ic) {
+        for (uint32_t o = 0; o < ocg; ++o) {
+          const uint32_t oc = g * ocg + o;
+          const size_t index =
+              p.layout == Conv2dLayout::kNCHW
+                  ? (static_cast<size_t>(oc) * icg + ic) * kernel_size + k
+                  : (static_cast<size_t>(k) * icg + ic) * p.output_c + oc;
+          matrix[static_cast<size_t>(k * icg + ic) * width + o] =
+              weight[index];
+        }
+      }
+    }
+    TilizeForTTDevice(matrix, width, height);
+    std::copy(matrix.begin(), matrix.end(),
+              packed->tilized.begin() +
+                  static_cast<size_t>(g) * width * height);
+  }
+  return packed;
+}
+
+template <typename T>
+std::shared_ptr<const PackedConv2dWeight<T>> GetPackedConv2dWeight(
+    const Conv2dPlan& plan, Conv2dWeightLayout layout,
+    std::shared_ptr<Buffer<T>> weight) {
+  assert(weight->GetNumberOfElements() == plan.params.GetWeightSize());
+  WeightCache& cache = GetWeightCache();
+  const WeightCacheKey key =
+      GetWeightCacheKey(weight.get(), plan.params, layout);
+  const uint64_t version = weight->GetVersion();
+  {
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    auto it = cache.entries.find(key);
+    if (it != cache.entries.end() && it->second.source.lock() == weight &&
+        it->second.version == version) {
+      return std::static_pointer_cast<const PackedConv2dWeight<T>>(
+          it->second.packed);
+    }
+  }
+
+  // Pack without the lock. Ops that miss at the same time pack the same
+  // weight more than once, and the last one stays.
+  auto packed = PackConv2dWeight<T>(plan, layout, weight->GetVector().data());
+  std::lock_guard<std::mutex> lock(cache.mutex);
+  for (auto it = cache.entries.begin(); it != cache.entries.end();) {
+    it = it->second.source.expired() ? cache.entries.erase(it) : std::next(it);
+  }
+  cache.entries[key] = {.source = weight, .version = version, .packed = packed};
+  return packed;
+}
+
+uint32_t GetConv2dWeightCacheSize() {
+  WeightCache& cache = GetWeightCache();
+  std::lock_guard<std::mutex> lock(cache.mutex);
+  return cache.entries.size();
+}
+
+void ClearConv2dWeightCache() {
+  WeightCache& cache = GetWeightCache();
+  std::lock_guard<std::mutex> lock(cache.mutex);
+  cache.entries.clear();
+}
+
+template std::shared_ptr<const PackedConv2dWeight<float>>
+PackConv2dWeight<float>(const Conv2dPlan& plan, Conv2dWeightLayout layout,
+                        const float* weight);
+template std::shared_ptr<const PackedConv2dWeight<bfloat16>>
+PackConv2dWeight<bfloat16>(const Conv2dPlan& plan, Conv2dWeightLayout layout,
+                           const bfloat16* weight);
+template std::shared_ptr<const PackedConv2dWeight<float>>
+GetPackedConv2dWeight<float>(const Conv2dPlan& plan, Conv2dWeightLayout layout,
+                             std::shared_ptr<Buffer<float>> weight);
+template std::shared_ptr<const PackedConv2dWeight<bfloat16>>
+GetPackedConv2dWeight<bfloat16>(const Conv2dPlan& plan,
+                                Conv2dWeightLayout layout,
+                                std::shared_ptr<Buffer<bfloat16>> weight);
+
+} /* namespace tiny */
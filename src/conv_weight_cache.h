@@ -0,0 +1,90 @@
+// Copyright (c) 2024 Jaebaek Seo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef conv_weight_cache_h_
+#define conv_weight_cache_h_
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "buffer.h"
+#include "conv_plan.h"
+
+namespace tiny {
+
+/*
+ * Layouts a conv weight is packed into.
+ *  - kWinograd2x2, kWinograd4x4: the transformed weight of the CPU Winograd
+ *    algorithms (see TransformWinogradWeight()).
+ *  - kTilized: the weight of each group as a (kernel_h * kernel_w * input
+ *    channels of a group) by (output channels of a group) matrix for the
+ *    device, whose row (kh * kernel_w + kw) * icg + ic and column oc hold
+ *    the weight of kernel element (kh, kw), input channel ic and output
+ *    channel oc of the group. The matrix is zero padded to whole tiles and
+ *    tilized (see TilizeForTTDevice()), and the groups are placed one after
+ *    another. Conv<T>::Run() does not use it until the device path has a
+ *    kernel that reads it.
+ *
+ * The other CPU algorithms read the weight buffer as it is: an OIHW weight
+ * is already the row-major (output channels by depth) matrix of GEMM, and
+ * the direct kernels read OIHW or HWIO directly.
+ */
+enum class Conv2dWeightLayout {
+  kWinograd2x2,
+  kWinograd4x4,
+  kTilized,
+};
+
+template <typename T>
+struct PackedConv2dWeight {
+  Conv2dWeightLayout layout;
+
+  /* kWinograd2x2 and kWinograd4x4. */
+  std::vector<float> winograd;
+
+  /* kTilized. The shape of the padded matrix of a group. */
+  std::vector<T> tilized;
+  uint32_t tilized_width = 0;
+  uint32_t tilized_height = 0;
+};
+
+/* Packs |weight|, in the layout of |plan.params|, into |layout|. */
+template <typename T>
+std::shared_ptr<const PackedConv2dWeight<T>> PackConv2dWeight(
+    const Conv2dPlan& plan, Conv2dWeightLayout layout, const T* weight);
+
+/*
+ * Returns |weight| packed into |layout|, packing it only when the cache has
+ * no entry for the same weight buffer, weight shape (channels, kernel size,
+ * groups and layout of |plan.params|) and |layout|, or the buffer changed
+ * since (see Buffer::GetVersion()). The batch size, input size, stride and
+ * padding do not change the packed weight, so ops that only differ in those
+ * share an entry. Weights are constant across most
+ * runs, so repeated runs of all ops that share a weight buffer skip the
+ * packing. An entry holds the buffer weakly and is dropped once the buffer
+ * is gone. Thread-safe.
+ */
+template <typename T>
+std::shared_ptr<const PackedConv2dWeight<T>> GetPackedConv2dWeight(
+    const Conv2dPlan& plan, Conv2dWeightLayout layout,
+    std::shared_ptr<Buffer<T>> weight);
+
+/* Number of cached packed weights, and clearing them. */
+uint32_t GetConv2dWeightCacheSize();
+void ClearConv2dWeightCache();
+
+} /* namespace tiny */
+
+#endif /* ifndef conv_weight_cache_h_ */
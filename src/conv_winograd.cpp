@@ -0,0 +1,284 @@
+// Copyright (c) 2024 Jaebaek Seo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "conv_winograd.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include "matmul_cpu.h"
+#include "parallel.h"
+#include "tt_metal/common/bfloat16.hpp"
+#include "utils.h"
+
+namespace {
+
+/* B^T, G and A^T of F(m x m, 3 x 3), where alpha = m + 2. */
+struct WinogradMatrices {
+  uint32_t m;
+  uint32_t alpha;
+  const float* bt;  // alpha x alpha
+  const float* g;   // alpha x 3
+  const float* at;  // m x alpha
+};
+
+// clang-format off
+constexpr float kBt2x2[] = {
+    1.0f,  0.0f, -1.0f,  0.0f,
+    0.0f,  1.0f,  1.0f,  0.0f,
+    0.0f, -1.0f,  1.0f,  0.0f,
+    0.0f,  1.0f,  0.0f, -1.0f};
+constexpr float kG2x2[] = {
+    1.0f,  0.0f, 0.0f,
+    0.5f,  0.5f, 0.5f,
+    0.5f, -0.5f, 0.5f,
+    0.0f,  0.0f, 1.0f};
+constexpr float kAt2x2[] = {
+    1.0f, 1.0f,  1.0f,  0.0f,
+    0.0f, 1.0f, -1.0f, -1.0f};
+
+constexpr float kBt4x4[] = {
+    4.0f,  0.0f, -5.0f,  0.0f, 1.0f, 0.0f,
+    0.0f, -4.0f, -4.0f,  1.0f, 1.0f, 0.0f,
+    0.0f,  4.0f, -4.0f, -1.0f, 1.0f, 0.0f,
+    0.0f, -2.0f, -1.0f,  2.0f, 1.0f, 0.0f,
+    0.0f,  2.0f, -1.0f, -2.0f, 1.0f, 0.0f,
+    0.0f,  4.0f,  0.0f, -5.0f, 0.0f, 1.0f};
+constexpr float kG4x4[] = {
+     1.0f / 4,   0.0f,       0.0f,
+    -1.0f / 6,  -1.0f / 6,  -1.0f / 6,
+    -1.0f / 6,   1.0f / 6,  -1.0f / 6,
+     1.0f / 24,  1.0f / 12,  1.0f / 6,
+     1.0f / 24, -1.0f / 12,  1.0f / 6,
+     0.0f,       0.0f,       1.0f};
+constexpr float kAt4x4[] = {
+    1.0f, 1.0f,  1.0f, 1.0f,  1.0f, 0.0f,
+    0.0f, 1.0f, -1.0f, 2.0f, -2.0f, 0.0f,
+    0.0f, 1.0f,  1.0f, 4.0f,  4.0f, 0.0f,
+    0.0f, 1.0f, -1.0f, 8.0f, -8.0f, 1.0f};
+// clang-format on
+
+constexpr uint32_t kMaxAlpha = 6;
+
+WinogradMatrices GetWinogradMatrices(tiny::Conv2dAlgorithm algorithm) {
+  if (algorithm == tiny::Conv2dAlgorithm::kWinograd2x2) {
+    return {2, 4, kBt2x2, kG2x2, kAt2x2};
+  }
+  assert(algorithm == tiny::Conv2dAlgorithm::kWinograd4x4);
+  return {4, 6, kBt4x4, kG4x4, kAt4x4};
+}
+
+/*
+ * |out| = |x| |z| |x|^T, where |x| is |rows| by |cols| and |z| is |cols| by
+ * |cols|.
+ */
+void Sandwich(const float* x, uint32_t rows, uint32_t cols, const float* z,
+              float* out) {
+  float xz[kMaxAlpha * kMaxAlpha];
+  for (uint32_t i = 0; i < rows; ++i) {
+    for (uint32_t j = 0; j < cols; ++j) {
+      float sum = 0.0f;
+      for (uint32_t k = 0; k < cols; ++k) {
+        sum += x[i * cols + k] * z[k * cols + j];
+      }
+      xz[i * cols + j] = sum;
+    }
+  }
+  for (uint32_t i = 0; i < rows; ++i) {
+    for (uint32_t j = 0; j < rows; ++j) {
+      float sum = 0.0f;
+      for (uint32_t k = 0; k < cols; ++k) {
+        sum += xz[i * cols + k] * x[j * cols + k];
+      }
+      out[i * rows + j] = sum;
+    }
+  }
+}
+
+} /* namespace */
+
+namespace tiny {
+
+uint32_t GetWinogradOutputTileSize(Conv2dAlgorithm algorithm) {
+  return GetWinogradMatrices(algorithm).m;
+}
+
+template <typename T>
+void TransformWinogradWeight(const Conv2dPlan& plan, Conv2dAlgorithm algorithm,
+                             const T* weight, std::vector<float>& transformed) {
+  const Conv2dParams& p = plan.params;
+  assert(p.kernel_h == 3 && p.kernel_w == 3);
+  const WinogradMatrices w = GetWinogradMatrices(algorithm);
+  const uint32_t elements = w.alpha * w.alpha;
+  const uint32_t icg = p.input_c / p.groups;
+  const uint32_t ocg = p.output_c / p.groups;
+  transformed.resize(static_cast<size_t>(p.groups) * elements * ocg * icg);
+
+  ParallelFor(p.output_c, [&](uint32_t oc) {
+    const uint32_t g = oc / ocg;
+    const uint32_t o = oc % ocg;
+    float filter[9];
+    float u[kMaxAlpha * kMaxAlpha];
+    for (uint32_t ic = 0; ic < icg; ++ic) {
+      for (uint32_t i = 0; i < 9; ++i) {
+        filter[i] =
+            ToFloat(weight[(static_cast<size_t>(oc) * icg + ic) * 9 + i]);
+      }
+      Sandwich(w.g, w.alpha, 3, filter, u);
+      for (uint32_t e = 0; e < elements; ++e) {
+        transformed[((static_cast<size_t>(g) * elements + e) * ocg + o) * icg +
+                    ic] = u[e];
+      }
+    }
+  });
+}
+
+template <typename T>
+Result RunWinograd(const Conv2dPlan& plan, Conv2dAlgorithm algorithm,
+                   const Conv2dOutputStage& stage, const T* input,
+                   const float* transformed_weight, T* output) {
+  const Conv2dParams& p = plan.params;
+  assert(p.kernel_h == 3 && p.kernel_w == 3 && p.stride_h == 1 &&
+         p.stride_w == 1 && p.dilation_h == 1 && p.dilation_w == 1);
+  const WinogradMatrices w = GetWinogradMatrices(algorithm);
+  const uint32_t elements = w.alpha * w.alpha;
+  const uint32_t icg = p.input_c / p.groups;
+  const uint32_t ocg = p.output_c / p.groups;
+  const uint32_t tiles_h = (plan.output_h + w.m - 1) / w.m;
+  const uint32_t tiles_w = (plan.output_w + w.m - 1) / w.m;
+  const uint32_t tiles = tiles_h * tiles_w;
+
+  // Tiles of all images of the batch are numbered one after another, so a
+  // block of small images still makes wide GEMMs.
+  const uint32_t total_tiles = p.batch * tiles;
+  const uint32_t block = std::min(total_tiles, kWinogradTileBlockCPU);
+
+  // Transformed input tiles and their products with the transformed weight,
+  // as a matrix per element of the transformed tile.
+  std::vector<float> v(static_cast<size_t>(elements) * icg * block);
+  std::vector<float> products(static_cast<size_t>(elements) * ocg * block);
+
+  for (uint32_t g = 0; g < p.groups; ++g) {
+    for (uint32_t tile_begin = 0; tile_begin < total_tiles;
+         tile_begin += block) {
+      const uint32_t count = std::min(block, total_tiles - tile_begin);
+
+      ParallelFor(icg * count, [&](uint32_t item) {
+        const uint32_t ic = item / count;
+        const uint32_t t = item % count;
+        const uint32_t n = (tile_begin + t) / tiles;
+        const uint32_t th = (tile_begin + t) % tiles / tiles_w;
+        const uint32_t tw = (tile_begin + t) % tiles_w;
+        const T* channel =
+            input + (static_cast<size_t>(n) * p.input_c + g * icg + ic) *
+                        p.input_h * p.input_w;
+        float d[kMaxAlpha * kMaxAlpha];
+        for (uint32_t i = 0; i < w.alpha; ++i) {
+          const int64_t row = static_cast<int64_t>(th) * w.m + i -
+                              static_cast<int64_t>(p.padding_h);
+          for (uint32_t j = 0; j < w.alpha; ++j) {
+            const int64_t col = static_cast<int64_t>(tw) * w.m + j -
+                                static_cast<int64_t>(p.padding_w);
+            d[i * w.alpha + j] =
+                row < 0 || row >= p.input_h || col < 0 || col >= p.input_w
+                    ? 0.0f
+                    : ToFloat(channel[row * p.input_w + col]);
+          }
+        }
+        float transformed[kMaxAlpha * kMaxAlpha];
+        Sandwich(w.bt, w.alpha, w.alpha, d, transformed);
+        for (uint32_t e = 0; e < elements; ++e) {
+          v[(static_cast<size_t>(e) * icg + ic) * count + t] = transformed[e];
+        }
+      });
+
+      for (uint32_t e = 0; e < elements; ++e) {
+        GemmParams params = {.m = ocg,
+                             .n = count,
+                             .k = icg,
+                             .lda = icg,
+                             .ldb = count,
+                             .ldc = count};
+        Result result = Gemm<float>(
+            params,
+            transformed_weight +
+                (static_cast<size_t>(g) * elements + e) * ocg * icg,
+            v.data() + static_cast<size_t>(e) * icg * count,
+            products.data() + static_cast<size_t>(e) * ocg * count);
+        if (result != Result::kSuccess) return result;
+      }
+
+      ParallelFor(ocg * count, [&](uint32_t item) {
+        const uint32_t o = item / count;
+        const uint32_t t = item % count;
+        const uint32_t n = (tile_begin + t) / tiles;
+        const uint32_t th = (tile_begin + t) % tiles / tiles_w;
+        const uint32_t tw = (tile_begin + t) % tiles_w;
+        float z[kMaxAlpha * kMaxAlpha];
+        for (uint32_t e = 0; e < elements; ++e) {
+          z[e] = products[(static_cast<size_t>(e) * ocg + o) * count + t];
+        }
+        float y[kMaxAlpha * kMaxAlpha];
+        Sandwich(w.at, w.m, w.alpha, z, y);
+        const uint32_t oc = g * ocg + o;
+        for (uint32_t e = 0; e < w.m * w.m; ++e) y[e] = stage.Apply(oc, y[e]);
+
+        // With pooling, the output tile holds whole 2x2 windows, as m is
+        // even. Windows past the output, or on an odd last row or column,
+        // are dropped.
+        const uint32_t s = stage.GetPoolingSize();
+        const uint32_t output_h = plan.output_h / s;
+        const uint32_t output_w = plan.output_w / s;
+        const uint32_t tile = w.m / s;
+        T* channel = output + (static_cast<size_t>(n) * p.output_c + oc) *
+                                  output_h * output_w;
+        const uint32_t rows = std::min(tile, output_h - th * tile);
+        const uint32_t cols = std::min(tile, output_w - tw * tile);
+        for (uint32_t i = 0; i < rows; ++i) {
+          for (uint32_t j = 0; j < cols; ++j) {
+            const float* window = y + s * (i * w.m + j);
+            channel[static_cast<size_t>(th * tile + i) * output_w +
+                    tw * tile + j] = FromFloat<T>(
+                s == 1 ? window[0]
+                       : stage.Pool(window[0], window[1], window[w.m],
+                                    window[w.m + 1]));
+          }
+        }
+      });
+    }
+  }
+  return Result::kSuccess;
+}
+
+template void TransformWinogradWeight<float>(const Conv2dPlan& plan,
+                                             Conv2dAlgorithm algorithm,
+                                             const float* weight,
+                                             std::vector<float>& transformed);
+template void TransformWinogradWeight<bfloat16>(
+    const Conv2dPlan& plan, Conv2dAlgorithm algorithm, const bfloat16* weight,
+    std::vector<float>& transformed);
+template Result RunWinograd<float>(const Conv2dPlan& plan,
+                                   Conv2dAlgorithm algorithm,
+                                   const Conv2dOutputStage& stage,
+                                   const float* input,
+                                   const float* transformed_weight,
+                                   float* output);
+template Result RunWinograd<bfloat16>(const Conv2dPlan& plan,
+                                      Conv2dAlgorithm algorithm,
+                                      const Conv2dOutputStage& stage,
+                                      const bfloat16* input,
+                                      const float* transformed_weight,
+                                      bfloat16* output);
+
+} /* namespace tiny */
@@ -0,0 +1,75 @@
+// Copyright (c) 2024 Jaebaek Seo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef conv_winograd_h_
+#define conv_winograd_h_
+
+#include <cstdint>
+#include <vector>
+
+#include "blas_op.h"
+#include "conv_epilogue.h"
+#include "conv_plan.h"
+
+namespace tiny {
+
+/*
+ * Winograd convolution F(m x m, 3 x 3) for 3x3 kernels with stride 1 and
+ * dilation 1 (Lavin and Gray, "Fast Algorithms for Convolutional Neural
+ * Networks"). Each m by m output tile is computed from an (m + 2) by (m + 2)
+ * input tile with (m + 2)^2 multiplications per input channel instead of
+ * 9 m^2:
+ *
+ *   Y = A^T [(G g G^T) * (B^T d B)] A
+ *
+ * where g is a 3x3 filter, d is an input tile and * is element-wise. For all
+ * channels and tiles, the element-wise products summed over input channels
+ * are (m + 2)^2 independent GEMMs of (output channels by input channels) and
+ * (input channels by tiles), one per element of the transformed tile.
+ *
+ * kWinograd2x2 needs 2.25x fewer multiplications than the direct loop, and
+ * kWinograd4x4 4x, but the larger transforms of kWinograd4x4 lose more
+ * precision.
+ */
+
+/* m of F(m x m, 3 x 3) for |algorithm|. */
+uint32_t GetWinogradOutputTileSize(Conv2dAlgorithm algorithm);
+
+/*
+ * Transforms the OIHW |weight| to G g G^T for every filter. |transformed| is
+ * laid out as [group][element of the transformed tile][output channel of the
+ * group][input channel of the group], i.e., a GEMM-ready matrix per group and
+ * element.
+ */
+template <typename T>
+void TransformWinogradWeight(const Conv2dPlan& plan, Conv2dAlgorithm algorithm,
+                             const T* weight, std::vector<float>& transformed);
+
+/*
+ * Runs the convolution of |plan| with the weight transformed above, and
+ * |stage| on each output element of the inverse transform. Tiles of all
+ * images of the batch share the GEMMs of each block of tiles. With pooling,
+ * each output tile is pooled as it is stored.
+ */
+template <typename T>
+Result RunWinograd(const Conv2dPlan& plan, Conv2dAlgorithm algorithm,
+                   const Conv2dOutputStage& stage, const T* input,
+                   const float* transformed_weight, T* output);
+
+/* Number of tiles transformed and multiplied at a time. */
+static constexpr uint32_t kWinogradTileBlockCPU = 256;
+
+} /* namespace tiny */
+
+#endif /* ifndef conv_winograd_h_ */
@@ -0,0 +1,75 @@
+// Copyright (c) 2024 Jaebaek Seo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "epilogue.h"
+
+namespace {
+
+void ApplyActivation(tiny::Activation activation, float* values,
+                     uint32_t count) {
+  if (activation == tiny::Activation::kNone) return;
+  for (uint32_t j = 0; j < count; ++j) {
+    values[j] = tiny::Activate(activation, values[j]);
+  }
+}
+
+} /* namespace */
+
+namespace tiny {
+
+Epilogue& Epilogue::AddBias(std::vector<float> bias) {
+  ops_.push_back({.kind = Op::kBias, .bias = std::move(bias)});
+  return *this;
+}
+
+Epilogue& Epilogue::AddScaleShift(std::vector<float> scale,
+                                  std::vector<float> shift, bool per_row) {
+  ops_.push_back({.kind = Op::kScaleShift,
+                  .bias = std::move(shift),
+                  .scale = std::move(scale),
+                  .per_row = per_row});
+  return *this;
+}
+
+Epilogue& Epilogue::AddActivation(Activation activation) {
+  ops_.push_back({.kind = Op::kActivation, .activation = activation});
+  return *this;
+}
+
+void Epilogue::Apply(uint32_t row, uint32_t col, float* values,
+                     uint32_t count) const {
+  for (const Op& op : ops_) {
+    switch (op.kind) {
+      case Op::kBias:
+        assert(col + count <= op.bias.size());
+        for (uint32_t j = 0; j < count; ++j) values[j] += op.bias[col + j];
+        break;
+      case Op::kScaleShift:
+        for (uint32_t j = 0; j < count; ++j) {
+          const uint32_t c = op.per_row ? row : col + j;
+          if (!op.scale.empty()) values[j] *= op.scale[c];
+          if (!op.bias.empty()) values[j] += op.bias[c];
+        }
+        break;
+      case Op::kActivation:
+        ApplyActivation(op.activation, values, count);
+        break;
+      case Op::kResidual:
+        op.residual(row, col, values, count);
+        break;
+    }
+  }
+}
+
+} /* namespace tiny */
@@ -0,0 +1,170 @@
+// Copyright (c) 2024 Jaebaek Seo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef epilogue_h_
+#define epilogue_h_
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "buffer.h"
+#include "utils.h"
+
+namespace tiny {
+
+enum class Activation {
+  kNone,
+  kReLU,
+  kGELU,
+};
+
+inline float Activate(Activation activation, float x) {
+  switch (activation) {
+    case Activation::kNone:
+      return x;
+    case Activation::kReLU:
+      return std::max(x, 0.0f);
+    case Activation::kGELU:
+      return 0.5f * x * (1.0f + std::erf(x * static_cast<float>(M_SQRT1_2)));
+  }
+  return x;
+}
+
+/*
+ * Element-wise post-processing fused into the output of a BLASOp. A CPU op
+ * applies it to the float accumulators of each output tile right before the
+ * tile is stored, so the output is written only once instead of being reread
+ * by a separate pass for every operation.
+ *
+ * Operations run in the order they are added, e.g.,
+ *
+ *   auto epilogue = std::make_shared<Epilogue>();
+ *   epilogue->AddBias(bias).AddResidual(residual, n).AddActivation(
+ *       Activation::kReLU);
+ *   epilogue->SetOutput(bfloat16_output, n);
+ *
+ * computes relu(A * B + bias + residual) and stores it as bfloat16. Element
+ * (i, j) means row i and column j of the output matrix.
+ */
+class Epilogue {
+ public:
+  /* Adds |bias[j]| to each element of column j. */
+  Epilogue& AddBias(std::vector<float> bias);
+
+  /*
+   * Multiplies element (i, j) by |scale[c]| and adds |shift[c]|, where c is
+   * i with |per_row| and j otherwise. An empty |scale| or |shift| is skipped.
+   * E.g., a batch norm of the output channels of a convolution, which are
+   * the rows of its product with NCHW and the columns with NHWC.
+   */
+  Epilogue& AddScaleShift(std::vector<float> scale, std::vector<float> shift,
+                          bool per_row);
+
+  Epilogue& AddActivation(Activation activation);
+
+  /*
+   * Adds element (i, j) of |residual| whose rows have |ld| elements. Element
+   * (i, j) is |residual|[i * |ld| + j].
+   */
+  template <typename T>
+  Epilogue& AddResidual(std::shared_ptr<Buffer<T>> residual, uint32_t ld) {
+    ops_.push_back({.kind = Op::kResidual,
+                    .residual = [residual, ld](uint32_t row, uint32_t col,
+                                               float* values, uint32_t count) {
+                      const T* src = residual->GetVector().data() + row * ld;
+                      for (uint32_t j = 0; j < count; ++j) {
+                        values[j] += ToFloat<T>(src[col + j]);
+                      }
+                    }});
+    return *this;
+  }
+
+  /*
+   * Stores the result to |output|, whose rows have |ld| elements, instead of
+   * the output buffer of the op. The type conversion (e.g., float accumulators
+   * to bfloat16) is done as a part of the store. A raw |output| must outlive
+   * the op.
+   */
+  template <typename T>
+  Epilogue& SetOutput(T* output, uint32_t ld) {
+    store_ = [output, ld](uint32_t row, uint32_t col, const float* values,
+                          uint32_t count) {
+      T* dst = output + row * ld + col;
+      for (uint32_t j = 0; j < count; ++j) dst[j] = FromFloat<T>(values[j]);
+    };
+    return *this;
+  }
+
+  template <typename T>
+  Epilogue& SetOutput(std::shared_ptr<Buffer<T>> output, uint32_t ld) {
+    store_ = [output, ld](uint32_t row, uint32_t col, const float* values,
+                          uint32_t count) {
+      T* dst = output->GetVector().data() + row * ld + col;
+      for (uint32_t j = 0; j < count; ++j) dst[j] = FromFloat<T>(values[j]);
+    };
+    return *this;
+  }
+
+  /* Applies all operations to |count| elements from element (row, col). */
+  void Apply(uint32_t row, uint32_t col, float* values, uint32_t count) const;
+
+  bool HasOutput() const { return static_cast<bool>(store_); }
+
+  /* Stores |count| elements from element (row, col) to the output. */
+  void Store(uint32_t row, uint32_t col, const float* values,
+             uint32_t count) const {
+    assert(HasOutput());
+    store_(row, col, values, count);
+  }
+
+ private:
+  struct Op {
+    enum Kind { kBias, kScaleShift, kActivation, kResidual } kind;
+    // The bias of kBias or the shift of kScaleShift.
+    std::vector<float> bias;
+    std::vector<float> scale;
+    bool per_row = false;
+    Activation activation = Activation::kNone;
+    std::function<void(uint32_t, uint32_t, float*, uint32_t)> residual;
+  };
+
+  std::vector<Op> ops_;
+  std::function<void(uint32_t, uint32_t, const float*, uint32_t)> store_;
+};
+
+/*
+ * Applies |epilogue| (if any) to a row segment of a tile and stores it to
+ * |dst| or to the output of |epilogue|.
+ */
+template <typename T>
+inline void StoreTileRow(const Epilogue* epilogue, uint32_t row, uint32_t col,
+                         float* values, uint32_t count, T* dst) {
+  if (epilogue != nullptr) {
+    epilogue->Apply(row, col, values, count);
+    if (epilogue->HasOutput()) {
+      epilogue->Store(row, col, values, count);
+      return;
+    }
+  }
+  for (uint32_t j = 0; j < count; ++j) dst[j] = FromFloat<T>(values[j]);
+}
+
+} /* namespace tiny */
+
+#endif /* ifndef epilogue_h_ */
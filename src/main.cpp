@@ -12,10 +12,21 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <unistd.h>
+
+#include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
 #include <iostream>
 #include <memory>
+#include <random>
+#include <sstream>
+#include <string>
 #include <vector>
 
 #include "1_single_tile_loopback/single_tile_loopback.h"
@@ -23,11 +34,23 @@
 #include "3_simple_multicast/simple_multicast.h"
 #include "4_single_tile_matmul/single_tile_matmul.h"
 #include "5_multicast_advanced/multicast_advanced.h"
+#include "abft.h"
+#include "autotune.h"
 #include "buffer.h"
 #include "conv.h"
+#include "epilogue.h"
 #include "log.h"
+#include "matmul_bfp8_cpu.h"
+#include "matmul_block_sparse_cpu.h"
 #include "matmul_cpu.h"
+#include "matmul_incremental_cpu.h"
+#include "matmul_int8_cpu.h"
+#include "matmul_out_of_core.h"
+#include "matmul_split_k.h"
+#include "matmul_tiled_cpu.h"
+#include "matmul_verify.h"
 #include "multicast_matmul.h"
+#include "parallel.h"
 #include "tt_metal/common/bfloat16.hpp"
 #include "utils.h"
 
@@ -243,8 +266,23 @@ void TestSimpleMulticast() {
   }
 }
 
+void LogMatrixMultiplicationCheck(
+    const tiny::MatrixMultiplicationCheck& check) {
+  if (check.passed) return;
+  log_error("{} bad rows", check.bad_rows.size());
+  for (const auto& tile : check.bad_tiles) {
+    log_error("Bad tile at tile row {}, tile column {}", tile.first,
+              tile.second);
+  }
+}
+
+/*
+ * With |use_cpu_reference|, the output is compared with a full CPU matrix
+ * multiplication element by element. Otherwise, it is checked by random
+ * probes in O(n^2) (see VerifyMatrixMultiplication()).
+ */
 template <typename T>
-void TestMulticastMatrixMultiplication() {
+void TestMulticastMatrixMultiplication(bool use_cpu_reference = false) {
   tt::tt_metal::Device* device = tt::tt_metal::CreateDevice(0);
   tiny::MulticastMatrixMultiplication<T> multicast_matmul(device);
   auto core_grid = device->compute_with_storage_grid_size();
@@ -256,27 +294,31 @@ void TestMulticastMatrixMultiplication() {
   auto input1 = std::make_shared<tiny::Buffer<T>>(number_of_input_elems, 456);
 
   const uint32_t number_of_output_elems = num_cores * number_of_input_elems;
-  auto output_cpu_matmul =
-      std::make_shared<tiny::Buffer<T>>(number_of_output_elems);
   auto output_multicast_matmul =
       std::make_shared<tiny::Buffer<T>>(number_of_output_elems);
 
-  tiny::CPUMatrixMultiplication<T> cpu_matmul(num_cores * tiny::TileHeight(),
-                                              tiny::TileWidth(),
-                                              num_cores * tiny::TileHeight());
-  cpu_matmul.SetBuffers(input0, input1, output_cpu_matmul);
-  cpu_matmul.Run();
-  auto& v0 = output_cpu_matmul->GetVector();
-
   multicast_matmul.SetBuffers(input0, input1, output_multicast_matmul);
   multicast_matmul.Run();
 
   bool pass = tt::tt_metal::CloseDevice(device);
 
-  pass = pass && IsErrorLargerThanThreshold<T>(output_cpu_matmul,
-                                               output_multicast_matmul,
-                                               num_cores * tiny::TileWidth(),
-                                               num_cores * tiny::TileHeight());
+  const uint32_t m = num_cores * tiny::TileHeight();
+  const uint32_t k = tiny::TileWidth();
+  const uint32_t n = num_cores * tiny::TileHeight();
+  if (use_cpu_reference) {
+    auto output_cpu_matmul =
+        std::make_shared<tiny::Buffer<T>>(number_of_output_elems);
+    tiny::CPUMatrixMultiplication<T> cpu_matmul(m, k, n);
+    cpu_matmul.SetBuffers(input0, input1, output_cpu_matmul);
+    cpu_matmul.Run();
+    pass = pass && IsErrorLargerThanThreshold<T>(
+                       output_cpu_matmul, output_multicast_matmul, n, m);
+  } else {
+    auto check = tiny::VerifyMatrixMultiplication<T>(
+        input0, input1, output_multicast_matmul, m, k, n);
+    LogMatrixMultiplicationCheck(check);
+    pass = pass && check.passed;
+  }
   if (pass) {
     log_green("-- PASS: {} --", __FUNCTION__);
   } else {
@@ -285,52 +327,219 @@ void TestMulticastMatrixMultiplication() {
 }
 
 template <typename T>
-void TestConv() {
-  auto input = std::make_shared<tiny::Buffer<T>>(64 * 96 * 32, 123);
-  auto weight = std::make_shared<tiny::Buffer<T>>(4 * 4 * 32 * 128, 456);
+void TestBatchedMatrixMultiplication(bool bcast_batch) {
+  const uint32_t batch = 3;
+  const uint32_t m = 3 * tiny::TileHeight();
+  const uint32_t k = 2 * tiny::TileWidth();
+  const uint32_t n = 10 * tiny::TileWidth();
+  auto input0 = std::make_shared<tiny::Buffer<T>>(batch * m * k, 123);
+  auto input1 = std::make_shared<tiny::Buffer<T>>(
+      (bcast_batch ? 1 : batch) * k * n, 456);
+  auto output_batched_matmul =
+      std::make_shared<tiny::Buffer<T>>(batch * m * n);
 
-  const uint32_t number_of_output_elems = 64 * 96 * 128;
-  auto output_cpu_conv =
-      std::make_shared<tiny::Buffer<T>>(number_of_output_elems);
-  auto output_conv = std::make_shared<tiny::Buffer<T>>(number_of_output_elems);
+  tiny::CPUBatchedMatrixMultiplication<T> batched_matmul(batch, m, k, n,
+                                                         bcast_batch);
+  batched_matmul.SetBuffers(input0, input1, output_batched_matmul);
+  batched_matmul.Run();
 
-  tiny::CpuConv<T> cpu_conv;
-  cpu_conv.SetBuffers(input, weight, output_cpu_conv);
-  cpu_conv.Run();
+  bool pass = true;
+  for (uint32_t b = 0; b < batch; ++b) {
+    auto& input_vec0 = input0->GetVector();
+    auto& input_vec1 = input1->GetVector();
+    auto batch_input0 = std::make_shared<tiny::Buffer<T>>(m * k);
+    auto batch_input1 = std::make_shared<tiny::Buffer<T>>(k * n);
+    auto output_cpu_matmul = std::make_shared<tiny::Buffer<T>>(m * n);
+    std::copy(input_vec0.begin() + b * m * k,
+              input_vec0.begin() + (b + 1) * m * k,
+              batch_input0->GetVector().begin());
+    uint32_t b1 = bcast_batch ? 0 : b;
+    std::copy(input_vec1.begin() + b1 * k * n,
+              input_vec1.begin() + (b1 + 1) * k * n,
+              batch_input1->GetVector().begin());
+
+    tiny::CPUMatrixMultiplication<T> cpu_matmul(m, k, n);
+    cpu_matmul.SetBuffers(batch_input0, batch_input1, output_cpu_matmul);
+    cpu_matmul.Run();
+
+    pass = pass && IsErrorLargerThanThreshold<T>(
+                       output_cpu_matmul, 0, m * n, output_batched_matmul,
+                       b * m * n, (b + 1) * m * n);
+  }
+  if (pass) {
+    log_green("-- PASS: {} --", __FUNCTION__);
+  } else {
+    log_error("-- FAIL: {} --", __FUNCTION__);
+  }
 }
 
 template <typename T>
-void TestMulticastAdvanced() {
-  tt::tt_metal::Device* device = tt::tt_metal::CreateDevice(0);
-  tiny::MulticastAdvanced<T> multicast_advanced(device);
-  auto core_grid = device->compute_with_storage_grid_size();
-  uint32_t num_cores = core_grid.x * core_grid.y;
+void TestMatrixMultiplicationEpilogue() {
+  const uint32_t m = 4 * tiny::TileHeight();
+  const uint32_t k = 2 * tiny::TileWidth();
+  const uint32_t n = 3 * tiny::TileWidth();
+  auto input0 = std::make_shared<tiny::Buffer<T>>(m * k, 123);
+  auto input1 = std::make_shared<tiny::Buffer<T>>(k * n, 456);
+  auto residual = std::make_shared<tiny::Buffer<T>>(m * n, 789);
+  auto output_cpu_matmul = std::make_shared<tiny::Buffer<T>>(m * n);
+  auto output_fused = std::make_shared<tiny::Buffer<T>>(m * n);
+  auto output_fused_bfloat16 = std::make_shared<tiny::Buffer<bfloat16>>(m * n);
+  std::vector<float> bias(n);
+  for (uint32_t j = 0; j < n; ++j) bias[j] = 0.01f * j - 0.5f;
 
-  const uint32_t number_of_input_elems =
-      num_cores * tiny::TileWidth() * tiny::TileHeight();
-  auto input = std::make_shared<tiny::Buffer<T>>(number_of_input_elems, 1234);
-  auto output =
-      std::make_shared<tiny::Buffer<T>>(num_cores * number_of_input_elems);
+  tiny::CPUMatrixMultiplication<T> cpu_matmul(m, k, n);
+  cpu_matmul.SetBuffers(input0, input1, output_cpu_matmul);
+  cpu_matmul.Run();
 
-  multicast_advanced.SetBuffers(input, output);
-  multicast_advanced.Run();
+  // Separate passes for bias, residual and ReLU.
+  auto& output_vec = output_cpu_matmul->GetVector();
+  auto& residual_vec = residual->GetVector();
+  for (uint32_t i = 0; i < m; ++i) {
+    for (uint32_t j = 0; j < n; ++j) {
+      float value = tiny::ToFloat<T>(output_vec[i * n + j]) + bias[j] +
+                    tiny::ToFloat<T>(residual_vec[i * n + j]);
+      output_vec[i * n + j] = tiny::FromFloat<T>(std::max(value, 0.0f));
+    }
+  }
 
-  bool pass = tt::tt_metal::CloseDevice(device);
+  auto epilogue = std::make_shared<tiny::Epilogue>();
+  epilogue->AddBias(bias).AddResidual(residual, n).AddActivation(
+      tiny::Activation::kReLU);
+  cpu_matmul.SetBuffers(input0, input1, output_fused);
+  cpu_matmul.SetEpilogue(epilogue);
+  cpu_matmul.Run();
 
-  auto& input_vec = input->GetVector();
+  bool pass = IsErrorLargerThanThreshold<T>(output_cpu_matmul, output_fused,
+                                            n, m);
+
+  // The same epilogue, but the store converts the output to bfloat16.
+  epilogue->SetOutput(output_fused_bfloat16, n);
+  cpu_matmul.Run();
+  auto output_bfloat16 = std::make_shared<tiny::Buffer<bfloat16>>(m * n);
+  for (uint32_t i = 0; i < m * n; ++i) {
+    output_bfloat16->GetVector()[i] = bfloat16(tiny::ToFloat<T>(output_vec[i]));
+  }
+  pass = pass && IsErrorLargerThanThreshold<bfloat16>(
+                     output_bfloat16, output_fused_bfloat16, n, m);
+  if (pass) {
+    log_green("-- PASS: {} --", __FUNCTION__);
+  } else {
+    log_error("-- FAIL: {} --", __FUNCTION__);
+  }
+}
+
+template <typename T>
+void TestGemm(uint32_t m, uint32_t k, uint32_t n, bool trans_a, bool trans_b) {
+  // Multiply sub-matrices that start from (1, 2) of larger matrices.
+  const uint32_t ld = std::max({m, n, k}) + 2;
+  const size_t offset = ld + 2;
+  auto input0 = std::make_shared<tiny::Buffer<T>>(ld * ld, 123);
+  auto input1 = std::make_shared<tiny::Buffer<T>>(ld * ld, 456);
+  auto output = std::make_shared<tiny::Buffer<T>>(ld * ld, 789);
+  auto expected = std::make_shared<tiny::Buffer<T>>(m * n);
+
+  tiny::GemmParams params = {.m = m,
+                             .n = n,
+                             .k = k,
+                             .trans_a = trans_a,
+                             .trans_b = trans_b,
+                             .lda = ld,
+                             .ldb = ld,
+                             .ldc = ld,
+                             .alpha = 0.5f,
+                             .beta = -2.0f};
+  auto& input_vec0 = input0->GetVector();
+  auto& input_vec1 = input1->GetVector();
   auto& output_vec = output->GetVector();
-  const uint32_t number_of_elems_in_tile =
-      tiny::TileWidth() * tiny::TileHeight();
-  for (uint32_t i = 0; i < num_cores; ++i) {
-    for (uint32_t j = 0; j < number_of_input_elems; ++j) {
-      if (input_vec[j] != output_vec[i * number_of_input_elems + j]) {
-        std::cout << i << ", " << j << ": " << input_vec[j] << ", "
-                  << output_vec[i * number_of_input_elems + j] << std::endl;
-        pass = false;
-        break;
+  for (uint32_t i = 0; i < m; ++i) {
+    for (uint32_t j = 0; j < n; ++j) {
+      float sum = 0.0f;
+      for (uint32_t kk = 0; kk < k; ++kk) {
+        T a = input_vec0[offset + (trans_a ? kk * ld + i : i * ld + kk)];
+        T b = input_vec1[offset + (trans_b ? j * ld + kk : kk * ld + j)];
+        sum += tiny::ToFloat<T>(a) * tiny::ToFloat<T>(b);
       }
+      float c = tiny::ToFloat<T>(output_vec[offset + i * ld + j]);
+      expected->GetVector()[i * n + j] =
+          tiny::FromFloat<T>(params.alpha * sum + params.beta * c);
     }
   }
+
+  tiny::CPUGemm<T> gemm(params);
+  gemm.SetBuffers(input0, input1, output, {offset, offset, offset});
+  gemm.Run();
+
+  bool pass = true;
+  for (uint32_t i = 0; i < m; ++i) {
+    pass = pass && IsErrorLargerThanThreshold<T>(expected, i * n, (i + 1) * n,
+                                                 output, offset + i * ld,
+                                                 offset + i * ld + n);
+  }
+  const char* shape_class =
+      tiny::GetGemmShapeClassName(tiny::ClassifyGemmShape(m, n, k));
+  if (pass) {
+    log_green("-- PASS: {} ({}, {}, {}) --", __FUNCTION__, shape_class,
+              trans_a, trans_b);
+  } else {
+    log_error("-- FAIL: {} ({}, {}, {}) --", __FUNCTION__, shape_class,
+              trans_a, trans_b);
+  }
+}
+
+template <typename T>
+void WriteToFile(std::shared_ptr<tiny::Buffer<T>> buffer,
+                 const std::string& path) {
+  std::ofstream file(path, std::ios::binary);
+  file.write(reinterpret_cast<const char*>(buffer->GetVector().data()),
+             buffer->GetSizeInBytes());
+}
+
+template <typename T>
+void ReadFromFile(std::shared_ptr<tiny::Buffer<T>> buffer,
+                  const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  file.read(reinterpret_cast<char*>(buffer->GetVector().data()),
+            buffer->GetSizeInBytes());
+}
+
+template <typename T>
+void TestOutOfCoreMatrixMultiplication() {
+  const uint32_t m = 5 * tiny::TileHeight() + 7;
+  const uint32_t k = 20 * tiny::TileWidth() + 3;
+  const uint32_t n = 6 * tiny::TileWidth() + 1;
+  auto input0 = std::make_shared<tiny::Buffer<T>>(m * k, 123);
+  auto input1 = std::make_shared<tiny::Buffer<T>>(k * n, 456);
+  auto output_cpu_matmul = std::make_shared<tiny::Buffer<T>>(m * n);
+  auto output_out_of_core = std::make_shared<tiny::Buffer<T>>(m * n);
+
+  tiny::CPUMatrixMultiplication<T> cpu_matmul(m, k, n);
+  cpu_matmul.SetBuffers(input0, input1, output_cpu_matmul);
+  cpu_matmul.Run();
+
+  const std::string path = "/tmp/tiny_out_of_core_" + std::to_string(getpid());
+  WriteToFile(input0, path + "_a");
+  WriteToFile(input1, path + "_b");
+
+  // A tiny budget to get multiple blocks in every dimension.
+  tiny::OutOfCoreMatrixMultiplication<T> out_of_core_matmul(m, k, n,
+                                                            256 * 1024);
+  out_of_core_matmul.SetFiles(path + "_a", path + "_b", path + "_c");
+  bool pass = out_of_core_matmul.Run() == tiny::Result::kSuccess;
+  ReadFromFile(output_out_of_core, path + "_c");
+  for (const char* suffix : {"_a", "_b", "_c"}) {
+    std::remove((path + suffix).c_str());
+  }
+
+  auto& statistics = out_of_core_matmul.GetStatistics();
+  log_blue("Blocks ({}, {}, {}), read {} bytes, wrote {} bytes, {} GB/s, {} "
+           "GFLOP/s",
+           out_of_core_matmul.GetBlockM(), out_of_core_matmul.GetBlockN(),
+           out_of_core_matmul.GetBlockK(), statistics.bytes_read,
+           statistics.bytes_written, statistics.GetIOThroughput(),
+           statistics.GetComputeThroughput());
+
+  pass = pass && IsErrorLargerThanThreshold<T>(output_cpu_matmul,
+                                               output_out_of_core, n, m);
   if (pass) {
     log_green("-- PASS: {} --", __FUNCTION__);
   } else {
@@ -338,63 +547,1935 @@ void TestMulticastAdvanced() {
   }
 }
 
-} /* namespace */
+/* Sets each TileWidth() by TileHeight() tile of |buffer| to zero with
+ * probability |sparsity|. */
+template <typename T>
+void PruneTiles(std::shared_ptr<tiny::Buffer<T>> buffer, uint32_t width,
+                uint32_t height, float sparsity, int seed) {
+  std::mt19937 gen(seed);
+  std::bernoulli_distribution prune(sparsity);
+  auto& vec = buffer->GetVector();
+  for (uint32_t row0 = 0; row0 < height; row0 += tiny::TileHeight()) {
+    for (uint32_t col0 = 0; col0 < width; col0 += tiny::TileWidth()) {
+      if (!prune(gen)) continue;
+      for (uint32_t i = row0; i < std::min(row0 + tiny::TileHeight(), height);
+           ++i) {
+        for (uint32_t j = col0; j < std::min(col0 + tiny::TileWidth(), width);
+             ++j) {
+          vec[i * width + j] = tiny::FromFloat<T>(0.0f);
+        }
+      }
+    }
+  }
+}
 
-int main(int argc, const char* argv[]) {
-  try {
-    TestSingleTileLoopback<float>();
-  } catch (const std::exception& e) {
-    log_error("TestSingleTileLoopback::Run() failed with exception!");
-    log_error("{}", e.what());
-    throw;
+template <typename T>
+double MeasureSeconds(T&& func) {
+  auto start = std::chrono::steady_clock::now();
+  func();
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+/*
+ * Compares the block-sparse matmul with the dense one for several sparsity
+ * levels of the second input, and reports the time of both.
+ */
+template <typename T>
+void TestBlockSparseMatrixMultiplication() {
+  const uint32_t m = 8 * tiny::TileHeight();
+  const uint32_t k = 8 * tiny::TileWidth() + 5;
+  const uint32_t n = 40 * tiny::TileWidth() + 3;
+  auto input0 = std::make_shared<tiny::Buffer<T>>(m * k, 123);
+  auto output_cpu_matmul = std::make_shared<tiny::Buffer<T>>(m * n);
+  auto output_block_sparse = std::make_shared<tiny::Buffer<T>>(m * n);
+  auto round_trip = std::make_shared<tiny::Buffer<T>>(k * n);
+
+  bool pass = true;
+  for (float sparsity : {0.0f, 0.5f, 0.75f, 0.9f, 0.95f}) {
+    auto input1 = std::make_shared<tiny::Buffer<T>>(k * n, 456);
+    PruneTiles<T>(input1, n, k, sparsity, 789);
+    auto sparse_input1 =
+        std::make_shared<tiny::BlockSparseMatrix<T>>(input1, n, k);
+
+    sparse_input1->ToDense(round_trip);
+    pass = pass && IsErrorLargerThanThreshold<T>(input1, round_trip, n, k);
+
+    tiny::CPUMatrixMultiplication<T> cpu_matmul(m, k, n);
+    cpu_matmul.SetBuffers(input0, input1, output_cpu_matmul);
+    double dense_seconds = MeasureSeconds([&] { cpu_matmul.Run(); });
+
+    tiny::CPUBlockSparseMatrixMultiplication<T> block_sparse_matmul(m, k, n);
+    block_sparse_matmul.SetBuffers(input0, sparse_input1, output_block_sparse);
+    double sparse_seconds = MeasureSeconds([&] { block_sparse_matmul.Run(); });
+
+    log_blue("Sparsity {}: density {}, dense {} ms, block-sparse {} ms",
+             sparsity, sparse_input1->GetDensity(), dense_seconds * 1e3,
+             sparse_seconds * 1e3);
+    pass = pass && IsErrorLargerThanThreshold<T>(output_cpu_matmul,
+                                                 output_block_sparse, n, m);
   }
 
-  try {
-    TestSingleTileMatrixMultiplication<float>();
-    TestSingleTileMatrixMultiplication<bfloat16>();
-  } catch (const std::exception& e) {
-    log_error("SingleTileMatrixMultiplication::Run() failed with exception!");
-    log_error("{}", e.what());
-    throw;
+  if (pass) {
+    log_green("-- PASS: {} --", __FUNCTION__);
+  } else {
+    log_error("-- FAIL: {} --", __FUNCTION__);
   }
+}
 
-  try {
-    TestSingleTileLoopbackFourCores<float>();
-  } catch (const std::exception& e) {
-    log_error("TestSingleTileLoopbackFourCores::Run() failed with exception!");
-    log_error("{}", e.what());
-    throw;
+/*
+ * Checks that results are bitwise identical for different numbers of host
+ * threads in the deterministic reduction mode.
+ */
+template <typename T>
+void TestDeterministicReduction(uint32_t m, uint32_t k, uint32_t n,
+                                bool trans_b) {
+  auto input0 = std::make_shared<tiny::Buffer<T>>(m * k, 123);
+  auto input1 = std::make_shared<tiny::Buffer<T>>(k * n, 456);
+  tiny::GemmParams params = {.m = m,
+                             .n = n,
+                             .k = k,
+                             .trans_b = trans_b,
+                             .lda = k,
+                             .ldb = trans_b ? k : n,
+                             .ldc = n};
+
+  tiny::SetDeterministicReduction(true);
+  std::vector<std::shared_ptr<tiny::Buffer<T>>> outputs;
+  for (uint32_t threads : {1u, 2u, 3u, 8u}) {
+    tiny::SetNumberOfHostThreads(threads);
+    outputs.push_back(std::make_shared<tiny::Buffer<T>>(m * n));
+    tiny::CPUGemm<T> gemm(params);
+    gemm.SetBuffers(input0, input1, outputs.back());
+    gemm.Run();
   }
 
-  try {
-    TestSimpleMulticast<float>();
-    TestSimpleMulticast<bfloat16>();
-  } catch (const std::exception& e) {
-    log_error("TestSimpleMulticast::Run() for float failed with exception!");
-    log_error("{}", e.what());
-    throw;
+  // Partial sums of chunks of rows of |input0| reduced on different numbers
+  // of threads.
+  std::vector<std::vector<float>> row_sums;
+  for (uint32_t threads : {1u, 8u}) {
+    tiny::SetNumberOfHostThreads(threads);
+    row_sums.emplace_back(k);
+    const uint32_t chunk = 7;
+    tiny::ParallelReduce(
+        (m + chunk - 1) / chunk, k,
+        [&](uint32_t index, float* partial) {
+          auto& vec = input0->GetVector();
+          const uint32_t end = std::min(m, (index + 1) * chunk);
+          for (uint32_t i = index * chunk; i < end; ++i) {
+            for (uint32_t j = 0; j < k; ++j) {
+              partial[j] += tiny::ToFloat<T>(vec[i * k + j]);
+            }
+          }
+        },
+        row_sums.back().data());
   }
+  tiny::SetNumberOfHostThreads(0);
+  tiny::SetDeterministicReduction(false);
 
-  try {
-    TestMulticastAdvanced<float>();
-  } catch (const std::exception& e) {
-    log_error("TestSimpleMulticast::Run() for float failed with exception!");
-    log_error("{}", e.what());
-    throw;
+  bool pass = row_sums[0] == row_sums[1];
+  for (auto& output : outputs) {
+    pass = pass && std::memcmp(output->GetVector().data(),
+                               outputs[0]->GetVector().data(),
+                               output->GetSizeInBytes()) == 0;
   }
 
-  try {
-    TestMulticastMatrixMultiplication<float>();
-    TestMulticastMatrixMultiplication<bfloat16>();
-  } catch (const std::exception& e) {
-    log_error(
-        "TestMulticastMatrixMultiplication::Run() failed with exception!");
-    log_error("{}", e.what());
-    throw;
+  // The chunked order must still be close to the default one.
+  auto output_default = std::make_shared<tiny::Buffer<T>>(m * n);
+  tiny::CPUGemm<T> gemm(params);
+  gemm.SetBuffers(input0, input1, output_default);
+  gemm.Run();
+  pass = pass &&
+         IsErrorLargerThanThreshold<T>(output_default, outputs[0], n, m);
+
+  if (pass) {
+    log_green("-- PASS: {} --", __FUNCTION__);
+  } else {
+    log_error("-- FAIL: {} --", __FUNCTION__);
+  }
+}
+
+bool operator==(const tiny::CPUGemmConfig& config0,
+                const tiny::CPUGemmConfig& config1) {
+  return config0.tile_h == config1.tile_h && config0.tile_w == config1.tile_w &&
+         config0.block_h == config1.block_h &&
+         config0.block_w == config1.block_w &&
+         config0.num_threads == config1.num_threads;
+}
+
+/*
+ * Saves a config to an autotune cache with an entry of another host, loads it
+ * back and checks that CPUMatrixMultiplication uses it.
+ */
+void TestAutotuneCache() {
+  const std::string path =
+      "/tmp/tiny_autotune_" + std::to_string(getpid()) + ".json";
+  {
+    std::ofstream file(path);
+    file << "{\"other host\": {\"gemm\": {\"square\": {\"tile_h\": 4, "
+            "\"tile_w\": 8, \"block_h\": 16, \"block_w\": 64, "
+            "\"num_threads\": 1}}}}\n";
+  }
+
+  const auto shape_class = tiny::GemmShapeClass::kSquare;
+  const tiny::CPUGemmConfig original = tiny::GetCPUGemmConfig(shape_class);
+  const tiny::CPUGemmConfig tuned = {
+      .tile_h = 4, .tile_w = 16, .block_h = 32, .block_w = 128,
+      .num_threads = 2};
+  tiny::SetCPUGemmConfig(shape_class, tuned);
+  bool pass = tiny::SaveAutotuneCache(path);
+  tiny::SetCPUGemmConfig(shape_class,
+                         tiny::GetDefaultCPUGemmConfig(shape_class));
+  pass = pass && tiny::LoadAutotuneCache(path);
+  pass = pass && tiny::GetCPUGemmConfig(shape_class) == tuned;
+
+  std::ifstream file(path);
+  std::stringstream text;
+  text << file.rdbuf();
+  pass = pass && text.str().find("other host") != std::string::npos;
+  std::remove(path.c_str());
+
+  // The blocking does not change the order of the sum over K, so the result
+  // must be the same as the one with the default blocking.
+  const uint32_t m = 100, k = 70, n = 300;
+  auto input0 = std::make_shared<tiny::Buffer<float>>(m * k, 123);
+  auto input1 = std::make_shared<tiny::Buffer<float>>(k * n, 456);
+  auto output_tuned = std::make_shared<tiny::Buffer<float>>(m * n);
+  auto output_default = std::make_shared<tiny::Buffer<float>>(m * n);
+  tiny::CPUMatrixMultiplication<float> cpu_matmul(m, k, n);
+  cpu_matmul.SetBuffers(input0, input1, output_tuned);
+  cpu_matmul.Run();
+  tiny::GemmWithConfig<float>(
+      {.m = m, .n = n, .k = k, .lda = k, .ldb = n, .ldc = n},
+      tiny::GetDefaultCPUGemmConfig(shape_class),
+      input0->GetVector().data(), input1->GetVector().data(),
+      output_default->GetVector().data());
+  pass = pass && output_tuned->GetVector() == output_default->GetVector();
+  tiny::SetCPUGemmConfig(shape_class, original);
+
+  if (pass) {
+    log_green("-- PASS: {} --", __FUNCTION__);
+  } else {
+    log_error("-- FAIL: {} --", __FUNCTION__);
+  }
+}
+
+template <typename T>
+void TestSplitKMatrixMultiplication(uint32_t m, uint32_t k, uint32_t n,
+                                    uint32_t split_k) {
+  auto input0 = std::make_shared<tiny::Buffer<T>>(m * k, 123);
+  auto input1 = std::make_shared<tiny::Buffer<T>>(k * n, 456);
+  auto output_cpu_matmul = std::make_shared<tiny::Buffer<T>>(m * n);
+  auto output_split_k = std::make_shared<tiny::Buffer<T>>(m * n);
+  std::vector<float> bias(n);
+  for (uint32_t j = 0; j < n; ++j) bias[j] = 0.01f * j;
+  auto epilogue = std::make_shared<tiny::Epilogue>();
+  epilogue->AddBias(bias).AddActivation(tiny::Activation::kReLU);
+
+  // Plan for a 64-core grid, since the plan for the host depends on its
+  // number of threads. In the deterministic reduction mode, the result must
+  // be bitwise identical to the unsplit one.
+  tiny::SetDeterministicReduction(true);
+  tiny::CPUMatrixMultiplication<T> cpu_matmul(m, k, n);
+  cpu_matmul.SetBuffers(input0, input1, output_cpu_matmul);
+  cpu_matmul.SetEpilogue(epilogue);
+  cpu_matmul.Run();
+
+  const tiny::SplitKPlan plan = tiny::PlanSplitK(m, k, n, 64);
+  tiny::CPUSplitKMatrixMultiplication<T> split_k_matmul(m, k, n);
+  split_k_matmul.SetPlan(plan);
+  split_k_matmul.SetBuffers(input0, input1, output_split_k);
+  split_k_matmul.SetEpilogue(epilogue);
+  split_k_matmul.Run();
+  tiny::SetDeterministicReduction(false);
+
+  bool pass = plan.split_k > 1 &&
+              std::memcmp(output_cpu_matmul->GetVector().data(),
+                          output_split_k->GetVector().data(),
+                          output_split_k->GetSizeInBytes()) == 0;
+
+  // Otherwise, any split is only close to the unsplit result.
+  split_k_matmul.SetPlan({.split_k = split_k,
+                          .chunk_k = (k + split_k - 1) / split_k,
+                          .workers_per_split = 2});
+  split_k_matmul.Run();
+  pass = pass && IsErrorLargerThanThreshold<T>(output_cpu_matmul,
+                                               output_split_k, n, m);
+
+  if (pass) {
+    log_green("-- PASS: {} (split {} x {}) --", __FUNCTION__, plan.split_k,
+              plan.chunk_k);
+  } else {
+    log_error("-- FAIL: {} --", __FUNCTION__);
+  }
+}
+
+template <typename T>
+void TestTiledMatrixMultiplication(tiny::TileOrder input0_order,
+                                   tiny::TileOrder input1_order,
+                                   tiny::TileOrder output_order) {
+  const uint32_t m = 6 * tiny::TileHeight();
+  const uint32_t k = 5 * tiny::TileWidth();
+  const uint32_t n = 3 * tiny::TileWidth();
+  auto input0 = std::make_shared<tiny::Buffer<T>>(m * k, 123);
+  auto input1 = std::make_shared<tiny::Buffer<T>>(k * n, 456);
+  auto output_cpu_matmul = std::make_shared<tiny::Buffer<T>>(m * n);
+  auto output_tiled = std::make_shared<tiny::Buffer<T>>(m * n);
+
+  tiny::CPUMatrixMultiplication<T> cpu_matmul(m, k, n);
+  cpu_matmul.SetBuffers(input0, input1, output_cpu_matmul);
+  cpu_matmul.Run();
+
+  input0->Tilize(k, m, input0_order);
+  input1->Tilize(n, k, input1_order);
+  tiny::CPUTiledMatrixMultiplication<T> tiled_matmul(m, k, n, output_order);
+  tiled_matmul.SetBuffers(input0, input1, output_tiled);
+  tiled_matmul.Run();
+  output_tiled->Untilize(n, m);
+
+  if (IsErrorLargerThanThreshold<T>(output_cpu_matmul, output_tiled, n, m)) {
+    log_green("-- PASS: {} --", __FUNCTION__);
+  } else {
+    log_error("-- FAIL: {} --", __FUNCTION__);
+  }
+}
+
+template <typename T>
+void TestBfp8MatrixMultiplication() {
+  const uint32_t m = 3 * tiny::TileHeight() + 5;
+  const uint32_t k = 10 * tiny::TileWidth() + 7;
+  const uint32_t n = 4 * tiny::TileWidth() + 9;
+  auto input0 = std::make_shared<tiny::Buffer<T>>(m * k, 123);
+  auto input1 = std::make_shared<tiny::Buffer<T>>(k * n, 456);
+  auto decoded_input1 = std::make_shared<tiny::Buffer<T>>(k * n);
+  auto output_cpu_matmul = std::make_shared<tiny::Buffer<T>>(m * n);
+  auto output_bfp8 = std::make_shared<tiny::Buffer<T>>(m * n);
+
+  auto bfp8_input1 = std::make_shared<tiny::Bfp8Matrix>(input1, n, k);
+  bfp8_input1->ToDense(decoded_input1);
+
+  // Elements lose at most the bits below 2^-6 of the largest one in their
+  // block, and the random elements are in [-1, 1].
+  bool pass = true;
+  auto& input_vec1 = input1->GetVector();
+  auto& decoded_vec1 = decoded_input1->GetVector();
+  for (uint32_t i = 0; i < k * n; ++i) {
+    float error = std::fabs(tiny::ToFloat<T>(input_vec1[i]) -
+                            tiny::ToFloat<T>(decoded_vec1[i]));
+    pass = pass && error <= 1.0f / 64;
+  }
+
+  // The bfp8 matmul must match the matmul with the decoded weights.
+  tiny::CPUMatrixMultiplication<T> cpu_matmul(m, k, n);
+  cpu_matmul.SetBuffers(input0, decoded_input1, output_cpu_matmul);
+  cpu_matmul.Run();
+
+  tiny::CPUBfp8MatrixMultiplication<T> bfp8_matmul(m, k, n);
+  bfp8_matmul.SetBuffers(input0, bfp8_input1, output_bfp8);
+  bfp8_matmul.Run();
+
+  log_blue("Weights: {} bytes in bfp8, {} bytes in the original type",
+           bfp8_input1->GetSizeInBytes(), input1->GetSizeInBytes());
+  pass = pass &&
+         IsErrorLargerThanThreshold<T>(output_cpu_matmul, output_bfp8, n, m);
+  if (pass) {
+    log_green("-- PASS: {} --", __FUNCTION__);
+  } else {
+    log_error("-- FAIL: {} --", __FUNCTION__);
+  }
+}
+
+template <typename T>
+void TestIncrementalMatrixMultiplication() {
+  const uint32_t m = 200;
+  const uint32_t k = 150;
+  const uint32_t n = 300;
+  auto input0 = std::make_shared<tiny::Buffer<T>>(m * k, 123);
+  auto input1 = std::make_shared<tiny::Buffer<T>>(k * n, 456);
+  auto output_cpu_matmul = std::make_shared<tiny::Buffer<T>>(m * n);
+  auto output_incremental = std::make_shared<tiny::Buffer<T>>(m * n);
+
+  tiny::CPUIncrementalMatrixMultiplication<T> incremental_matmul(m, k, n);
+  incremental_matmul.SetBuffers(input0, input1, output_incremental);
+  incremental_matmul.Run();
+
+  // Update rows 5, 6 and 120 of the first input and element (10, 77) of the
+  // second input.
+  auto& input_vec0 = input0->GetVector();
+  for (uint32_t i : {5u, 6u, 120u}) {
+    for (uint32_t j = 0; j < k; ++j) {
+      input_vec0[i * k + j] = tiny::FromFloat<T>(0.001f * j);
+    }
+    input0->MarkDirty(i * k, (i + 1) * k);
+  }
+  input1->GetVector()[10 * n + 77] = tiny::FromFloat<T>(3.0f);
+  input1->MarkDirty(10 * n + 77, 10 * n + 78);
+  incremental_matmul.Run();
+
+  tiny::CPUMatrixMultiplication<T> cpu_matmul(m, k, n);
+  cpu_matmul.SetBuffers(input0, input1, output_cpu_matmul);
+  cpu_matmul.Run();
+
+  // 3 rows and a column tile of the other rows are recomputed.
+  const double expected_skipped_fraction =
+      1.0 - (3.0 * n + (m - 3.0) * tiny::TileWidth()) / (m * n);
+  log_blue("Skipped {} of the output",
+           incremental_matmul.GetSkippedFraction());
+  bool pass = std::fabs(incremental_matmul.GetSkippedFraction() -
+                        expected_skipped_fraction) < 1e-9;
+  pass = pass && IsErrorLargerThanThreshold<T>(output_cpu_matmul,
+                                               output_incremental, n, m);
+
+  // Nothing is recomputed without changes.
+  incremental_matmul.Run();
+  pass = pass && incremental_matmul.GetSkippedFraction() == 1.0;
+
+  if (pass) {
+    log_green("-- PASS: {} --", __FUNCTION__);
+  } else {
+    log_error("-- FAIL: {} --", __FUNCTION__);
+  }
+}
+
+template <typename T>
+void TestFreivaldsVerification() {
+  const uint32_t m = 200;
+  const uint32_t k = 150;
+  const uint32_t n = 300;
+  auto input0 = std::make_shared<tiny::Buffer<T>>(m * k, 123);
+  auto input1 = std::make_shared<tiny::Buffer<T>>(k * n, 456);
+  auto output = std::make_shared<tiny::Buffer<T>>(m * n);
+
+  tiny::CPUMatrixMultiplication<T> cpu_matmul(m, k, n);
+  cpu_matmul.SetBuffers(input0, input1, output);
+  cpu_matmul.Run();
+
+  auto check = tiny::VerifyMatrixMultiplication<T>(input0, input1, output, m,
+                                                   k, n, 1e-6);
+  bool pass = check.passed && check.rounds == 20;
+
+  // Corrupt (37, 100) on tile (1, 3) and (150, 5) on tile (4, 0).
+  auto& output_vec = output->GetVector();
+  output_vec[37 * n + 100] =
+      tiny::FromFloat<T>(tiny::ToFloat(output_vec[37 * n + 100]) + 500.0f);
+  output_vec[150 * n + 5] =
+      tiny::FromFloat<T>(tiny::ToFloat(output_vec[150 * n + 5]) - 300.0f);
+  check = tiny::VerifyMatrixMultiplication<T>(input0, input1, output, m, k, n,
+                                              1e-6);
+  LogMatrixMultiplicationCheck(check);
+  pass = pass && !check.passed;
+  pass = pass && check.bad_rows == std::vector<uint32_t>({37, 150});
+  pass = pass && check.bad_tiles ==
+                     std::vector<std::pair<uint32_t, uint32_t>>({{1, 3},
+                                                                 {4, 0}});
+
+  // Infinite and huge elements do not widen their own bounds.
+  cpu_matmul.Run();
+  output_vec[37 * n + 100] = tiny::FromFloat<T>(INFINITY);
+  output_vec[150 * n + 5] = tiny::FromFloat<T>(1e30f);
+  check = tiny::VerifyMatrixMultiplication<T>(input0, input1, output, m, k, n,
+                                              1e-6);
+  pass = pass && check.bad_rows == std::vector<uint32_t>({37, 150});
+  pass = pass && check.bad_tiles ==
+                     std::vector<std::pair<uint32_t, uint32_t>>({{1, 3},
+                                                                 {4, 0}});
+
+  if (pass) {
+    log_green("-- PASS: {} --", __FUNCTION__);
+  } else {
+    log_error("-- FAIL: {} --", __FUNCTION__);
+  }
+}
+
+template <typename T>
+void TestChecksumVerification() {
+  const uint32_t m = 200;
+  const uint32_t k = 150;
+  const uint32_t n = 300;
+  auto input0 = std::make_shared<tiny::Buffer<T>>(m * k, 123);
+  auto input1 = std::make_shared<tiny::Buffer<T>>(k * n, 456);
+  auto output = std::make_shared<tiny::Buffer<T>>(m * n);
+
+  tiny::MatrixMultiplicationChecksums<T> checksums(input0, input1, m, k, n);
+
+  tiny::CPUMatrixMultiplication<T> cpu_matmul(m, k, n);
+  cpu_matmul.SetBuffers(input0, input1, output);
+  cpu_matmul.Run();
+  bool pass = checksums.Verify(output).passed;
+
+  // Corrupt (37, 100) and (40, 110), both on tile (1, 3).
+  auto& output_vec = output->GetVector();
+  output_vec[37 * n + 100] =
+      tiny::FromFloat<T>(tiny::ToFloat(output_vec[37 * n + 100]) + 200.0f);
+  output_vec[40 * n + 110] =
+      tiny::FromFloat<T>(tiny::ToFloat(output_vec[40 * n + 110]) - 150.0f);
+  auto check = checksums.Verify(output);
+  pass = pass && !check.passed;
+  pass = pass && check.bad_rows == std::vector<uint32_t>({37, 40});
+  pass = pass && check.bad_columns == std::vector<uint32_t>({100, 110});
+  pass = pass && check.bad_tiles ==
+                     std::vector<std::pair<uint32_t, uint32_t>>({{1, 3}});
+
+  // Infinite and huge elements do not widen their own bounds.
+  cpu_matmul.Run();
+  output_vec[37 * n + 100] = tiny::FromFloat<T>(INFINITY);
+  output_vec[40 * n + 110] = tiny::FromFloat<T>(1e30f);
+  check = checksums.Verify(output);
+  pass = pass && check.bad_rows == std::vector<uint32_t>({37, 40});
+  pass = pass && check.bad_columns == std::vector<uint32_t>({100, 110});
+  pass = pass && check.bad_tiles ==
+                     std::vector<std::pair<uint32_t, uint32_t>>({{1, 3}});
+
+  if (pass) {
+    log_green("-- PASS: {} --", __FUNCTION__);
+  } else {
+    log_error("-- FAIL: {} --", __FUNCTION__);
+  }
+}
+
+void TestInt8MatrixMultiplication() {
+  const uint32_t m = 3 * tiny::TileHeight() + 5;
+  const uint32_t k = 4 * tiny::TileWidth() + 7;
+  const uint32_t n = 2 * tiny::TileWidth() + 3;
+  auto input0 = std::make_shared<tiny::Buffer<int8_t>>(m * k, 123);
+  auto input1 = std::make_shared<tiny::Buffer<int8_t>>(k * n, 456);
+  auto output = std::make_shared<tiny::Buffer<int>>(m * n);
+
+  tiny::CPUInt8MatrixMultiplication int8_matmul(m, k, n);
+  int8_matmul.SetBuffers(input0, input1, output);
+  int8_matmul.Run();
+
+  // Integer accumulation must be exact.
+  auto& input_vec0 = input0->GetVector();
+  auto& input_vec1 = input1->GetVector();
+  auto& output_vec = output->GetVector();
+  bool pass = true;
+  for (uint32_t i = 0; i < m && pass; ++i) {
+    for (uint32_t j = 0; j < n; ++j) {
+      int expected = 0;
+      for (uint32_t kk = 0; kk < k; ++kk) {
+        expected += input_vec0[i * k + kk] * input_vec1[kk * n + j];
+      }
+      if (expected != output_vec[i * n + j]) {
+        log_error("{}, {}: {}, {}", i, j, expected, output_vec[i * n + j]);
+        pass = false;
+        break;
+      }
+    }
+  }
+  if (pass) {
+    log_green("-- PASS: {} ({}) --", __FUNCTION__,
+              tiny::CPUInt8MatrixMultiplication::GetKernelName());
+  } else {
+    log_error("-- FAIL: {} --", __FUNCTION__);
+  }
+}
+
+/* Direct evaluation of the definition of Conv2dParams. */
+template <typename T>
+void RunReferenceConv(const tiny::Conv2dParams& p,
+                      std::shared_ptr<tiny::Buffer<T>> input,
+                      std::shared_ptr<tiny::Buffer<T>> weight,
+                      std::shared_ptr<tiny::Buffer<T>> output) {
+  auto& input_vec = input->GetVector();
+  auto& weight_vec = weight->GetVector();
+  auto& output_vec = output->GetVector();
+  const uint32_t output_h = p.GetOutputHeight();
+  const uint32_t output_w = p.GetOutputWidth();
+  const uint32_t icg = p.input_c / p.groups;
+  const uint32_t ocg = p.output_c / p.groups;
+  for (uint32_t n = 0; n < p.batch; ++n) {
+    for (uint32_t oc = 0; oc < p.output_c; ++oc) {
+      const uint32_t g = oc / ocg;
+      for (uint32_t oh = 0; oh < output_h; ++oh) {
+        for (uint32_t ow = 0; ow < output_w; ++ow) {
+          float sum = 0.0f;
+          for (uint32_t ic = 0; ic < icg; ++ic) {
+            for (uint32_t kh = 0; kh < p.kernel_h; ++kh) {
+              for (uint32_t kw = 0; kw < p.kernel_w; ++kw) {
+                int row = static_cast<int>(oh * p.stride_h +
+                                           kh * p.dilation_h) -
+                          static_cast<int>(p.padding_h);
+                int col = static_cast<int>(ow * p.stride_w +
+                                           kw * p.dilation_w) -
+                          static_cast<int>(p.padding_w);
+                if (row < 0 || row >= static_cast<int>(p.input_h) ||
+                    col < 0 || col >= static_cast<int>(p.input_w)) {
+                  continue;
+                }
+                float x = tiny::ToFloat(
+                    input_vec[((n * p.input_c + g * icg + ic) * p.input_h +
+                               row) *
+                                  p.input_w +
+                              col]);
+                float w = tiny::ToFloat(
+                    weight_vec[((oc * icg + ic) * p.kernel_h + kh) *
+                                   p.kernel_w +
+                               kw]);
+                sum += x * w;
+              }
+            }
+          }
+          output_vec[((n * p.output_c + oc) * output_h + oh) * output_w +
+                     ow] = tiny::FromFloat<T>(sum);
+        }
+      }
+    }
+  }
+}
+
+/* |configure| (optional) sets up the op e.g., its algorithm, before Run(). */
+template <typename T>
+bool RunAndCheckConv(
+    const tiny::Conv2dParams& params,
+    const std::function<void(tiny::CpuConv<T>&)>& configure = nullptr) {
+  auto input = std::make_shared<tiny::Buffer<T>>(params.GetInputSize(), 123);
+  auto weight =
+      std::make_shared<tiny::Buffer<T>>(params.GetWeightSize(), 456);
+  auto output_reference =
+      std::make_shared<tiny::Buffer<T>>(params.GetOutputSize());
+  auto output_cpu_conv =
+      std::make_shared<tiny::Buffer<T>>(params.GetOutputSize());
+
+  RunReferenceConv<T>(params, input, weight, output_reference);
+
+  tiny::CpuConv<T> cpu_conv(params);
+  cpu_conv.SetBuffers(input, weight, output_cpu_conv);
+  if (configure) configure(cpu_conv);
+  log_blue("Conv {}x{}x{} -> {} with {}", params.input_h, params.input_w,
+           params.input_c, params.output_c,
+           tiny::GetConv2dAlgorithmName(cpu_conv.GetAlgorithm()));
+  bool pass = cpu_conv.Run() == tiny::Result::kSuccess;
+  return pass && IsErrorLargerThanThreshold<T>(
+                     output_reference, output_cpu_conv,
+                     params.GetOutputWidth(),
+                     params.GetOutputSize() / params.GetOutputWidth());
+}
+
+template <typename T>
+void TestConv() {
+  tiny::ClearConv2dPlanCache();
+
+  // The example in conv.h with fewer channels.
+  tiny::Conv2dParams example = {.input_h = 64,
+                                .input_w = 96,
+                                .input_c = 8,
+                                .output_c = 16,
+                                .kernel_h = 4,
+                                .kernel_w = 4,
+                                .padding_h = 2,
+                                .padding_w = 2};
+  tiny::Conv2dParams pointwise = {.batch = 2,
+                                  .input_h = 7,
+                                  .input_w = 9,
+                                  .input_c = 12,
+                                  .output_c = 10,
+                                  .kernel_h = 1,
+                                  .kernel_w = 1,
+                                  .groups = 2};
+  tiny::Conv2dParams strided = {.batch = 2,
+                                .input_h = 19,
+                                .input_w = 23,
+                                .input_c = 6,
+                                .output_c = 20,
+                                .kernel_h = 3,
+                                .kernel_w = 5,
+                                .stride_h = 2,
+                                .stride_w = 3,
+                                .padding_h = 1,
+                                .padding_w = 2,
+                                .dilation_h = 2,
+                                .dilation_w = 1,
+                                .groups = 2};
+  bool pass = RunAndCheckConv<T>(example);
+  pass = pass && RunAndCheckConv<T>(pointwise);
+  pass = pass && RunAndCheckConv<T>(strided);
+  pass = pass && RunAndCheckConv<T>(strided);
+
+  // A plan per shape, and the right algorithm for each.
+  pass = pass && tiny::GetConv2dPlanCacheSize() == 3;
+  pass = pass && tiny::GetConv2dPlan(strided) == tiny::GetConv2dPlan(strided);
+  pass = pass && tiny::GetConv2dPlan(pointwise)->algorithm ==
+                     tiny::Conv2dAlgorithm::kPointwise;
+  pass = pass && tiny::GetConv2dPlan(example)->algorithm ==
+                     tiny::Conv2dAlgorithm::kIm2col;
+  pass = pass && tiny::GetConv2dPlan(strided)->algorithm ==
+                     tiny::Conv2dAlgorithm::kDirect;
+
+  if (pass) {
+    log_green("-- PASS: {} --", __FUNCTION__);
+  } else {
+    log_error("-- FAIL: {} --", __FUNCTION__);
+  }
+}
+
+template <typename T>
+void TestIm2colConv() {
+  tiny::Conv2dParams params = {.batch = 2,
+                               .input_h = 30,
+                               .input_w = 27,
+                               .input_c = 16,
+                               .output_c = 32,
+                               .kernel_h = 3,
+                               .kernel_w = 3,
+                               .padding_h = 1,
+                               .padding_w = 1,
+                               .groups = 2};
+  tiny::Conv2dParams strided = {.input_h = 19,
+                                .input_w = 23,
+                                .input_c = 6,
+                                .output_c = 20,
+                                .kernel_h = 3,
+                                .kernel_w = 5,
+                                .stride_h = 2,
+                                .stride_w = 3,
+                                .padding_h = 1,
+                                .padding_w = 2,
+                                .dilation_h = 2};
+
+  // The whole lowered matrix at once, blocks of 100 pixels that do not align
+  // with output rows, and a single pixel per block.
+  const size_t depth = 8 * 3 * 3;
+  bool pass = RunAndCheckConv<T>(params, [](tiny::CpuConv<T>& conv) {
+    conv.SetAlgorithm(tiny::Conv2dAlgorithm::kIm2col);
+  });
+  pass = pass && RunAndCheckConv<T>(params, [&](tiny::CpuConv<T>& conv) {
+           conv.SetAlgorithm(tiny::Conv2dAlgorithm::kIm2col);
+           conv.SetIm2colMemoryBudget(100 * depth * sizeof(T));
+         });
+  pass = pass && RunAndCheckConv<T>(strided, [](tiny::CpuConv<T>& conv) {
+           conv.SetAlgorithm(tiny::Conv2dAlgorithm::kIm2col);
+           conv.SetIm2colMemoryBudget(1);
+         });
+
+  if (pass) {
+    log_green("-- PASS: {} --", __FUNCTION__);
+  } else {
+    log_error("-- FAIL: {} --", __FUNCTION__);
+  }
+}
+
+template <typename T>
+void TestWinogradConv() {
+  tiny::Conv2dParams params = {.batch = 2,
+                               .input_h = 30,
+                               .input_w = 27,
+                               .input_c = 16,
+                               .output_c = 16,
+                               .kernel_h = 3,
+                               .kernel_w = 3,
+                               .padding_h = 1,
+                               .padding_w = 1};
+  tiny::Conv2dParams small = {.input_h = 6,
+                              .input_w = 5,
+                              .input_c = 16,
+                              .output_c = 16,
+                              .kernel_h = 3,
+                              .kernel_w = 3,
+                              .groups = 2};
+  // 400 tiles of F(2x2, 3x3), more than a tile block.
+  tiny::Conv2dParams large = {.input_h = 40,
+                              .input_w = 40,
+                              .input_c = 8,
+                              .output_c = 8,
+                              .kernel_h = 3,
+                              .kernel_w = 3,
+                              .padding_h = 1,
+                              .padding_w = 1};
+  bool pass = tiny::GetConv2dPlan(params)->algorithm ==
+              tiny::Conv2dAlgorithm::kWinograd4x4;
+  pass = pass && tiny::GetConv2dPlan(small)->algorithm ==
+                     tiny::Conv2dAlgorithm::kWinograd2x2;
+  pass = pass && RunAndCheckConv<T>(params);
+  pass = pass && RunAndCheckConv<T>(params, [](tiny::CpuConv<T>& conv) {
+           conv.SetAlgorithm(tiny::Conv2dAlgorithm::kWinograd2x2);
+         });
+  pass = pass && RunAndCheckConv<T>(small);
+  pass = pass && RunAndCheckConv<T>(large, [](tiny::CpuConv<T>& conv) {
+           conv.SetAlgorithm(tiny::Conv2dAlgorithm::kWinograd2x2);
+         });
+  pass = pass && RunAndCheckConv<T>(large);
+
+  // The transformed weight is reused, and transformed again when the weight
+  // is marked dirty (see TestConvWeightCache()).
+  auto input = std::make_shared<tiny::Buffer<T>>(params.GetInputSize(), 123);
+  auto weight =
+      std::make_shared<tiny::Buffer<T>>(params.GetWeightSize(), 456);
+  auto output_reference =
+      std::make_shared<tiny::Buffer<T>>(params.GetOutputSize());
+  auto output = std::make_shared<tiny::Buffer<T>>(params.GetOutputSize());
+  tiny::CpuConv<T> winograd_conv(params);
+  winograd_conv.SetBuffers(input, weight, output);
+  winograd_conv.Run();
+  auto& weight_vec = weight->GetVector();
+  for (uint32_t i = 0; i < 9; ++i) weight_vec[i] = tiny::FromFloat<T>(0.5f);
+  weight->MarkDirty(0, 9);
+  winograd_conv.Run();
+  RunReferenceConv<T>(params, input, weight, output_reference);
+  pass = pass && IsErrorLargerThanThreshold<T>(
+                     output_reference, output, params.GetOutputWidth(),
+                     params.GetOutputSize() / params.GetOutputWidth());
+  // The dirty ranges are left to the other consumers of the weight.
+  pass = pass && !weight->GetDirtyRanges().empty();
+
+  if (pass) {
+    log_green("-- PASS: {} --", __FUNCTION__);
+  } else {
+    log_error("-- FAIL: {} --", __FUNCTION__);
+  }
+}
+
+/* Returns NCHW |buffer| of |n| x |c| x |h| x |w| in NHWC. */
+template <typename T>
+std::shared_ptr<tiny::Buffer<T>> ToNHWC(std::shared_ptr<tiny::Buffer<T>> buffer,
+                                        uint32_t n, uint32_t c, uint32_t h,
+                                        uint32_t w) {
+  auto nhwc = std::make_shared<tiny::Buffer<T>>(buffer->GetNumberOfElements());
+  auto& src = buffer->GetVector();
+  auto& dst = nhwc->GetVector();
+  for (uint32_t b = 0; b < n; ++b) {
+    for (uint32_t ch = 0; ch < c; ++ch) {
+      for (uint32_t i = 0; i < h * w; ++i) {
+        dst[(b * h * w + i) * c + ch] = src[(b * c + ch) * h * w + i];
+      }
+    }
+  }
+  return nhwc;
+}
+
+/* Returns OIHW |weight| of |o| x |i| x |h| x |w| in HWIO. */
+template <typename T>
+std::shared_ptr<tiny::Buffer<T>> ToHWIO(std::shared_ptr<tiny::Buffer<T>> weight,
+                                        uint32_t o, uint32_t i, uint32_t h,
+                                        uint32_t w) {
+  auto hwio = std::make_shared<tiny::Buffer<T>>(weight->GetNumberOfElements());
+  auto& src = weight->GetVector();
+  auto& dst = hwio->GetVector();
+  for (uint32_t oc = 0; oc < o; ++oc) {
+    for (uint32_t ic = 0; ic < i; ++ic) {
+      for (uint32_t k = 0; k < h * w; ++k) {
+        dst[(k * i + ic) * o + oc] = src[(oc * i + ic) * h * w + k];
+      }
+    }
+  }
+  return hwio;
+}
+
+/*
+ * Runs |params| in NHWC and compares it with the NCHW reference. |configure|
+ * (optional) sets up the op before Run().
+ */
+template <typename T>
+bool RunAndCheckNHWCConv(
+    tiny::Conv2dParams params,
+    const std::function<void(tiny::CpuConv<T>&)>& configure = nullptr) {
+  params.layout = tiny::Conv2dLayout::kNCHW;
+  auto input = std::make_shared<tiny::Buffer<T>>(params.GetInputSize(), 123);
+  auto weight =
+      std::make_shared<tiny::Buffer<T>>(params.GetWeightSize(), 456);
+  auto output = std::make_shared<tiny::Buffer<T>>(params.GetOutputSize());
+  RunReferenceConv<T>(params, input, weight, output);
+
+  const uint32_t output_h = params.GetOutputHeight();
+  const uint32_t output_w = params.GetOutputWidth();
+  auto output_reference = ToNHWC<T>(output, params.batch, params.output_c,
+                                    output_h, output_w);
+  auto output_nhwc = std::make_shared<tiny::Buffer<T>>(params.GetOutputSize());
+
+  params.layout = tiny::Conv2dLayout::kNHWC;
+  tiny::CpuConv<T> cpu_conv(params);
+  cpu_conv.SetBuffers(
+      ToNHWC<T>(input, params.batch, params.input_c, params.input_h,
+                params.input_w),
+      ToHWIO<T>(weight, params.output_c, params.input_c / params.groups,
+                params.kernel_h, params.kernel_w),
+      output_nhwc);
+  if (configure) configure(cpu_conv);
+  log_blue("NHWC conv {}x{}x{} -> {} with {}", params.input_h,
+           params.input_w, params.input_c, params.output_c,
+           tiny::GetConv2dAlgorithmName(cpu_conv.GetAlgorithm()));
+  bool pass = cpu_conv.Run() == tiny::Result::kSuccess;
+  return pass && IsErrorLargerThanThreshold<T>(
+                     output_reference, output_nhwc, params.output_c,
+                     params.GetOutputSize() / params.output_c);
+}
+
+template <typename T>
+void TestNHWCConv() {
+  // Output channels and columns that do not fill the register tile.
+  tiny::Conv2dParams params = {.batch = 2,
+                               .input_h = 13,
+                               .input_w = 15,
+                               .input_c = 24,
+                               .output_c = 72,
+                               .kernel_h = 3,
+                               .kernel_w = 3,
+                               .padding_h = 1,
+                               .padding_w = 1};
+  tiny::Conv2dParams strided = {.batch = 2,
+                                .input_h = 19,
+                                .input_w = 23,
+                                .input_c = 6,
+                                .output_c = 20,
+                                .kernel_h = 3,
+                                .kernel_w = 5,
+                                .stride_h = 2,
+                                .stride_w = 3,
+                                .padding_h = 1,
+                                .padding_w = 2,
+                                .dilation_h = 2,
+                                .dilation_w = 1,
+                                .groups = 2};
+  tiny::Conv2dParams pointwise = {.batch = 2,
+                                  .input_h = 7,
+                                  .input_w = 9,
+                                  .input_c = 12,
+                                  .output_c = 10,
+                                  .kernel_h = 1,
+                                  .kernel_w = 1,
+                                  .groups = 2};
+  bool pass = RunAndCheckNHWCConv<T>(params);
+  pass = pass && RunAndCheckNHWCConv<T>(strided);
+  pass = pass && RunAndCheckNHWCConv<T>(pointwise);
+
+  if (pass) {
+    log_green("-- PASS: {} --", __FUNCTION__);
+  } else {
+    log_error("-- FAIL: {} --", __FUNCTION__);
+  }
+}
+
+/* Returns true if the work items of |partition| cover its output once. */
+bool CoversOutputOnce(const tiny::Conv2dPartition& partition) {
+  std::vector<uint32_t> count(partition.batch * partition.output_c *
+                              partition.output_h * partition.output_w);
+  for (uint32_t i = 0; i < partition.GetNumberOfItems(); ++i) {
+    const tiny::Conv2dWorkItem item = partition.GetItem(i);
+    for (uint32_t oc = item.oc_begin; oc < item.oc_end; ++oc) {
+      for (uint32_t oh = item.oh_begin; oh < item.oh_end; ++oh) {
+        for (uint32_t ow = item.ow_begin; ow < item.ow_end; ++ow) {
+          ++count[((item.n * partition.output_c + oc) * partition.output_h +
+                   oh) *
+                      partition.output_w +
+                  ow];
+        }
+      }
+    }
+  }
+  return std::all_of(count.begin(), count.end(),
+                     [](uint32_t c) { return c == 1; });
+}
+
+template <typename T>
+void TestConvPartition() {
+  // A single small image is split down to single rows and channels.
+  tiny::Conv2dParams small = {.input_h = 7,
+                              .input_w = 7,
+                              .input_c = 4,
+                              .output_c = 8,
+                              .kernel_h = 3,
+                              .kernel_w = 3,
+                              .padding_h = 1,
+                              .padding_w = 1};
+  auto partition = tiny::PartitionConv2d(*tiny::GetConv2dPlan(small), 8, 1,
+                                         tiny::kMinConvTileWidthCPU, 64);
+  bool pass = partition.GetNumberOfItems() == 7 * 8;
+  pass = pass && partition.tile_h == 1 && partition.block_output_c == 1;
+  pass = pass && CoversOutputOnce(partition);
+
+  // A large batch has enough items without splitting images.
+  tiny::Conv2dParams batched = small;
+  batched.batch = 64;
+  partition = tiny::PartitionConv2d(*tiny::GetConv2dPlan(batched), 8, 1,
+                                    tiny::kMinConvTileWidthCPU, 4);
+  pass = pass && partition.tile_h == 7 && partition.block_output_c == 8;
+
+  // Uneven channels, rows and columns, split down to the columns.
+  tiny::Conv2dParams uneven = {.input_h = 5,
+                               .input_w = 70,
+                               .input_c = 6,
+                               .output_c = 40,
+                               .kernel_h = 3,
+                               .kernel_w = 3,
+                               .groups = 2,
+                               .layout = tiny::Conv2dLayout::kNHWC};
+  partition = tiny::PartitionConv2d(*tiny::GetConv2dPlan(uneven),
+                                    tiny::kNHWCBlockChannelsCPU,
+                                    tiny::kNHWCTileChannelsCPU,
+                                    tiny::kNHWCTilePixelsCPU, 32);
+  pass = pass && partition.GetNumberOfItems() >= 32 * 4;
+  pass = pass && partition.tile_w < 68 && CoversOutputOnce(partition);
+
+  // With pooling, the odd last row and column are left out, and the tiles
+  // hold whole 2x2 windows.
+  partition = tiny::PartitionConv2d(*tiny::GetConv2dPlan(small), 8, 1,
+                                    tiny::kMinConvTileWidthCPU, 64, false,
+                                    true);
+  pass = pass && partition.output_h == 6 && partition.output_w == 6;
+  pass = pass && partition.tile_h == 2 && CoversOutputOnce(partition);
+
+  // The results do not depend on the number of threads.
+  uneven.layout = tiny::Conv2dLayout::kNCHW;
+  for (uint32_t num_threads : {1u, 3u, 8u}) {
+    tiny::SetNumberOfHostThreads(num_threads);
+    pass = pass && RunAndCheckConv<T>(uneven);
+    pass = pass && RunAndCheckNHWCConv<T>(uneven);
+  }
+  tiny::SetNumberOfHostThreads(0);
+
+  if (pass) {
+    log_green("-- PASS: {} --", __FUNCTION__);
+  } else {
+    log_error("-- FAIL: {} --", __FUNCTION__);
+  }
+}
+
+/*
+ * Checks a batch of small images with each algorithm, and reports the
+ * throughput of the batch against that of the images one by one.
+ */
+template <typename T>
+void TestBatchedConv() {
+  tiny::Conv2dParams params = {.batch = 16,
+                               .input_h = 8,
+                               .input_w = 8,
+                               .input_c = 16,
+                               .output_c = 32,
+                               .kernel_h = 3,
+                               .kernel_w = 3,
+                               .padding_h = 1,
+                               .padding_w = 1};
+  bool pass = true;
+  for (auto algorithm : {tiny::Conv2dAlgorithm::kWinograd2x2,
+                         tiny::Conv2dAlgorithm::kWinograd4x4,
+                         tiny::Conv2dAlgorithm::kIm2col,
+                         tiny::Conv2dAlgorithm::kDirect}) {
+    pass = pass && RunAndCheckConv<T>(params, [=](tiny::CpuConv<T>& conv) {
+             conv.SetAlgorithm(algorithm);
+           });
+  }
+
+  // Blocks of three whole images, the last one with a single image.
+  const size_t depth = 16 * 3 * 3;
+  pass = pass && RunAndCheckConv<T>(params, [&](tiny::CpuConv<T>& conv) {
+           conv.SetAlgorithm(tiny::Conv2dAlgorithm::kIm2col);
+           conv.SetIm2colMemoryBudget(3 * 8 * 8 * depth * sizeof(T));
+         });
+
+  tiny::Conv2dParams single = params;
+  single.batch = 1;
+  auto input = std::make_shared<tiny::Buffer<T>>(params.GetInputSize(), 123);
+  auto weight =
+      std::make_shared<tiny::Buffer<T>>(params.GetWeightSize(), 456);
+  auto output = std::make_shared<tiny::Buffer<T>>(params.GetOutputSize());
+  auto single_input =
+      std::make_shared<tiny::Buffer<T>>(single.GetInputSize(), 123);
+  auto single_output =
+      std::make_shared<tiny::Buffer<T>>(single.GetOutputSize());
+  tiny::CpuConv<T> batched_conv(params);
+  batched_conv.SetBuffers(input, weight, output);
+  tiny::CpuConv<T> single_conv(single);
+  single_conv.SetBuffers(single_input, weight, single_output);
+
+  // The first runs transform the weight.
+  pass = pass && batched_conv.Run() == tiny::Result::kSuccess;
+  pass = pass && single_conv.Run() == tiny::Result::kSuccess;
+  double batched_seconds = MeasureSeconds([&]() { batched_conv.Run(); });
+  double single_seconds = MeasureSeconds([&]() {
+    for (uint32_t n = 0; n < params.batch; ++n) single_conv.Run();
+  });
+  log_blue("{}: {} images/s in a batch of {}, {} images/s one by one",
+           tiny::GetConv2dAlgorithmName(batched_conv.GetAlgorithm()),
+           params.batch / batched_seconds, params.batch,
+           params.batch / single_seconds);
+
+  if (pass) {
+    log_green("-- PASS: {} --", __FUNCTION__);
+  } else {
+    log_error("-- FAIL: {} --", __FUNCTION__);
+  }
+}
+
+/*
+ * Applies |epilogue| to the NCHW output of the convolution of |params| in
+ * |output|, and writes the result to |result|.
+ */
+template <typename T>
+void RunReferenceEpilogue(const tiny::Conv2dParams& p,
+                          const tiny::Conv2dEpilogue& epilogue,
+                          std::shared_ptr<tiny::Buffer<T>> output,
+                          std::shared_ptr<tiny::Buffer<T>> result) {
+  auto& output_vec = output->GetVector();
+  auto& result_vec = result->GetVector();
+  const uint32_t output_h = p.GetOutputHeight();
+  const uint32_t output_w = p.GetOutputWidth();
+  std::vector<float> activated(output_vec.size());
+  for (size_t i = 0; i < output_vec.size(); ++i) {
+    const uint32_t c = i / (output_h * output_w) % p.output_c;
+    float x = tiny::ToFloat(output_vec[i]);
+    if (!epilogue.bias.empty()) x += epilogue.bias[c];
+    if (epilogue.HasBatchNorm()) {
+      x = (x - epilogue.batch_norm_mean[c]) /
+              std::sqrt(epilogue.batch_norm_variance[c] +
+                        epilogue.batch_norm_epsilon) *
+              epilogue.batch_norm_gamma[c] +
+          epilogue.batch_norm_beta[c];
+    }
+    activated[i] = tiny::Activate(epilogue.activation, x);
+  }
+
+  if (epilogue.pooling == tiny::Conv2dPooling::kNone) {
+    for (size_t i = 0; i < activated.size(); ++i) {
+      result_vec[i] = tiny::FromFloat<T>(activated[i]);
+    }
+    return;
+  }
+  const uint32_t pooled_h = output_h / 2;
+  const uint32_t pooled_w = output_w / 2;
+  for (uint32_t plane = 0; plane < p.batch * p.output_c; ++plane) {
+    for (uint32_t h = 0; h < pooled_h; ++h) {
+      for (uint32_t w = 0; w < pooled_w; ++w) {
+        float max = -INFINITY;
+        float sum = 0.0f;
+        for (uint32_t i = 0; i < 2; ++i) {
+          for (uint32_t j = 0; j < 2; ++j) {
+            float x = activated[(static_cast<size_t>(plane) * output_h +
+                                 2 * h + i) *
+                                    output_w +
+                                2 * w + j];
+            max = std::max(max, x);
+            sum += x;
+          }
+        }
+        result_vec[(static_cast<size_t>(plane) * pooled_h + h) * pooled_w +
+                   w] = tiny::FromFloat<T>(
+            epilogue.pooling == tiny::Conv2dPooling::kMax2x2 ? max
+                                                             : sum / 4.0f);
+      }
+    }
+  }
+}
+
+/*
+ * Runs |params| with |epilogue| in the layout of |params| and compares it with
+ * the reference. |configure| (optional) sets up the op before Run().
+ */
+template <typename T>
+bool RunAndCheckConvEpilogue(
+    tiny::Conv2dParams params, const tiny::Conv2dEpilogue& epilogue,
+    const std::function<void(tiny::CpuConv<T>&)>& configure = nullptr) {
+  const tiny::Conv2dLayout layout = params.layout;
+  params.layout = tiny::Conv2dLayout::kNCHW;
+  auto input = std::make_shared<tiny::Buffer<T>>(params.GetInputSize(), 123);
+  auto weight =
+      std::make_shared<tiny::Buffer<T>>(params.GetWeightSize(), 456);
+  auto conv_output = std::make_shared<tiny::Buffer<T>>(params.GetOutputSize());
+  auto output_reference =
+      std::make_shared<tiny::Buffer<T>>(epilogue.GetOutputSize(params));
+  RunReferenceConv<T>(params, input, weight, conv_output);
+  RunReferenceEpilogue<T>(params, epilogue, conv_output, output_reference);
+
+  const uint32_t output_h = epilogue.GetOutputHeight(params);
+  const uint32_t output_w = epilogue.GetOutputWidth(params);
+  auto output =
+      std::make_shared<tiny::Buffer<T>>(epilogue.GetOutputSize(params));
+  params.layout = layout;
+  tiny::CpuConv<T> cpu_conv(params);
+  cpu_conv.SetEpilogue(epilogue);
+  if (layout == tiny::Conv2dLayout::kNHWC) {
+    input = ToNHWC<T>(input, params.batch, params.input_c, params.input_h,
+                      params.input_w);
+    weight = ToHWIO<T>(weight, params.output_c, params.input_c / params.groups,
+                       params.kernel_h, params.kernel_w);
+    output_reference = ToNHWC<T>(output_reference, params.batch,
+                                 params.output_c, output_h, output_w);
+  }
+  cpu_conv.SetBuffers(input, weight, output);
+  if (configure) configure(cpu_conv);
+  log_blue("Conv {}x{}x{} -> {}x{}x{} with {}", params.input_h,
+           params.input_w, params.input_c, output_h, output_w,
+           params.output_c,
+           tiny::GetConv2dAlgorithmName(cpu_conv.GetAlgorithm()));
+  bool pass = cpu_conv.Run() == tiny::Result::kSuccess;
+  return pass && IsErrorLargerThanThreshold<T>(
+                     output_reference, output, output_w,
+                     epilogue.GetOutputSize(params) / output_w);
+}
+
+/*
+ * Returns an epilogue with bias and batch norm for |output_c| channels, ReLU
+ * and 2x2 max pooling.
+ */
+tiny::Conv2dEpilogue MakeTestConvEpilogue(uint32_t output_c) {
+  tiny::Conv2dEpilogue epilogue;
+  for (uint32_t c = 0; c < output_c; ++c) {
+    epilogue.bias.push_back(0.1f * c - 0.5f);
+    epilogue.batch_norm_mean.push_back(0.05f * c);
+    epilogue.batch_norm_variance.push_back(0.5f + 0.1f * c);
+    epilogue.batch_norm_gamma.push_back(1.5f - 0.05f * c);
+    epilogue.batch_norm_beta.push_back(0.2f);
+  }
+  epilogue.activation = tiny::Activation::kReLU;
+  epilogue.pooling = tiny::Conv2dPooling::kMax2x2;
+  return epilogue;
+}
+
+/* Bias, batch norm, activation and pooling with every algorithm. */
+template <typename T>
+void TestConvEpilogue() {
+  tiny::Conv2dParams params = {.batch = 2,
+                               .input_h = 11,
+                               .input_w = 12,
+                               .input_c = 16,
+                               .output_c = 16,
+                               .kernel_h = 3,
+                               .kernel_w = 3,
+                               .padding_h = 1,
+                               .padding_w = 1};
+  tiny::Conv2dEpilogue epilogue = MakeTestConvEpilogue(params.output_c);
+
+  bool pass = true;
+  for (auto algorithm : {tiny::Conv2dAlgorithm::kWinograd2x2,
+                         tiny::Conv2dAlgorithm::kWinograd4x4,
+                         tiny::Conv2dAlgorithm::kIm2col,
+                         tiny::Conv2dAlgorithm::kDirect}) {
+    for (bool fold : {false, true}) {
+      epilogue.fold_batch_norm = fold;
+      pass = pass && RunAndCheckConvEpilogue<T>(
+                         params, epilogue, [=](tiny::CpuConv<T>& conv) {
+                           conv.SetAlgorithm(algorithm);
+                         });
+    }
+  }
+
+  // Bias only, GELU and average pooling, in both layouts.
+  tiny::Conv2dParams pointwise = {.batch = 2,
+                                  .input_h = 7,
+                                  .input_w = 9,
+                                  .input_c = 12,
+                                  .output_c = 16,
+                                  .kernel_h = 1,
+                                  .kernel_w = 1,
+                                  .groups = 2};
+  tiny::Conv2dEpilogue bias_only = {.bias = epilogue.bias,
+                                    .activation =
+                                        tiny::Activation::kGELU,
+                                    .pooling =
+                                        tiny::Conv2dPooling::kAverage2x2};
+  pass = pass && RunAndCheckConvEpilogue<T>(pointwise, bias_only);
+  pointwise.layout = tiny::Conv2dLayout::kNHWC;
+  pass = pass && RunAndCheckConvEpilogue<T>(pointwise, bias_only);
+
+  // Batch norm in the GEMM epilogue of both layouts, whose channels are the
+  // rows with kNCHW and the columns with kNHWC.
+  tiny::Conv2dEpilogue unfolded = epilogue;
+  unfolded.fold_batch_norm = false;
+  for (auto layout : {tiny::Conv2dLayout::kNCHW, tiny::Conv2dLayout::kNHWC}) {
+    pointwise.layout = layout;
+    pass = pass && RunAndCheckConvEpilogue<T>(pointwise, unfolded);
+  }
+
+  // Pooling in the kernels of kNHWC, of kGrouped, and in kIm2col blocks
+  // smaller than an image.
+  pass = pass && RunAndCheckConvEpilogue<T>(
+                     params, epilogue, [](tiny::CpuConv<T>& conv) {
+                       conv.SetAlgorithm(tiny::Conv2dAlgorithm::kIm2col);
+                       conv.SetIm2colMemoryBudget(1);
+                     });
+  tiny::Conv2dParams grouped = params;
+  grouped.groups = 4;
+  for (auto layout : {tiny::Conv2dLayout::kNCHW, tiny::Conv2dLayout::kNHWC}) {
+    grouped.layout = layout;
+    pass = pass && RunAndCheckConvEpilogue<T>(
+                       grouped, bias_only, [](tiny::CpuConv<T>& conv) {
+                         conv.SetAlgorithm(tiny::Conv2dAlgorithm::kGrouped);
+                       });
+  }
+  params.layout = tiny::Conv2dLayout::kNHWC;
+  pass = pass && RunAndCheckConvEpilogue<T>(params, epilogue);
+
+  // Folded batch norm without pooling in NHWC.
+  epilogue.pooling = tiny::Conv2dPooling::kNone;
+  pass = pass && RunAndCheckConvEpilogue<T>(params, epilogue);
+
+  if (pass) {
+    log_green("-- PASS: {} --", __FUNCTION__);
+  } else {
+    log_error("-- FAIL: {} --", __FUNCTION__);
+  }
+}
+
+/* Returns the seconds of a run of |params| with |algorithm|. */
+template <typename T>
+double MeasureConv(const tiny::Conv2dParams& params,
+                   tiny::Conv2dAlgorithm algorithm) {
+  auto input = std::make_shared<tiny::Buffer<T>>(params.GetInputSize(), 123);
+  auto weight =
+      std::make_shared<tiny::Buffer<T>>(params.GetWeightSize(), 456);
+  auto output = std::make_shared<tiny::Buffer<T>>(params.GetOutputSize());
+  tiny::CpuConv<T> cpu_conv(params);
+  cpu_conv.SetBuffers(input, weight, output);
+  cpu_conv.SetAlgorithm(algorithm);
+  cpu_conv.Run();
+  return MeasureSeconds([&]() { cpu_conv.Run(); });
+}
+
+/*
+ * Checks depthwise and grouped convolutions in both layouts, and reports the
+ * time of the grouped kernels against the dense paths.
+ */
+template <typename T>
+void TestGroupedConv() {
+  tiny::Conv2dParams depthwise = {.batch = 2,
+                                  .input_h = 17,
+                                  .input_w = 19,
+                                  .input_c = 24,
+                                  .output_c = 24,
+                                  .kernel_h = 3,
+                                  .kernel_w = 3,
+                                  .padding_h = 1,
+                                  .padding_w = 1,
+                                  .groups = 24};
+  // Two output channels per input channel, with stride and dilation.
+  tiny::Conv2dParams multiplier = {.input_h = 20,
+                                   .input_w = 21,
+                                   .input_c = 8,
+                                   .output_c = 16,
+                                   .kernel_h = 3,
+                                   .kernel_w = 3,
+                                   .stride_h = 2,
+                                   .stride_w = 2,
+                                   .padding_h = 2,
+                                   .padding_w = 1,
+                                   .dilation_h = 2,
+                                   .groups = 8};
+  tiny::Conv2dParams grouped = {.batch = 2,
+                                .input_h = 13,
+                                .input_w = 35,
+                                .input_c = 24,
+                                .output_c = 24,
+                                .kernel_h = 5,
+                                .kernel_w = 3,
+                                .stride_w = 2,
+                                .padding_h = 2,
+                                .padding_w = 1,
+                                .groups = 6};
+  // The largest groups of kGrouped, with a kernel Winograd does not take.
+  tiny::Conv2dParams wide = {.input_h = 23,
+                             .input_w = 18,
+                             .input_c = 32,
+                             .output_c = 32,
+                             .kernel_h = 5,
+                             .kernel_w = 3,
+                             .stride_h = 2,
+                             .padding_h = 2,
+                             .padding_w = 1,
+                             .groups = 4};
+  bool pass = true;
+  for (const auto& params : {depthwise, multiplier, grouped, wide}) {
+    pass = pass && tiny::GetConv2dPlan(params)->algorithm ==
+                       tiny::Conv2dAlgorithm::kGrouped;
+    pass = pass && RunAndCheckConv<T>(params);
+    pass = pass && RunAndCheckNHWCConv<T>(params);
+  }
+
+  tiny::Conv2dParams large = {.input_h = 112,
+                              .input_w = 112,
+                              .input_c = 64,
+                              .output_c = 64,
+                              .kernel_h = 3,
+                              .kernel_w = 3,
+                              .padding_h = 1,
+                              .padding_w = 1,
+                              .groups = 64};
+  log_blue("Depthwise 112x112x64: grouped {} s, direct {} s, im2col {} s",
+           MeasureConv<T>(large, tiny::Conv2dAlgorithm::kGrouped),
+           MeasureConv<T>(large, tiny::Conv2dAlgorithm::kDirect),
+           MeasureConv<T>(large, tiny::Conv2dAlgorithm::kIm2col));
+  large.layout = tiny::Conv2dLayout::kNHWC;
+  log_blue("NHWC depthwise 112x112x64: grouped {} s, direct {} s",
+           MeasureConv<T>(large, tiny::Conv2dAlgorithm::kGrouped),
+           MeasureConv<T>(large, tiny::Conv2dAlgorithm::kDirect));
+
+  if (pass) {
+    log_green("-- PASS: {} --", __FUNCTION__);
+  } else {
+    log_error("-- FAIL: {} --", __FUNCTION__);
+  }
+}
+
+/*
+ * Packed weights are shared by the ops of a weight buffer, packed again when
+ * the buffer changes, and dropped with the buffer. The tilized weight holds
+ * the [kernel_h * kernel_w * icg, ocg] matrix of each group.
+ */
+template <typename T>
+void TestConvWeightCache() {
+  tiny::ClearConv2dWeightCache();
+  tiny::Conv2dParams params = {.batch = 2,
+                               .input_h = 12,
+                               .input_w = 10,
+                               .input_c = 16,
+                               .output_c = 16,
+                               .kernel_h = 3,
+                               .kernel_w = 3,
+                               .padding_h = 1,
+                               .padding_w = 1};
+  auto plan = tiny::GetConv2dPlan(params);
+  auto input = std::make_shared<tiny::Buffer<T>>(params.GetInputSize(), 123);
+  auto weight =
+      std::make_shared<tiny::Buffer<T>>(params.GetWeightSize(), 456);
+  auto output_reference =
+      std::make_shared<tiny::Buffer<T>>(params.GetOutputSize());
+  auto output0 = std::make_shared<tiny::Buffer<T>>(params.GetOutputSize());
+  auto output1 = std::make_shared<tiny::Buffer<T>>(params.GetOutputSize());
+  tiny::CpuConv<T> conv0(params);
+  conv0.SetBuffers(input, weight, output0);
+  tiny::CpuConv<T> conv1(params);
+  conv1.SetBuffers(input, weight, output1);
+
+  const auto layout = tiny::Conv2dWeightLayout::kWinograd4x4;
+  bool pass = plan->algorithm == tiny::Conv2dAlgorithm::kWinograd4x4;
+  pass = pass && conv0.Run() == tiny::Result::kSuccess;
+  auto packed = tiny::GetPackedConv2dWeight<T>(*plan, layout, weight);
+  pass = pass && conv1.Run() == tiny::Result::kSuccess;
+  pass = pass && tiny::GetConv2dWeightCacheSize() == 1;
+  pass = pass &&
+         tiny::GetPackedConv2dWeight<T>(*plan, layout, weight) == packed;
+
+  auto& weight_vec = weight->GetVector();
+  for (uint32_t i = 0; i < 9; ++i) weight_vec[i] = tiny::FromFloat<T>(0.5f);
+  weight->MarkDirty(0, 9);
+  pass = pass && conv1.Run() == tiny::Result::kSuccess;
+  RunReferenceConv<T>(params, input, weight, output_reference);
+  pass = pass && IsErrorLargerThanThreshold<T>(
+                     output_reference, output1, params.GetOutputWidth(),
+                     params.GetOutputSize() / params.GetOutputWidth());
+  pass = pass &&
+         tiny::GetPackedConv2dWeight<T>(*plan, layout, weight) != packed;
+  pass = pass && tiny::GetConv2dWeightCacheSize() == 1;
+
+  // Another batch size and input size of the weight share its entry.
+  tiny::Conv2dParams larger = params;
+  larger.batch = 1;
+  larger.input_h = 20;
+  larger.input_w = 17;
+  pass = pass && tiny::GetPackedConv2dWeight<T>(*tiny::GetConv2dPlan(larger),
+                                                layout, weight) ==
+                     tiny::GetPackedConv2dWeight<T>(*plan, layout, weight);
+  pass = pass && tiny::GetConv2dWeightCacheSize() == 1;
+
+  // The tilized weight of a grouped shape with partial tiles, in both
+  // layouts.
+  tiny::Conv2dParams grouped = {.input_h = 9,
+                                .input_w = 9,
+                                .input_c = 10,
+                                .output_c = 36,
+                                .kernel_h = 3,
+                                .kernel_w = 2,
+                                .groups = 2};
+  auto oihw = std::make_shared<tiny::Buffer<T>>(grouped.GetWeightSize(), 789);
+  const uint32_t icg = 5;
+  const uint32_t ocg = 18;
+  const uint32_t kernel_size = 6;
+  for (auto conv_layout : {tiny::Conv2dLayout::kNCHW,
+                           tiny::Conv2dLayout::kNHWC}) {
+    grouped.layout = conv_layout;
+    auto grouped_weight = conv_layout == tiny::Conv2dLayout::kNCHW
+                              ? oihw
+                              : ToHWIO<T>(oihw, grouped.output_c, icg,
+                                          grouped.kernel_h, grouped.kernel_w);
+    auto tilized = tiny::GetPackedConv2dWeight<T>(
+        *tiny::GetConv2dPlan(grouped), tiny::Conv2dWeightLayout::kTilized,
+        grouped_weight);
+    const uint32_t width = tilized->tilized_width;
+    const uint32_t height = tilized->tilized_height;
+    pass = pass && width == 32 && height == 32;
+    for (uint32_t g = 0; g < grouped.groups && pass; ++g) {
+      std::vector<T> matrix(
+          tilized->tilized.begin() + g * width * height,
+          tilized->tilized.begin() + (g + 1) * width * height);
+      tiny::UnTilizeForTTDevice(matrix, width, height);
+      for (uint32_t k = 0; k < kernel_size; ++k) {
+        for (uint32_t ic = 0; ic < icg; ++ic) {
+          for (uint32_t o = 0; o < ocg; ++o) {
+            pass = pass &&
+                   tiny::ToFloat(matrix[(k * icg + ic) * width + o]) ==
+                       tiny::ToFloat(oihw->GetVector()
+                                         [((g * ocg + o) * icg + ic) *
+                                              kernel_size +
+                                          k]);
+          }
+        }
+      }
+      pass = pass && tiny::ToFloat(matrix[width * height - 1]) == 0.0f;
+    }
+  }
+  pass = pass && tiny::GetConv2dWeightCacheSize() == 3;
+
+  // Entries of released weights are dropped by the next packing.
+  oihw.reset();
+  tiny::GetPackedConv2dWeight<T>(*plan, tiny::Conv2dWeightLayout::kWinograd2x2,
+                                 weight);
+  pass = pass && tiny::GetConv2dWeightCacheSize() == 2;
+  tiny::ClearConv2dWeightCache();
+  pass = pass && tiny::GetConv2dWeightCacheSize() == 0;
+
+  if (pass) {
+    log_green("-- PASS: {} --", __FUNCTION__);
+  } else {
+    log_error("-- FAIL: {} --", __FUNCTION__);
+  }
+}
+
+/*
+ * Tiles cover the output once with their halos, and a tiled run matches the
+ * reference for several algorithms, both layouts and an epilogue.
+ */
+template <typename T>
+void TestConvSpatialTiling() {
+  tiny::Conv2dParams params = {.batch = 2,
+                               .input_h = 37,
+                               .input_w = 45,
+                               .input_c = 8,
+                               .output_c = 16,
+                               .kernel_h = 3,
+                               .kernel_w = 3,
+                               .padding_h = 1,
+                               .padding_w = 1};
+  tiny::Conv2dParams strided = {.input_h = 40,
+                                .input_w = 33,
+                                .input_c = 6,
+                                .output_c = 12,
+                                .kernel_h = 5,
+                                .kernel_w = 3,
+                                .stride_h = 2,
+                                .stride_w = 3,
+                                .padding_h = 2,
+                                .padding_w = 1,
+                                .dilation_h = 2};
+  const size_t budget = 16 * 1024;
+
+  bool pass = true;
+  for (const auto& p : {params, strided}) {
+    auto tiling = tiny::PlanConv2dSpatialTiling(p, budget, sizeof(T));
+    pass = pass && tiling.GetNumberOfTiles() > 1 &&
+           tiling.working_set_bytes <= budget && tiling.halo_overhead > 0.0;
+    log_blue("{}x{} output in {} tiles of {}x{}, {} bytes, halo overhead {}",
+             p.GetOutputHeight(), p.GetOutputWidth(),
+             tiling.GetNumberOfTiles(), tiling.tile_h, tiling.tile_w,
+             tiling.working_set_bytes, tiling.halo_overhead);
+
+    // Each output pixel is in a tile, whose input range matches the index
+    // tables of the plan.
+    auto plan = tiny::GetConv2dPlan(p);
+    std::vector<uint32_t> count(p.GetOutputHeight() * p.GetOutputWidth());
+    for (uint32_t i = 0; i < tiling.GetNumberOfTiles(); ++i) {
+      auto tile = tiling.GetTile(i);
+      for (uint32_t oh = tile.oh_begin; oh < tile.oh_end; ++oh) {
+        for (uint32_t ow = tile.ow_begin; ow < tile.ow_end; ++ow) {
+          ++count[oh * p.GetOutputWidth() + ow];
+        }
+      }
+      const int32_t first_row = plan->input_rows[tile.oh_begin * p.kernel_h];
+      const int32_t last_row =
+          plan->input_rows[tile.oh_end * p.kernel_h - 1];
+      pass = pass && (first_row < 0 || first_row == tile.ih_begin);
+      pass = pass && (last_row < 0 || last_row == tile.ih_end - 1);
+    }
+    pass = pass && std::all_of(count.begin(), count.end(),
+                               [](uint32_t c) { return c == 1; });
+  }
+
+  // The whole output in a single tile has no halo.
+  auto whole = tiny::PlanConv2dSpatialTiling(params, 1 << 30, sizeof(T));
+  pass = pass && whole.GetNumberOfTiles() == 1 && whole.halo_overhead == 0.0;
+
+  // With pooling, the tiles hold whole 2x2 windows.
+  auto pooled = tiny::PlanConv2dSpatialTiling(params, budget, sizeof(T), true);
+  pass = pass && pooled.tile_h % 2 == 0 && pooled.tile_w % 2 == 0;
+
+  auto tiled = [&](tiny::CpuConv<T>& conv) {
+    conv.SetSpatialTileBudget(budget);
+  };
+  pass = pass && RunAndCheckConv<T>(params, tiled);
+  pass = pass && RunAndCheckConv<T>(params, [&](tiny::CpuConv<T>& conv) {
+           conv.SetAlgorithm(tiny::Conv2dAlgorithm::kIm2col);
+           conv.SetSpatialTileBudget(budget);
+         });
+  pass = pass && RunAndCheckConv<T>(strided, tiled);
+  pass = pass && RunAndCheckNHWCConv<T>(params, tiled);
+  pass = pass && RunAndCheckNHWCConv<T>(strided, tiled);
+
+  tiny::Conv2dEpilogue epilogue = MakeTestConvEpilogue(params.output_c);
+  for (bool fold : {false, true}) {
+    epilogue.fold_batch_norm = fold;
+    pass = pass && RunAndCheckConvEpilogue<T>(params, epilogue, tiled);
+  }
+
+  // The tiles follow a new weight, and share one packed weight per weight
+  // buffer.
+  tiny::ClearConv2dWeightCache();
+  auto input = std::make_shared<tiny::Buffer<T>>(params.GetInputSize(), 123);
+  auto weight0 =
+      std::make_shared<tiny::Buffer<T>>(params.GetWeightSize(), 456);
+  auto weight1 =
+      std::make_shared<tiny::Buffer<T>>(params.GetWeightSize(), 789);
+  auto output_reference =
+      std::make_shared<tiny::Buffer<T>>(params.GetOutputSize());
+  auto output = std::make_shared<tiny::Buffer<T>>(params.GetOutputSize());
+  tiny::CpuConv<T> conv(params);
+  conv.SetSpatialTileBudget(budget);
+  conv.SetBuffers(input, weight0, output);
+  conv.Run();
+  conv.SetBuffers(input, weight1, output);
+  conv.Run();
+  RunReferenceConv<T>(params, input, weight1, output_reference);
+  pass = pass && IsErrorLargerThanThreshold<T>(
+                     output_reference, output, params.GetOutputWidth(),
+                     params.GetOutputSize() / params.GetOutputWidth());
+  pass = pass && tiny::GetConv2dWeightCacheSize() == 2;
+
+  if (pass) {
+    log_green("-- PASS: {} --", __FUNCTION__);
+  } else {
+    log_error("-- FAIL: {} --", __FUNCTION__);
+  }
+}
+
+template <typename T>
+void TestMulticastAdvanced() {
+  tt::tt_metal::Device* device = tt::tt_metal::CreateDevice(0);
+  tiny::MulticastAdvanced<T> multicast_advanced(device);
+  auto core_grid = device->compute_with_storage_grid_size();
+  uint32_t num_cores = core_grid.x * core_grid.y;
+
+  const uint32_t number_of_input_elems =
+      num_cores * tiny::TileWidth() * tiny::TileHeight();
+  auto input = std::make_shared<tiny::Buffer<T>>(number_of_input_elems, 1234);
+  auto output =
+      std::make_shared<tiny::Buffer<T>>(num_cores * number_of_input_elems);
+
+  multicast_advanced.SetBuffers(input, output);
+  multicast_advanced.Run();
+
+  bool pass = tt::tt_metal::CloseDevice(device);
+
+  auto& input_vec = input->GetVector();
+  auto& output_vec = output->GetVector();
+  const uint32_t number_of_elems_in_tile =
+      tiny::TileWidth() * tiny::TileHeight();
+  for (uint32_t i = 0; i < num_cores; ++i) {
+    for (uint32_t j = 0; j < number_of_input_elems; ++j) {
+      if (input_vec[j] != output_vec[i * number_of_input_elems + j]) {
+        std::cout << i << ", " << j << ": " << input_vec[j] << ", "
+                  << output_vec[i * number_of_input_elems + j] << std::endl;
+        pass = false;
+        break;
+      }
+    }
+  }
+  if (pass) {
+    log_green("-- PASS: {} --", __FUNCTION__);
+  } else {
+    log_error("-- FAIL: {} --", __FUNCTION__);
+  }
+}
+
+} /* namespace */
+
+int main(int argc, const char* argv[]) {
+  try {
+    TestSingleTileLoopback<float>();
+  } catch (const std::exception& e) {
+    log_error("TestSingleTileLoopback::Run() failed with exception!");
+    log_error("{}", e.what());
+    throw;
+  }
+
+  try {
+    TestSingleTileMatrixMultiplication<float>();
+    TestSingleTileMatrixMultiplication<bfloat16>();
+  } catch (const std::exception& e) {
+    log_error("SingleTileMatrixMultiplication::Run() failed with exception!");
+    log_error("{}", e.what());
+    throw;
+  }
+
+  try {
+    TestSingleTileLoopbackFourCores<float>();
+  } catch (const std::exception& e) {
+    log_error("TestSingleTileLoopbackFourCores::Run() failed with exception!");
+    log_error("{}", e.what());
+    throw;
+  }
+
+  try {
+    TestSimpleMulticast<float>();
+    TestSimpleMulticast<bfloat16>();
+  } catch (const std::exception& e) {
+    log_error("TestSimpleMulticast::Run() for float failed with exception!");
+    log_error("{}", e.what());
+    throw;
+  }
+
+  try {
+    TestMulticastAdvanced<float>();
+  } catch (const std::exception& e) {
+    log_error("TestSimpleMulticast::Run() for float failed with exception!");
+    log_error("{}", e.what());
+    throw;
+  }
+
+  try {
+    TestMulticastMatrixMultiplication<float>();
+    TestMulticastMatrixMultiplication<bfloat16>();
+  } catch (const std::exception& e) {
+    log_error(
+        "TestMulticastMatrixMultiplication::Run() failed with exception!");
+    log_error("{}", e.what());
+    throw;
+  }
+
+  try {
+    TestBatchedMatrixMultiplication<float>(/* bcast_batch = */ false);
+    TestBatchedMatrixMultiplication<float>(/* bcast_batch = */ true);
+    TestBatchedMatrixMultiplication<bfloat16>(/* bcast_batch = */ false);
+  } catch (const std::exception& e) {
+    log_error("TestBatchedMatrixMultiplication::Run() failed with exception!");
+    log_error("{}", e.what());
+    throw;
+  }
+
+  try {
+    // (m, k, n) for each shape class: square, GEMV with a row output, GEMV
+    // with a column output, outer product, tall-skinny and short-wide.
+    const uint32_t shapes[][3] = {{99, 65, 293}, {1, 300, 2100},
+                                  {300, 77, 1},  {300, 32, 1100},
+                                  {700, 64, 24}, {16, 48, 600}};
+    for (const auto& shape : shapes) {
+      for (uint32_t trans = 0; trans < 4; ++trans) {
+        TestGemm<float>(shape[0], shape[1], shape[2], trans & 1, trans & 2);
+      }
+    }
+    TestGemm<bfloat16>(1, 300, 2100, false, false);
+    TestGemm<bfloat16>(300, 32, 1100, false, false);
+  } catch (const std::exception& e) {
+    log_error("TestGemm::Run() failed with exception!");
+    log_error("{}", e.what());
+    throw;
+  }
+
+  try {
+    TestMatrixMultiplicationEpilogue<float>();
+    TestMatrixMultiplicationEpilogue<bfloat16>();
+  } catch (const std::exception& e) {
+    log_error("TestMatrixMultiplicationEpilogue::Run() failed with exception!");
+    log_error("{}", e.what());
+    throw;
+  }
+
+  try {
+    TestOutOfCoreMatrixMultiplication<float>();
+    TestOutOfCoreMatrixMultiplication<bfloat16>();
+  } catch (const std::exception& e) {
+    log_error(
+        "TestOutOfCoreMatrixMultiplication::Run() failed with exception!");
+    log_error("{}", e.what());
+    throw;
+  }
+
+  try {
+    TestDeterministicReduction<float>(77, 1500, 130, false);
+    TestDeterministicReduction<float>(1, 3000, 700, true);
+    TestDeterministicReduction<float>(1, 3000, 700, false);
+    TestDeterministicReduction<float>(500, 1000, 1, false);
+    TestDeterministicReduction<bfloat16>(65, 600, 33, true);
+  } catch (const std::exception& e) {
+    log_error("TestDeterministicReduction::Run() failed with exception!");
+    log_error("{}", e.what());
+    throw;
+  }
+
+  try {
+    TestAutotuneCache();
+  } catch (const std::exception& e) {
+    log_error("TestAutotuneCache::Run() failed with exception!");
+    log_error("{}", e.what());
+    throw;
+  }
+
+  try {
+    TestSplitKMatrixMultiplication<float>(32, 5000, 48, 7);
+    TestSplitKMatrixMultiplication<float>(1, 3000, 100, 3);
+    TestSplitKMatrixMultiplication<bfloat16>(40, 1500, 20, 5);
+  } catch (const std::exception& e) {
+    log_error("TestSplitKMatrixMultiplication::Run() failed with exception!");
+    log_error("{}", e.what());
+    throw;
+  }
+
+  try {
+    TestTiledMatrixMultiplication<float>(tiny::TileOrder::kMorton,
+                                         tiny::TileOrder::kMorton,
+                                         tiny::TileOrder::kMorton);
+    TestTiledMatrixMultiplication<float>(tiny::TileOrder::kRowMajor,
+                                         tiny::TileOrder::kMorton,
+                                         tiny::TileOrder::kRowMajor);
+    TestTiledMatrixMultiplication<bfloat16>(tiny::TileOrder::kMorton,
+                                            tiny::TileOrder::kRowMajor,
+                                            tiny::TileOrder::kMorton);
+  } catch (const std::exception& e) {
+    log_error("TestTiledMatrixMultiplication::Run() failed with exception!");
+    log_error("{}", e.what());
+    throw;
+  }
+
+  try {
+    TestBfp8MatrixMultiplication<float>();
+    TestBfp8MatrixMultiplication<bfloat16>();
+  } catch (const std::exception& e) {
+    log_error("TestBfp8MatrixMultiplication::Run() failed with exception!");
+    log_error("{}", e.what());
+    throw;
+  }
+
+  try {
+    TestIncrementalMatrixMultiplication<float>();
+    TestIncrementalMatrixMultiplication<bfloat16>();
+  } catch (const std::exception& e) {
+    log_error(
+        "TestIncrementalMatrixMultiplication::Run() failed with exception!");
+    log_error("{}", e.what());
+    throw;
+  }
+
+  try {
+    TestFreivaldsVerification<float>();
+    TestFreivaldsVerification<bfloat16>();
+  } catch (const std::exception& e) {
+    log_error("TestFreivaldsVerification::Run() failed with exception!");
+    log_error("{}", e.what());
+    throw;
+  }
+
+  try {
+    TestChecksumVerification<float>();
+    TestChecksumVerification<bfloat16>();
+  } catch (const std::exception& e) {
+    log_error("TestChecksumVerification::Run() failed with exception!");
+    log_error("{}", e.what());
+    throw;
+  }
+
+  try {
+    TestInt8MatrixMultiplication();
+  } catch (const std::exception& e) {
+    log_error("TestInt8MatrixMultiplication::Run() failed with exception!");
+    log_error("{}", e.what());
+    throw;
+  }
+
+  try {
+    TestBlockSparseMatrixMultiplication<float>();
+    TestBlockSparseMatrixMultiplication<bfloat16>();
+  } catch (const std::exception& e) {
+    log_error(
+        "TestBlockSparseMatrixMultiplication::Run() failed with exception!");
+    log_error("{}", e.what());
+    throw;
+  }
+
+  try {
+    TestConv<float>();
+    TestConv<bfloat16>();
+  } catch (const std::exception& e) {
+    log_error("TestConv::Run() failed with exception!");
+    log_error("{}", e.what());
+    throw;
+  }
+
+  try {
+    TestIm2colConv<float>();
+    TestIm2colConv<bfloat16>();
+  } catch (const std::exception& e) {
+    log_error("TestIm2colConv::Run() failed with exception!");
+    log_error("{}", e.what());
+    throw;
+  }
+
+  try {
+    TestWinogradConv<float>();
+    TestWinogradConv<bfloat16>();
+  } catch (const std::exception& e) {
+    log_error("TestWinogradConv::Run() failed with exception!");
+    log_error("{}", e.what());
+    throw;
+  }
+
+  try {
+    TestNHWCConv<float>();
+    TestNHWCConv<bfloat16>();
+  } catch (const std::exception& e) {
+    log_error("TestNHWCConv::Run() failed with exception!");
+    log_error("{}", e.what());
+    throw;
+  }
+
+  try {
+    TestConvPartition<float>();
+    TestConvPartition<bfloat16>();
+  } catch (const std::exception& e) {
+    log_error("TestConvPartition::Run() failed with exception!");
+    log_error("{}", e.what());
+    throw;
+  }
+
+  try {
+    TestBatchedConv<float>();
+    TestBatchedConv<bfloat16>();
+  } catch (const std::exception& e) {
+    log_error("TestBatchedConv::Run() failed with exception!");
+    log_error("{}", e.what());
+    throw;
+  }
+
+  try {
+    TestConvEpilogue<float>();
+    TestConvEpilogue<bfloat16>();
+  } catch (const std::exception& e) {
+    log_error("TestConvEpilogue::Run() failed with exception!");
+    log_error("{}", e.what());
+    throw;
+  }
+
+  try {
+    TestGroupedConv<float>();
+    TestGroupedConv<bfloat16>();
+  } catch (const std::exception& e) {
+    log_error("TestGroupedConv::Run() failed with exception!");
+    log_error("{}", e.what());
+    throw;
+  }
+
+  try {
+    TestConvWeightCache<float>();
+    TestConvWeightCache<bfloat16>();
+  } catch (const std::exception& e) {
+    log_error("TestConvWeightCache::Run() failed with exception!");
+    log_error("{}", e.what());
+    throw;
+  }
+
+  try {
+    TestConvSpatialTiling<float>();
+    TestConvSpatialTiling<bfloat16>();
+  } catch (const std::exception& e) {
+    log_error("TestConvSpatialTiling::Run() failed with exception!");
+    log_error("{}", e.what());
+    throw;
   }
 
-#if 0  // WIP
-  TestConv<float>();
-#endif
   return 0;
 }
@@ -0,0 +1,171 @@
+// Copyright (c) 2024 Jaebaek Seo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "matmul_bfp8_cpu.h"
+
+#include <bit>
+#include <cmath>
+
+#include "epilogue.h"
+#include "parallel.h"
+#include "tt_metal/common/bfloat16.hpp"
+#include "utils.h"
+
+namespace {
+
+/*
+ * Output block of a work item and the depth of the K panel of the weights
+ * that is decoded at once. The decoded panel (kBfp8PanelDepthCPU by
+ * kBfp8BlockWidthCPU floats) stays in L2.
+ */
+static constexpr uint32_t kBfp8BlockHeightCPU = 64;
+static constexpr uint32_t kBfp8BlockWidthCPU = 64;
+static constexpr uint32_t kBfp8PanelDepthCPU = 256;
+
+/* Number of explicit mantissa bits below the leading one. */
+static constexpr int kBfp8MantissaBits = 6;
+
+/* Biased exponent of |value| as float (and bfloat16). */
+inline uint32_t GetBiasedExponent(float value) {
+  return (std::bit_cast<uint32_t>(value) >> 23) & 0xff;
+}
+
+} /* namespace */
+
+namespace tiny {
+
+template <typename T>
+Bfp8Matrix::Bfp8Matrix(std::shared_ptr<Buffer<T>> dense, uint32_t width,
+                       uint32_t height)
+    : width_(width), height_(height) {
+  auto& dense_vec = dense->GetVector();
+  assert(dense_vec.size() == width * height);
+  assert(!dense->IsTilized());
+
+  for (int e = 0; e < 256; ++e) {
+    scales_[e] = std::ldexp(1.0f, e - 127 - kBfp8MantissaBits);
+  }
+
+  const uint32_t blocks_per_row = GetBlocksPerRow();
+  exponents_.resize(static_cast<size_t>(height) * blocks_per_row);
+  mantissas_.resize(exponents_.size() * kBlockSize, 0);
+  for (uint32_t i = 0; i < height; ++i) {
+    for (uint32_t block = 0; block < blocks_per_row; ++block) {
+      const uint32_t col0 = block * kBlockSize;
+      const uint32_t cols = std::min(kBlockSize, width - col0);
+      const T* src = dense_vec.data() + static_cast<size_t>(i) * width + col0;
+
+      uint32_t exponent = 0;
+      for (uint32_t j = 0; j < cols; ++j) {
+        exponent = std::max(exponent, GetBiasedExponent(ToFloat<T>(src[j])));
+      }
+
+      const size_t index = static_cast<size_t>(i) * blocks_per_row + block;
+      exponents_[index] = exponent;
+      if (exponent == 0) continue;
+
+      // Round to the nearest magnitude. The largest element can round up to
+      // 128, which is saturated.
+      int8_t* mantissas = mantissas_.data() + index * kBlockSize;
+      for (uint32_t j = 0; j < cols; ++j) {
+        float magnitude =
+            std::nearbyint(std::fabs(ToFloat<T>(src[j])) / scales_[exponent]);
+        magnitude = std::min(magnitude, 127.0f);
+        mantissas[j] = static_cast<int8_t>(
+            std::signbit(ToFloat<T>(src[j])) ? -magnitude : magnitude);
+      }
+    }
+  }
+}
+
+template <typename T>
+void Bfp8Matrix::ToDense(std::shared_ptr<Buffer<T>> dense) const {
+  auto& dense_vec = dense->GetVector();
+  assert(dense_vec.size() == width_ * height_);
+
+  std::vector<float> row(width_);
+  for (uint32_t i = 0; i < height_; ++i) {
+    DecodeRow(i, 0, width_, row.data());
+    for (uint32_t j = 0; j < width_; ++j) {
+      dense_vec[static_cast<size_t>(i) * width_ + j] = FromFloat<T>(row[j]);
+    }
+  }
+}
+
+template Bfp8Matrix::Bfp8Matrix(std::shared_ptr<Buffer<float>>, uint32_t,
+                                uint32_t);
+template Bfp8Matrix::Bfp8Matrix(std::shared_ptr<Buffer<bfloat16>>, uint32_t,
+                                uint32_t);
+template void Bfp8Matrix::ToDense(std::shared_ptr<Buffer<float>>) const;
+template void Bfp8Matrix::ToDense(std::shared_ptr<Buffer<bfloat16>>) const;
+
+template <typename T>
+Result CPUBfp8MatrixMultiplication<T>::Run() {
+  assert(!input0_->IsTilized());
+
+  const T* a = input0_->GetVector().data();
+  T* c = output_->GetVector().data();
+  const Bfp8Matrix& b = *input1_;
+  const Epilogue* epilogue = epilogue_.get();
+
+  const uint32_t row_blocks =
+      (m_ + kBfp8BlockHeightCPU - 1) / kBfp8BlockHeightCPU;
+  const uint32_t col_blocks =
+      (n_ + kBfp8BlockWidthCPU - 1) / kBfp8BlockWidthCPU;
+
+  ParallelFor(row_blocks * col_blocks, [&](uint32_t item) {
+    const uint32_t row0 = item / col_blocks * kBfp8BlockHeightCPU;
+    const uint32_t col0 = item % col_blocks * kBfp8BlockWidthCPU;
+    const uint32_t rows = std::min(kBfp8BlockHeightCPU, m_ - row0);
+    const uint32_t cols = std::min(kBfp8BlockWidthCPU, n_ - col0);
+
+    thread_local std::vector<float> panel;
+    thread_local std::vector<float> acc;
+    panel.resize(kBfp8PanelDepthCPU * kBfp8BlockWidthCPU);
+    acc.assign(kBfp8BlockHeightCPU * kBfp8BlockWidthCPU, 0.0f);
+
+    for (uint32_t k0 = 0; k0 < k_; k0 += kBfp8PanelDepthCPU) {
+      const uint32_t depth = std::min(kBfp8PanelDepthCPU, k_ - k0);
+
+      // Packing step: decode the panel of the weights.
+      for (uint32_t kk = 0; kk < depth; ++kk) {
+        b.DecodeRow(k0 + kk, col0, cols, panel.data() + kk * cols);
+      }
+
+      for (uint32_t i = 0; i < rows; ++i) {
+        const T* a_row = a + static_cast<size_t>(row0 + i) * k_ + k0;
+        float* acc_row = acc.data() + i * cols;
+        for (uint32_t kk = 0; kk < depth; ++kk) {
+          const float a_value = ToFloat<T>(a_row[kk]);
+          const float* panel_row = panel.data() + kk * cols;
+          for (uint32_t j = 0; j < cols; ++j) {
+            acc_row[j] += MultiplyAsFloat<T>(a_value, panel_row[j]);
+          }
+        }
+      }
+    }
+
+    for (uint32_t i = 0; i < rows; ++i) {
+      StoreTileRow<T>(epilogue, row0 + i, col0, acc.data() + i * cols, cols,
+                      c + static_cast<size_t>(row0 + i) * n_ + col0);
+    }
+  });
+
+  return Result::kSuccess;
+}
+
+template class CPUBfp8MatrixMultiplication<float>;
+template class CPUBfp8MatrixMultiplication<bfloat16>;
+
+} /* namespace tiny */
@@ -0,0 +1,144 @@
+// Copyright (c) 2024 Jaebaek Seo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef matmul_bfp8_cpu_h_
+#define matmul_bfp8_cpu_h_
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "blas_op.h"
+#include "buffer.h"
+
+namespace tiny {
+
+/*
+ * |height| by |width| matrix in block floating point with 8 bits per element,
+ * like Tenstorrent's Bfp8_b (tt::DataFormat::Bfp8_b).
+ *
+ * Each row is split into blocks of kBlockSize elements that share an 8-bit
+ * exponent, which is the largest bfloat16 (biased) exponent E in the block.
+ * Each element has a sign bit and a 7-bit magnitude whose top bit is the
+ * (explicit) leading one of the largest element, so an element is
+ *
+ *   (-1)^sign * magnitude * 2^(E - 127 - 6).
+ *
+ * Smaller elements in the block lose their low bits. The last block of a
+ * row is padded with zeros when |width| is not a multiple of kBlockSize. It
+ * takes about a quarter of the memory of float.
+ */
+class Bfp8Matrix {
+ public:
+  static constexpr uint32_t kBlockSize = 16;
+
+  /* Encodes a row-major |height| by |width| matrix. */
+  template <typename T>
+  Bfp8Matrix(std::shared_ptr<Buffer<T>> dense, uint32_t width,
+             uint32_t height);
+
+  /* Decodes |count| elements from element (|row|, |col|) to |values|. */
+  void DecodeRow(uint32_t row, uint32_t col, uint32_t count,
+                 float* values) const {
+    assert(row < height_ && col + count <= width_);
+    const uint32_t blocks_per_row = GetBlocksPerRow();
+    const size_t row_offset = static_cast<size_t>(row) * blocks_per_row;
+    for (uint32_t j = 0; j < count;) {
+      const uint32_t block = (col + j) / kBlockSize;
+      const uint32_t end = std::min(count, (block + 1) * kBlockSize - col);
+      const float scale = scales_[exponents_[row_offset + block]];
+      const int8_t* mantissas =
+          mantissas_.data() + (row_offset + block) * kBlockSize;
+      for (; j < end; ++j) {
+        values[j] = mantissas[(col + j) % kBlockSize] * scale;
+      }
+    }
+  }
+
+  /* Decodes the whole matrix to |dense|. */
+  template <typename T>
+  void ToDense(std::shared_ptr<Buffer<T>> dense) const;
+
+  uint32_t GetWidth() const { return width_; }
+  uint32_t GetHeight() const { return height_; }
+
+  size_t GetSizeInBytes() const {
+    return exponents_.size() + mantissas_.size();
+  }
+
+ private:
+  uint32_t GetBlocksPerRow() const {
+    return (width_ + kBlockSize - 1) / kBlockSize;
+  }
+
+  uint32_t width_;
+  uint32_t height_;
+
+  /* Shared exponent of each block. */
+  std::vector<uint8_t> exponents_;
+
+  /*
+   * Elements of each block. The sign and magnitude are kept as an int8_t in
+   * [-127, 127], which decodes with a single multiplication.
+   */
+  std::vector<int8_t> mantissas_;
+
+  /* 2^(E - 127 - 6) for every exponent E. */
+  float scales_[256];
+};
+
+/*
+ * Multiplication between |m| by |k| matrix and |k| by |n| Bfp8Matrix (e.g.,
+ * weights) on host threads. The weights are decoded to float inside the
+ * packing step: each work item decodes a K panel of its column block at a
+ * time into a small thread-local buffer and multiplies it right away, so a
+ * full-precision copy of the weights never exists. Accumulation is done in
+ * float.
+ */
+template <typename T>
+class CPUBfp8MatrixMultiplication : BLASOp {
+ public:
+  CPUBfp8MatrixMultiplication(uint32_t m, uint32_t k, uint32_t n)
+      : m_(m), k_(k), n_(n) {}
+
+  Result Run();
+
+  using BLASOp::SetEpilogue;
+
+  void SetBuffers(std::shared_ptr<Buffer<T>> input0,
+                  std::shared_ptr<const Bfp8Matrix> input1,
+                  std::shared_ptr<Buffer<T>> output) {
+    assert(input0->GetNumberOfElements() == m_ * k_);
+    assert(input1->GetHeight() == k_ && input1->GetWidth() == n_);
+    assert(output->GetNumberOfElements() == m_ * n_);
+
+    input0_ = input0;
+    input1_ = input1;
+    output_ = output;
+  }
+
+ private:
+  uint32_t m_;
+  uint32_t k_;
+  uint32_t n_;
+  std::shared_ptr<Buffer<T>> input0_;
+  std::shared_ptr<const Bfp8Matrix> input1_;
+  std::shared_ptr<Buffer<T>> output_;
+};
+
+} /* namespace tiny */
+
+#endif /* ifndef matmul_bfp8_cpu_h_ */
@@ -0,0 +1,188 @@
+// Copyright (c) 2024 Jaebaek Seo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "matmul_block_sparse_cpu.h"
+
+#include <algorithm>
+
+#include "epilogue.h"
+#include "parallel.h"
+#include "tt_metal/common/bfloat16.hpp"
+
+namespace {
+
+/* Number of rows of the first input handled by a single work item. */
+static constexpr uint32_t kBlockHeightBlockSparseCPU = 16;
+
+/*
+ * Multiplies rows [|row|, |row| + |rows|) of |a| with the block-sparse |b|.
+ * Each non-zero tile of |b| is converted to float once and reused for all
+ * the rows, and the inner loop runs over a contiguous row of the tile.
+ */
+template <typename T>
+void BlockSparseRowBlock(const T* a, const tiny::BlockSparseMatrix<T>& b,
+                         T* c, uint32_t k, uint32_t n, uint32_t row,
+                         uint32_t rows, const tiny::Epilogue* epilogue) {
+  const uint32_t tile_w = tiny::TileWidth();
+  const uint32_t tile_h = tiny::TileHeight();
+  const uint32_t padded_n = b.GetNumberOfTileColumns() * tile_w;
+
+  thread_local std::vector<float> a_block;
+  thread_local std::vector<float> acc;
+  thread_local std::vector<float> tile;
+  a_block.resize(static_cast<size_t>(rows) * k);
+  acc.assign(static_cast<size_t>(rows) * padded_n, 0.0f);
+  tile.resize(tile_w * tile_h);
+
+  for (uint32_t r = 0; r < rows; ++r) {
+    const T* a_row = a + static_cast<size_t>(row + r) * k;
+    for (uint32_t kk = 0; kk < k; ++kk) {
+      a_block[r * k + kk] = tiny::ToFloat<T>(a_row[kk]);
+    }
+  }
+
+  const auto& row_offsets = b.GetRowOffsets();
+  const auto& column_indices = b.GetColumnIndices();
+  for (uint32_t tile_row = 0; tile_row < b.GetNumberOfTileRows();
+       ++tile_row) {
+    const uint32_t k0 = tile_row * tile_h;
+    const uint32_t depth = std::min(tile_h, k - k0);
+    for (uint32_t i = row_offsets[tile_row]; i < row_offsets[tile_row + 1];
+         ++i) {
+      const T* src = b.GetTile(i);
+      for (uint32_t j = 0; j < tile_w * tile_h; ++j) {
+        tile[j] = tiny::ToFloat<T>(src[j]);
+      }
+
+      const uint32_t col0 = column_indices[i] * tile_w;
+      for (uint32_t r = 0; r < rows; ++r) {
+        const float* a_row = a_block.data() + r * k + k0;
+        float* acc_row = acc.data() + static_cast<size_t>(r) * padded_n + col0;
+        for (uint32_t kk = 0; kk < depth; ++kk) {
+          const float a_value = a_row[kk];
+          const float* tile_row_values = tile.data() + kk * tile_w;
+          for (uint32_t j = 0; j < tile_w; ++j) {
+            acc_row[j] +=
+                tiny::MultiplyAsFloat<T>(a_value, tile_row_values[j]);
+          }
+        }
+      }
+    }
+  }
+
+  for (uint32_t r = 0; r < rows; ++r) {
+    tiny::StoreTileRow<T>(epilogue, row + r, 0,
+                          acc.data() + static_cast<size_t>(r) * padded_n, n,
+                          c + static_cast<size_t>(row + r) * n);
+  }
+}
+
+} /* namespace */
+
+namespace tiny {
+
+template <typename T>
+BlockSparseMatrix<T>::BlockSparseMatrix(std::shared_ptr<Buffer<T>> dense,
+                                        uint32_t width, uint32_t height)
+    : width_(width), height_(height) {
+  auto& dense_vec = dense->GetVector();
+  assert(dense_vec.size() == width * height);
+  assert(!dense->IsTilized());
+
+  const uint32_t tile_w = TileWidth();
+  const uint32_t tile_h = TileHeight();
+  const uint32_t tile_rows = (height + tile_h - 1) / tile_h;
+  const uint32_t tile_cols = GetNumberOfTileColumns();
+
+  row_offsets_.reserve(tile_rows + 1);
+  row_offsets_.push_back(0);
+  for (uint32_t tile_row = 0; tile_row < tile_rows; ++tile_row) {
+    const uint32_t row0 = tile_row * tile_h;
+    const uint32_t rows = std::min(tile_h, height - row0);
+    for (uint32_t tile_col = 0; tile_col < tile_cols; ++tile_col) {
+      const uint32_t col0 = tile_col * tile_w;
+      const uint32_t cols = std::min(tile_w, width - col0);
+
+      bool all_zeros = true;
+      for (uint32_t r = 0; r < rows && all_zeros; ++r) {
+        const T* src = dense_vec.data() + (row0 + r) * width + col0;
+        for (uint32_t c = 0; c < cols; ++c) {
+          if (ToFloat<T>(src[c]) != 0.0f) {
+            all_zeros = false;
+            break;
+          }
+        }
+      }
+      if (all_zeros) continue;
+
+      column_indices_.push_back(tile_col);
+      size_t offset = tiles_.size();
+      tiles_.resize(offset + tile_w * tile_h, FromFloat<T>(0.0f));
+      for (uint32_t r = 0; r < rows; ++r) {
+        std::copy_n(dense_vec.data() + (row0 + r) * width + col0, cols,
+                    tiles_.data() + offset + r * tile_w);
+      }
+    }
+    row_offsets_.push_back(column_indices_.size());
+  }
+}
+
+template <typename T>
+void BlockSparseMatrix<T>::ToDense(std::shared_ptr<Buffer<T>> dense) const {
+  auto& dense_vec = dense->GetVector();
+  assert(dense_vec.size() == width_ * height_);
+  std::fill(dense_vec.begin(), dense_vec.end(), FromFloat<T>(0.0f));
+
+  const uint32_t tile_w = TileWidth();
+  const uint32_t tile_h = TileHeight();
+  for (uint32_t tile_row = 0; tile_row < GetNumberOfTileRows(); ++tile_row) {
+    const uint32_t row0 = tile_row * tile_h;
+    const uint32_t rows = std::min(tile_h, height_ - row0);
+    for (uint32_t i = row_offsets_[tile_row]; i < row_offsets_[tile_row + 1];
+         ++i) {
+      const uint32_t col0 = column_indices_[i] * tile_w;
+      const uint32_t cols = std::min(tile_w, width_ - col0);
+      for (uint32_t r = 0; r < rows; ++r) {
+        std::copy_n(GetTile(i) + r * tile_w, cols,
+                    dense_vec.data() + (row0 + r) * width_ + col0);
+      }
+    }
+  }
+}
+
+template <typename T>
+Result CPUBlockSparseMatrixMultiplication<T>::Run() {
+  assert(!input0_->IsTilized());
+
+  const T* a = input0_->GetVector().data();
+  T* c = output_->GetVector().data();
+  const uint32_t row_blocks =
+      (m_ + kBlockHeightBlockSparseCPU - 1) / kBlockHeightBlockSparseCPU;
+
+  ParallelFor(row_blocks, [&](uint32_t block) {
+    const uint32_t row = block * kBlockHeightBlockSparseCPU;
+    BlockSparseRowBlock<T>(a, *input1_, c, k_, n_, row,
+                           std::min(kBlockHeightBlockSparseCPU, m_ - row),
+                           epilogue_.get());
+  });
+
+  return Result::kSuccess;
+}
+
+template class BlockSparseMatrix<float>;
+template class BlockSparseMatrix<bfloat16>;
+template class CPUBlockSparseMatrixMultiplication<float>;
+template class CPUBlockSparseMatrixMultiplication<bfloat16>;
+
+} /* namespace tiny */
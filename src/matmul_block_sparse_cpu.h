@@ -0,0 +1,125 @@
+// Copyright (c) 2024 Jaebaek Seo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef matmul_block_sparse_cpu_h_
+#define matmul_block_sparse_cpu_h_
+
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "blas_op.h"
+#include "buffer.h"
+#include "utils.h"
+
+namespace tiny {
+
+/*
+ * |height| by |width| matrix stored as CSR over TileHeight() by TileWidth()
+ * tiles (block compressed sparse row). Only tiles with at least one non-zero
+ * element are stored.
+ *
+ * For tile row r, the column indices (in tiles) of its non-zero tiles are
+ * |column_indices_[row_offsets_[r]]| ... |column_indices_[row_offsets_[r + 1]
+ * - 1]| in increasing order, and the elements of the i-th non-zero tile are
+ * stored row by row in |tiles_| from i * TileWidth() * TileHeight(). Tiles on
+ * the right and bottom edges are padded with zeros when |width| or |height|
+ * is not a multiple of the tile size.
+ */
+template <typename T>
+class BlockSparseMatrix {
+ public:
+  /*
+   * Converts a dense row-major |height| by |width| matrix. Tiles whose
+   * elements are all zeros are dropped.
+   */
+  BlockSparseMatrix(std::shared_ptr<Buffer<T>> dense, uint32_t width,
+                    uint32_t height);
+
+  /* Writes the dense row-major form of the matrix to |dense|. */
+  void ToDense(std::shared_ptr<Buffer<T>> dense) const;
+
+  uint32_t GetWidth() const { return width_; }
+  uint32_t GetHeight() const { return height_; }
+
+  uint32_t GetNumberOfTileRows() const { return row_offsets_.size() - 1; }
+  uint32_t GetNumberOfTileColumns() const {
+    return (width_ + TileWidth() - 1) / TileWidth();
+  }
+  uint32_t GetNumberOfNonZeroTiles() const { return column_indices_.size(); }
+
+  /* Fraction of the tiles that are stored. */
+  float GetDensity() const {
+    return static_cast<float>(GetNumberOfNonZeroTiles()) /
+           (GetNumberOfTileRows() * GetNumberOfTileColumns());
+  }
+
+  const std::vector<uint32_t>& GetRowOffsets() const { return row_offsets_; }
+  const std::vector<uint32_t>& GetColumnIndices() const {
+    return column_indices_;
+  }
+  const T* GetTile(uint32_t index) const {
+    return tiles_.data() +
+           static_cast<size_t>(index) * TileWidth() * TileHeight();
+  }
+
+ private:
+  uint32_t width_;
+  uint32_t height_;
+  std::vector<uint32_t> row_offsets_;
+  std::vector<uint32_t> column_indices_;
+  std::vector<T> tiles_;
+};
+
+/*
+ * Multiplication between dense |m| by |k| matrix and block-sparse |k| by |n|
+ * matrix (e.g., pruned weights) on host threads. Only the non-zero tiles of
+ * the second input are visited, so the work is proportional to its density
+ * instead of |m| * |k| * |n|. Accumulation is done in float.
+ */
+template <typename T>
+class CPUBlockSparseMatrixMultiplication : BLASOp {
+ public:
+  CPUBlockSparseMatrixMultiplication(uint32_t m, uint32_t k, uint32_t n)
+      : m_(m), k_(k), n_(n) {}
+
+  Result Run();
+
+  using BLASOp::SetEpilogue;
+
+  void SetBuffers(std::shared_ptr<Buffer<T>> input0,
+                  std::shared_ptr<const BlockSparseMatrix<T>> input1,
+                  std::shared_ptr<Buffer<T>> output) {
+    assert(input0->GetNumberOfElements() == m_ * k_);
+    assert(input1->GetHeight() == k_ && input1->GetWidth() == n_);
+    assert(output->GetNumberOfElements() == m_ * n_);
+
+    input0_ = input0;
+    input1_ = input1;
+    output_ = output;
+  }
+
+ private:
+  uint32_t m_;
+  uint32_t k_;
+  uint32_t n_;
+  std::shared_ptr<Buffer<T>> input0_;
+  std::shared_ptr<const BlockSparseMatrix<T>> input1_;
+  std::shared_ptr<Buffer<T>> output_;
+};
+
+} /* namespace tiny */
+
+#endif /* ifndef matmul_block_sparse_cpu_h_ */
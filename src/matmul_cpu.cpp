@@ -14,76 +14,529 @@
 
 #include "matmul_cpu.h"
 
+#include <algorithm>
 #include <cassert>
 #include <tuple>
 
+#include "autotune.h"
 #include "buffer.h"
+#include "epilogue.h"
+#include "parallel.h"
 #include "tt_metal/common/bfloat16.hpp"
+#include "utils.h"
 
 namespace {
 
+/*
+ * Default blocking of each shape class (see ClassifyGemmShape() and
+ * tiny::CPUGemmConfig). The register tile and the size of the output block
+ * that a single host thread computes at once.
+ */
 static constexpr uint32_t kTileWidthCPU = 8;
 static constexpr uint32_t kTileHeightCPU = 8;
 
+static constexpr uint32_t kBlockHeightCPU = 64;
+static constexpr uint32_t kBlockWidthCPU = 256;
+static constexpr uint32_t kOuterProductBlockHeightCPU = 32;
+static constexpr uint32_t kOuterProductBlockWidthCPU = 1024;
+static constexpr uint32_t kTallSkinnyBlockLengthCPU = 128;
+static constexpr uint32_t kGemvBlockHeightCPU = 256;
+static constexpr uint32_t kGemvBlockWidthCPU = 2048;
+
+/*
+ * Maximum block widths of OuterProductBlock() and GemvRowBlock(), which keep
+ * a row of the block in a local array.
+ */
+static constexpr uint32_t kMaxOuterProductBlockWidthCPU = 4096;
+static constexpr uint32_t kMaxGemvBlockWidthCPU = 8192;
+
+/* Maximum K of kOuterProduct and the short side of kTallSkinny. */
+static constexpr uint32_t kSmallDimensionCPU = 32;
+
+/*
+ * Sums |count| accumulators in |values| (initialized to zeros) over K with
+ * |accumulate(k_begin, k_end, partial)|, which adds the terms of
+ * [k_begin, k_end) to |partial|. In the deterministic reduction mode, K is
+ * summed chunk by chunk and the chunk sums are combined with
+ * tiny::PairwiseReduce() (see tiny::IsDeterministicReduction()), otherwise in
+ * a single sweep.
+ */
+template <typename F>
+inline void ReduceOverK(uint32_t k, float* values, uint32_t count,
+                        F&& accumulate) {
+  const uint32_t chunk = tiny::ReductionChunkSize();
+  if (k <= chunk || !tiny::IsDeterministicReduction()) {
+    accumulate(0, k, values);
+    return;
+  }
+
+  const uint32_t chunks = (k + chunk - 1) / chunk;
+  thread_local std::vector<float> partials;
+  partials.assign(static_cast<size_t>(chunks) * count, 0.0f);
+  for (uint32_t i = 0; i < chunks; ++i) {
+    accumulate(i * chunk, std::min(k, (i + 1) * chunk),
+               partials.data() + static_cast<size_t>(i) * count);
+  }
+  tiny::PairwiseReduce(partials.data(), chunks, count);
+  std::copy_n(partials.data(), count, values);
+}
+
+/*
+ * Applies the alpha/beta scaling and |epilogue| to |count| accumulators of
+ * the row that starts from |c_row| and stores them.
+ */
+template <typename T>
+inline void StoreRow(const tiny::GemmParams& p, float* values, uint32_t count,
+                     T* c_row, const tiny::Epilogue* epilogue, uint32_t row,
+                     uint32_t col) {
+  for (uint32_t j = 0; j < count; ++j) {
+    values[j] *= p.alpha;
+    if (p.beta != 0.0f) values[j] += p.beta * tiny::ToFloat<T>(c_row[j]);
+  }
+  tiny::StoreTileRow<T>(epilogue, row, col, values, count, c_row);
+}
+
+/*
+ * Returns the block of op(B) from column |col0| as rows of contiguous
+ * elements. When B is transposed, the block is packed into |packed_b|.
+ * |ldb_block| is set to the number of elements between two rows of the
+ * returned block.
+ */
+template <typename T>
+const T* GetRowMajorBlockOfB(const tiny::GemmParams& p, const T* b,
+                             uint32_t col0, uint32_t cols,
+                             std::vector<T>& packed_b, uint32_t& ldb_block) {
+  if (!p.trans_b) {
+    ldb_block = p.ldb;
+    return b + col0;
+  }
+  packed_b.resize(p.k * cols);
+  for (uint32_t j = 0; j < cols; ++j) {
+    const T* b_column = b + (col0 + j) * p.ldb;
+    for (uint32_t kk = 0; kk < p.k; ++kk) {
+      packed_b[kk * cols + j] = b_column[kk];
+    }
+  }
+  ldb_block = cols;
+  return packed_b.data();
+}
+
 /*
- * The following code shows the idea of "tiling".
+ * Signature of the kernels that compute |rows| by |cols| block of C whose
+ * left-top corner is (|row0|, |col0|). |epilogue_row0| is added to the row
+ * index seen by |epilogue|.
  */
 template <typename T>
-tiny::Result _Run(std::shared_ptr<tiny::Buffer<T>> input0,
-                  std::shared_ptr<tiny::Buffer<T>> input1,
-                  std::shared_ptr<tiny::Buffer<T>> output, uint32_t m_,
-                  uint32_t k_, uint32_t n_) {
-  auto& input_vec0 = input0->GetVector();
-  auto& input_vec1 = input1->GetVector();
-  auto& output_vec = output->GetVector();
-
-  for (uint32_t i = 0; i < m_; i += kTileHeightCPU) {
-    for (uint32_t j = 0; j < n_; j += kTileWidthCPU) {
-      for (uint32_t k = 0; k < k_; ++k) {
-        // Multiplication for a single tile.
-        for (uint32_t ti = i; ti < i + kTileHeightCPU; ++ti) {
-          for (uint32_t tj = j; tj < j + kTileWidthCPU; ++tj) {
-            uint32_t index0 = ti * k_ + k;
-            uint32_t index1 = k * n_ + tj;
-            output_vec[ti * n_ + tj] += input_vec0[index0] * input_vec1[index1];
-          }
-        }
+using BlockKernel = void (*)(const tiny::GemmParams& p, const T* a, const T* b,
+                             T* c, uint32_t row0, uint32_t rows, uint32_t col0,
+                             uint32_t cols, const tiny::Epilogue* epilogue,
+                             uint32_t epilogue_row0, std::vector<T>& packed_b);
+
+/*
+ * Kernel for kSquare and kTallSkinny shapes.
+ *
+ * The following code shows the idea of "tiling". Each kTileH by kTileW tile
+ * of the block is accumulated in a local float array to keep it in registers
+ * while sliding over K.
+ */
+template <typename T, uint32_t kTileH, uint32_t kTileW>
+void GemmBlock(const tiny::GemmParams& p, const T* a, const T* b, T* c,
+               uint32_t row0, uint32_t rows, uint32_t col0, uint32_t cols,
+               const tiny::Epilogue* epilogue, uint32_t epilogue_row0,
+               std::vector<T>& packed_b) {
+  // op(A)(i, kk) = a[i * a_row_stride + kk * a_col_stride]
+  const uint32_t a_row_stride = p.trans_a ? 1 : p.lda;
+  const uint32_t a_col_stride = p.trans_a ? p.lda : 1;
+
+  uint32_t ldb_block;
+  const T* b_block =
+      GetRowMajorBlockOfB<T>(p, b, col0, cols, packed_b, ldb_block);
+
+  for (uint32_t i = 0; i < rows; i += kTileH) {
+    const uint32_t tile_h = std::min(kTileH, rows - i);
+    const T* a_tile = a + (row0 + i) * a_row_stride;
+    for (uint32_t j = 0; j < cols; j += kTileW) {
+      const uint32_t tile_w = std::min(kTileW, cols - j);
+
+      float tile[kTileH][kTileW] = {};
+      ReduceOverK(p.k, &tile[0][0], kTileH * kTileW,
+                  [&](uint32_t k_begin, uint32_t k_end, float* partial) {
+                    float sum[kTileH][kTileW] = {};
+                    for (uint32_t kk = k_begin; kk < k_end; ++kk) {
+                      const T* b_row = b_block + kk * ldb_block + j;
+                      for (uint32_t ti = 0; ti < tile_h; ++ti) {
+                        const T a_value =
+                            a_tile[ti * a_row_stride + kk * a_col_stride];
+                        for (uint32_t tj = 0; tj < tile_w; ++tj) {
+                          sum[ti][tj] += tiny::Multiply<T>(a_value, b_row[tj]);
+                        }
+                      }
+                    }
+                    std::copy_n(&sum[0][0], kTileH * kTileW,
+                                partial);
+                  });
+
+      for (uint32_t ti = 0; ti < tile_h; ++ti) {
+        StoreRow<T>(p, tile[ti], tile_w,
+                    c + (row0 + i + ti) * p.ldc + col0 + j, epilogue,
+                    epilogue_row0 + row0 + i + ti, col0 + j);
+      }
+    }
+  }
+}
+
+/*
+ * Kernel for kOuterProduct shapes. With a small K, the register tile of
+ * GemmBlock() is stored after only a few multiplications. Instead, this
+ * kernel keeps the whole |k| by |cols| block of op(B) in cache and computes
+ * each output row as |k| scaled rows of op(B) (rank-k update), which the
+ * compiler vectorizes over the full row.
+ */
+template <typename T>
+void OuterProductBlock(const tiny::GemmParams& p, const T* a, const T* b,
+                       T* c, uint32_t row0, uint32_t rows, uint32_t col0,
+                       uint32_t cols, const tiny::Epilogue* epilogue,
+                       uint32_t epilogue_row0, std::vector<T>& packed_b) {
+  const uint32_t a_row_stride = p.trans_a ? 1 : p.lda;
+  const uint32_t a_col_stride = p.trans_a ? p.lda : 1;
+
+  uint32_t ldb_block;
+  const T* b_block =
+      GetRowMajorBlockOfB<T>(p, b, col0, cols, packed_b, ldb_block);
+
+  float row_values[kMaxOuterProductBlockWidthCPU];
+  for (uint32_t i = row0; i < row0 + rows; ++i) {
+    std::fill(row_values, row_values + cols, 0.0f);
+    for (uint32_t kk = 0; kk < p.k; ++kk) {
+      const T a_value = a[i * a_row_stride + kk * a_col_stride];
+      const T* b_row = b_block + kk * ldb_block;
+      for (uint32_t j = 0; j < cols; ++j) {
+        row_values[j] += tiny::Multiply<T>(a_value, b_row[j]);
       }
     }
+    StoreRow<T>(p, row_values, cols, c + i * p.ldc + col0, epilogue,
+                epilogue_row0 + i, col0);
   }
+}
+
+/*
+ * Kernel for kGemv shapes whose output is a single row (|m| = 1). It is
+ * bandwidth bound on reading op(B) once, so each thread streams a column
+ * block of op(B) row by row (or column by column when B is transposed).
+ */
+template <typename T>
+void GemvRowBlock(const tiny::GemmParams& p, const T* a, const T* b, T* c,
+                  uint32_t row0, uint32_t rows, uint32_t col0, uint32_t cols,
+                  const tiny::Epilogue* epilogue, uint32_t epilogue_row0,
+                  std::vector<T>& packed_b) {
+  assert(row0 == 0 && rows == 1);
+  const uint32_t a_col_stride = p.trans_a ? p.lda : 1;
+
+  float row_values[kMaxGemvBlockWidthCPU] = {};
+  if (p.trans_b) {
+    for (uint32_t j = 0; j < cols; ++j) {
+      const T* b_column = b + (col0 + j) * p.ldb;
+      ReduceOverK(p.k, row_values + j, 1,
+                  [&](uint32_t k_begin, uint32_t k_end, float* partial) {
+                    float sum = 0.0f;
+                    for (uint32_t kk = k_begin; kk < k_end; ++kk) {
+                      sum += tiny::Multiply<T>(a[kk * a_col_stride],
+                                               b_column[kk]);
+                    }
+                    *partial = sum;
+                  });
+    }
+  } else {
+    ReduceOverK(p.k, row_values, cols,
+                [&](uint32_t k_begin, uint32_t k_end, float* partial) {
+                  for (uint32_t kk = k_begin; kk < k_end; ++kk) {
+                    const T a_value = a[kk * a_col_stride];
+                    const T* b_row = b + kk * p.ldb + col0;
+                    for (uint32_t j = 0; j < cols; ++j) {
+                      partial[j] += tiny::Multiply<T>(a_value, b_row[j]);
+                    }
+                  }
+                });
+  }
+  StoreRow<T>(p, row_values, cols, c + col0, epilogue, epilogue_row0, col0);
+}
+
+/*
+ * Kernel for kGemv shapes whose output is a single column (|n| = 1). Each
+ * output element is a dot product between a row of op(A) and op(B).
+ */
+template <typename T>
+void GemvColumnBlock(const tiny::GemmParams& p, const T* a, const T* b, T* c,
+                     uint32_t row0, uint32_t rows, uint32_t col0,
+                     uint32_t cols, const tiny::Epilogue* epilogue,
+                     uint32_t epilogue_row0, std::vector<T>& packed_b) {
+  assert(col0 == 0 && cols == 1);
+  const uint32_t a_row_stride = p.trans_a ? 1 : p.lda;
+  const uint32_t a_col_stride = p.trans_a ? p.lda : 1;
+  const uint32_t b_stride = p.trans_b ? 1 : p.ldb;
+
+  for (uint32_t i = row0; i < row0 + rows; ++i) {
+    const T* a_row = a + i * a_row_stride;
+    float sum = 0.0f;
+    ReduceOverK(p.k, &sum, 1,
+                [&](uint32_t k_begin, uint32_t k_end, float* partial) {
+                  float chunk_sum = 0.0f;
+                  for (uint32_t kk = k_begin; kk < k_end; ++kk) {
+                    chunk_sum += tiny::Multiply<T>(a_row[kk * a_col_stride],
+                                                   b[kk * b_stride]);
+                  }
+                  *partial = chunk_sum;
+                });
+    StoreRow<T>(p, &sum, 1, c + i * p.ldc, epilogue, epilogue_row0 + i, 0);
+  }
+}
+
+/*
+ * Returns GemmBlock() with |tile_h| by |tile_w| register tile. Tile sizes
+ * that are not instantiated fall back to the default one.
+ */
+template <typename T>
+BlockKernel<T> GetGemmBlockKernel(uint32_t tile_h, uint32_t tile_w) {
+  if (tile_h == 4 && tile_w == 8) return GemmBlock<T, 4, 8>;
+  if (tile_h == 4 && tile_w == 16) return GemmBlock<T, 4, 16>;
+  if (tile_h == 8 && tile_w == 16) return GemmBlock<T, 8, 16>;
+  return GemmBlock<T, kTileHeightCPU, kTileWidthCPU>;
+}
+
+/*
+ * Runs |batch| GEMMs with |kernel|. The b-th GEMM reads A, B and C from |a| +
+ * b * |strides|[0], |b| + b * |strides|[1] and |c| + b * |strides|[2]. The
+ * work is split into (batch, row block, column block) items for
+ * |num_threads| host threads where a block is |block_h| by |block_w|.
+ */
+template <typename T>
+tiny::Result RunBlocked(const tiny::GemmParams& p, uint32_t batch, const T* a,
+                        const T* b, T* c, const uint32_t* strides,
+                        const tiny::Epilogue* epilogue, BlockKernel<T> kernel,
+                        uint32_t block_h, uint32_t block_w,
+                        uint32_t num_threads) {
+  const uint32_t row_blocks = (p.m + block_h - 1) / block_h;
+  const uint32_t col_blocks = (p.n + block_w - 1) / block_w;
+  const uint32_t blocks_per_batch = row_blocks * col_blocks;
+
+  tiny::ParallelFor(batch * blocks_per_batch, [&](uint32_t item) {
+    const uint32_t batch_index = item / blocks_per_batch;
+    const uint32_t row = (item % blocks_per_batch) / col_blocks * block_h;
+    const uint32_t col = (item % col_blocks) * block_w;
+
+    thread_local std::vector<T> packed_b;
+    kernel(p, a + static_cast<size_t>(batch_index) * strides[0],
+           b + static_cast<size_t>(batch_index) * strides[1],
+           c + static_cast<size_t>(batch_index) * strides[2], row,
+           std::min(block_h, p.m - row), col, std::min(block_w, p.n - col),
+           epilogue, batch_index * p.m, packed_b);
+  }, num_threads);
 
   return tiny::Result::kSuccess;
 }
 
+/*
+ * Picks the kernel for the shape class of |p| and runs |batch| GEMMs with the
+ * blocking of |config|. See RunBlocked() for |strides|.
+ */
+template <typename T>
+tiny::Result RunGemm(const tiny::GemmParams& p,
+                     const tiny::CPUGemmConfig& config, uint32_t batch,
+                     const T* a, const T* b, T* c, const uint32_t* strides,
+                     const tiny::Epilogue* epilogue) {
+  const uint32_t block_h = std::max(1u, config.block_h);
+  const uint32_t block_w = std::max(1u, config.block_w);
+  switch (tiny::ClassifyGemmShape(p.m, p.n, p.k)) {
+    case tiny::GemmShapeClass::kGemv:
+      if (p.m == 1) {
+        return RunBlocked<T>(p, batch, a, b, c, strides, epilogue,
+                             GemvRowBlock<T>, 1,
+                             std::min(block_w, kMaxGemvBlockWidthCPU),
+                             config.num_threads);
+      }
+      return RunBlocked<T>(p, batch, a, b, c, strides, epilogue,
+                           GemvColumnBlock<T>, block_h, 1, config.num_threads);
+    case tiny::GemmShapeClass::kOuterProduct:
+      return RunBlocked<T>(p, batch, a, b, c, strides, epilogue,
+                           OuterProductBlock<T>, block_h,
+                           std::min(block_w, kMaxOuterProductBlockWidthCPU),
+                           config.num_threads);
+    case tiny::GemmShapeClass::kTallSkinny:
+      // One block covers the whole short side, so that the parallel items
+      // split only the long side.
+      if (p.m > p.n) {
+        return RunBlocked<T>(
+            p, batch, a, b, c, strides, epilogue,
+            GetGemmBlockKernel<T>(config.tile_h, config.tile_w), block_h, p.n,
+            config.num_threads);
+      }
+      return RunBlocked<T>(p, batch, a, b, c, strides, epilogue,
+                           GetGemmBlockKernel<T>(config.tile_h, config.tile_w),
+                           p.m, block_w, config.num_threads);
+    case tiny::GemmShapeClass::kSquare:
+      break;
+  }
+  return RunBlocked<T>(p, batch, a, b, c, strides, epilogue,
+                       GetGemmBlockKernel<T>(config.tile_h, config.tile_w),
+                       block_h, block_w, config.num_threads);
+}
+
+/*
+ * RunGemm() with the blocking of the shape class of |p| for this host (see
+ * tiny::GetCPUGemmConfig()).
+ */
+template <typename T>
+tiny::Result RunGemm(const tiny::GemmParams& p, uint32_t batch, const T* a,
+                     const T* b, T* c, const uint32_t* strides,
+                     const tiny::Epilogue* epilogue) {
+  return RunGemm<T>(p,
+                    tiny::GetCPUGemmConfig(tiny::ClassifyGemmShape(p.m, p.n,
+                                                                   p.k)),
+                    batch, a, b, c, strides, epilogue);
+}
+
+/* GemmParams of densely packed |m| by |k| and |k| by |n| matrices. */
+tiny::GemmParams DenseGemmParams(uint32_t m, uint32_t k, uint32_t n) {
+  return {.m = m, .n = n, .k = k, .lda = k, .ldb = n, .ldc = n};
+}
+
 } /* namespace */
 
 namespace tiny {
 
+GemmShapeClass ClassifyGemmShape(uint32_t m, uint32_t n, uint32_t k) {
+  if (m == 1 || n == 1) return GemmShapeClass::kGemv;
+  if (k <= kSmallDimensionCPU) return GemmShapeClass::kOuterProduct;
+  const uint32_t short_side = std::min(m, n);
+  const uint32_t long_side = std::max(m, n);
+  if (short_side <= kSmallDimensionCPU && long_side >= 8 * short_side) {
+    return GemmShapeClass::kTallSkinny;
+  }
+  return GemmShapeClass::kSquare;
+}
+
+CPUGemmConfig GetDefaultCPUGemmConfig(GemmShapeClass shape_class) {
+  CPUGemmConfig config = {.tile_h = kTileHeightCPU,
+                          .tile_w = kTileWidthCPU,
+                          .block_h = kBlockHeightCPU,
+                          .block_w = kBlockWidthCPU,
+                          .num_threads = 0};
+  switch (shape_class) {
+    case GemmShapeClass::kGemv:
+      config.block_h = kGemvBlockHeightCPU;
+      config.block_w = kGemvBlockWidthCPU;
+      break;
+    case GemmShapeClass::kOuterProduct:
+      config.block_h = kOuterProductBlockHeightCPU;
+      config.block_w = kOuterProductBlockWidthCPU;
+      break;
+    case GemmShapeClass::kTallSkinny:
+      config.block_h = kTallSkinnyBlockLengthCPU;
+      config.block_w = kTallSkinnyBlockLengthCPU;
+      break;
+    case GemmShapeClass::kSquare:
+      break;
+  }
+  return config;
+}
+
+const char* GetGemmShapeClassName(GemmShapeClass shape_class) {
+  switch (shape_class) {
+    case GemmShapeClass::kGemv:
+      return "gemv";
+    case GemmShapeClass::kOuterProduct:
+      return "outer-product";
+    case GemmShapeClass::kTallSkinny:
+      return "tall-skinny";
+    case GemmShapeClass::kSquare:
+      return "square";
+  }
+  return "unknown";
+}
+
+template <typename T>
+Result Gemm(const GemmParams& params, const T* a, const T* b, T* c,
+            const Epilogue* epilogue) {
+  const uint32_t strides[3] = {0, 0, 0};
+  return RunGemm<T>(params, 1, a, b, c, strides, epilogue);
+}
+
+template Result Gemm<float>(const GemmParams&, const float*, const float*,
+                            float*, const Epilogue*);
+template Result Gemm<bfloat16>(const GemmParams&, const bfloat16*,
+                               const bfloat16*, bfloat16*, const Epilogue*);
+
+template <typename T>
+Result GemmWithConfig(const GemmParams& params, const CPUGemmConfig& config,
+                      const T* a, const T* b, T* c, const Epilogue* epilogue) {
+  const uint32_t strides[3] = {0, 0, 0};
+  return RunGemm<T>(params, config, 1, a, b, c, strides, epilogue);
+}
+
+template Result GemmWithConfig<float>(const GemmParams&, const CPUGemmConfig&,
+                                      const float*, const float*, float*,
+                                      const Epilogue*);
+template Result GemmWithConfig<bfloat16>(const GemmParams&,
+                                         const CPUGemmConfig&,
+                                         const bfloat16*, const bfloat16*,
+                                         bfloat16*, const Epilogue*);
+
+template <>
+Result CPUGemm<bfloat16>::Run() {
+  return Gemm<bfloat16>(params_, inputs_[0]->GetVector().data() + offsets_[0],
+                        inputs_[1]->GetVector().data() + offsets_[1],
+                        output_->GetVector().data() + offsets_[2],
+                        epilogue_.get());
+}
+
+template <>
+Result CPUGemm<float>::Run() {
+  return Gemm<float>(params_, inputs_[0]->GetVector().data() + offsets_[0],
+                     inputs_[1]->GetVector().data() + offsets_[1],
+                     output_->GetVector().data() + offsets_[2],
+                     epilogue_.get());
+}
+
 template <>
 Result CPUMatrixMultiplication<bfloat16>::Run() {
   assert(!inputs_[0]->IsTilized());
   assert(!inputs_[1]->IsTilized());
+  return Gemm<bfloat16>(DenseGemmParams(m_, k_, n_),
+                        inputs_[0]->GetVector().data(),
+                        inputs_[1]->GetVector().data(),
+                        output_->GetVector().data(), epilogue_.get());
+}
 
-  for (uint32_t i = 0; i < m_; ++i) {
-    for (uint32_t j = 0; j < n_; ++j) {
-      float element = 0.0f;
-      for (uint32_t k = 0; k < k_; ++k) {
-        uint32_t index0 = i * k_ + k;
-        uint32_t index1 = k * n_ + j;
-        bfloat16 value(inputs_[0]->GetVector()[index0].to_float() *
-                       inputs_[1]->GetVector()[index1].to_float());
-        element += value.to_float();
-      }
-      output_->GetVector()[i * n_ + j] = bfloat16(element);
-    }
-  }
+template <>
+Result CPUMatrixMultiplication<float>::Run() {
+  assert(!inputs_[0]->IsTilized());
+  assert(!inputs_[1]->IsTilized());
+  return Gemm<float>(DenseGemmParams(m_, k_, n_),
+                     inputs_[0]->GetVector().data(),
+                     inputs_[1]->GetVector().data(),
+                     output_->GetVector().data(), epilogue_.get());
+}
 
-  return Result::kSuccess;
+template <>
+Result CPUBatchedMatrixMultiplication<bfloat16>::Run() {
+  assert(!inputs_[0]->IsTilized());
+  assert(!inputs_[1]->IsTilized());
+  return RunGemm<bfloat16>(DenseGemmParams(m_, k_, n_), batch_,
+                           inputs_[0]->GetVector().data(),
+                           inputs_[1]->GetVector().data(),
+                           output_->GetVector().data(), strides_,
+                           epilogue_.get());
 }
 
 template <>
-Result CPUMatrixMultiplication<float>::Run() {
-  return _Run(inputs_[0], inputs_[1], output_, m_, k_, n_);
+Result CPUBatchedMatrixMultiplication<float>::Run() {
+  assert(!inputs_[0]->IsTilized());
+  assert(!inputs_[1]->IsTilized());
+  return RunGemm<float>(DenseGemmParams(m_, k_, n_), batch_,
+                        inputs_[0]->GetVector().data(),
+                        inputs_[1]->GetVector().data(),
+                        output_->GetVector().data(), strides_,
+                        epilogue_.get());
 }
 
 } /* namespace tiny */
@@ -21,9 +21,142 @@
 
 #include "blas_op.h"
 #include "buffer.h"
+#include "epilogue.h"
 
 namespace tiny {
 
+/*
+ * Parameters of BLAS-style GEMM
+ *
+ *   C = alpha * op(A) * op(B) + beta * C
+ *
+ * where op(A) is |m| by |k|, op(B) is |k| by |n| and C is |m| by |n|. op(X)
+ * is the transpose of X when |trans_x| is true, otherwise X itself. All
+ * matrices are stored row by row, and |lda|, |ldb| and |ldc| are the number of
+ * elements between two consecutive rows of the stored A, B and C. For
+ * example, a sub-matrix of a larger matrix can be used directly by pointing at
+ * its first element and passing the width of the larger matrix.
+ *
+ * When |beta| is 0, C is not read, so it does not have to be initialized.
+ */
+struct GemmParams {
+  uint32_t m;
+  uint32_t n;
+  uint32_t k;
+  bool trans_a = false;
+  bool trans_b = false;
+  uint32_t lda;
+  uint32_t ldb;
+  uint32_t ldc;
+  float alpha = 1.0f;
+  float beta = 0.0f;
+};
+
+/*
+ * Shape classes of GEMM. Each class has its own CPU kernel and blocking:
+ *  - kGemv: |m| = 1 or |n| = 1 e.g., a single token in inference.
+ *  - kOuterProduct: small |k| e.g., (N * 32 by 32) * (32 by N * 32) in
+ *    TestMulticastMatrixMultiplication().
+ *  - kTallSkinny: one side of the output is small and much shorter than the
+ *    other.
+ *  - kSquare: everything else.
+ */
+enum class GemmShapeClass {
+  kGemv,
+  kOuterProduct,
+  kTallSkinny,
+  kSquare,
+};
+
+GemmShapeClass ClassifyGemmShape(uint32_t m, uint32_t n, uint32_t k);
+
+const char* GetGemmShapeClassName(GemmShapeClass shape_class);
+
+/*
+ * Blocking of the CPU kernel of a shape class. See autotune.h for tuning it
+ * for the host.
+ *  - |tile_h| by |tile_w| is the register tile of kSquare and kTallSkinny
+ *    kernels. 4x8, 8x8, 4x16 and 8x16 are available.
+ *  - |block_h| by |block_w| is the output block computed by a work item of a
+ *    host thread. The short side of kTallSkinny and the single row or column
+ *    of kGemv are not split.
+ *  - |num_threads| is the number of host threads. 0 means
+ *    GetNumberOfHostThreads().
+ */
+struct CPUGemmConfig {
+  uint32_t tile_h;
+  uint32_t tile_w;
+  uint32_t block_h;
+  uint32_t block_w;
+  uint32_t num_threads;
+};
+
+/* Returns the built-in blocking of |shape_class|. */
+CPUGemmConfig GetDefaultCPUGemmConfig(GemmShapeClass shape_class);
+
+/*
+ * Runs GEMM on host threads with the kernel for the shape class of |params|.
+ * T is float or bfloat16. Accumulation is done in float. |epilogue|
+ * (optional) is applied after the alpha/beta scaling. The blocking is
+ * GetCPUGemmConfig() of the shape class.
+ *
+ * Each element of C is computed by a single thread, so the result does not
+ * depend on the number of threads. In the deterministic reduction mode (see
+ * IsDeterministicReduction()), the sum over K also follows the chunked
+ * pairwise order shared by all CPU ops, e.g., a split-K result.
+ */
+template <typename T>
+Result Gemm(const GemmParams& params, const T* a, const T* b, T* c,
+            const Epilogue* epilogue = nullptr);
+
+/* Gemm() with |config| instead of the blocking tuned for the host. */
+template <typename T>
+Result GemmWithConfig(const GemmParams& params, const CPUGemmConfig& config,
+                      const T* a, const T* b, T* c,
+                      const Epilogue* epilogue = nullptr);
+
+/* BLASOp wrapper of Gemm() for Buffer inputs. */
+template <typename T>
+class CPUGemm : BLASOp {
+ public:
+  CPUGemm(const GemmParams& params) : params_(params) {}
+
+  Result Run();
+
+  using BLASOp::SetEpilogue;
+
+  /*
+   * |offsets| are the indices of the first element of A, B and C in the
+   * buffers, e.g., to multiply sub-matrices without copying them.
+   */
+  void SetBuffers(std::shared_ptr<Buffer<T>> input0,
+                  std::shared_ptr<Buffer<T>> input1,
+                  std::shared_ptr<Buffer<T>> output,
+                  const std::vector<size_t>& offsets = {0, 0, 0}) {
+    assert(offsets.size() == 3);
+    const GemmParams& p = params_;
+    assert(input0->GetNumberOfElements() >=
+           offsets[0] + (p.trans_a ? (p.k - 1) * p.lda + p.m
+                                   : (p.m - 1) * p.lda + p.k));
+    assert(input1->GetNumberOfElements() >=
+           offsets[1] + (p.trans_b ? (p.n - 1) * p.ldb + p.k
+                                   : (p.k - 1) * p.ldb + p.n));
+    assert(output->GetNumberOfElements() >=
+           offsets[2] + (p.m - 1) * p.ldc + p.n);
+
+    inputs_[0] = input0;
+    inputs_[1] = input1;
+    output_ = output;
+    for (uint32_t i = 0; i < 3; ++i) offsets_[i] = offsets[i];
+  }
+
+ private:
+  GemmParams params_;
+  size_t offsets_[3];
+  std::shared_ptr<Buffer<T>> inputs_[2];
+  std::shared_ptr<Buffer<T>> output_;
+};
+
 template <typename T>
 class CPUMatrixMultiplication : BLASOp {
  public:
@@ -33,6 +166,8 @@ class CPUMatrixMultiplication : BLASOp {
 
   Result Run();
 
+  using BLASOp::SetEpilogue;
+
   void SetBuffers(std::shared_ptr<Buffer<T>> input0,
                   std::shared_ptr<Buffer<T>> input1,
                   std::shared_ptr<Buffer<T>> output) {
@@ -54,6 +189,77 @@ class CPUMatrixMultiplication : BLASOp {
   std::shared_ptr<Buffer<T>> output_;
 };
 
+/*
+ * Batched matrix multiplication that matches matmul_multicore_reuse_mcast() in
+ * conv.cpp. For each b in [0, |batch|), it computes
+ *
+ *   output[b] = input0[b] * input1[bcast_batch ? 0 : b]
+ *
+ * where input0[b] is |m| by |k|, input1[b] is |k| by |n| and output[b] is |m|
+ * by |n|. By default the matrices are densely packed one after another. Use
+ * SetStrides() when the distance between consecutive matrices (in number of
+ * elements) is larger than that. With |bcast_batch|, the single input1 matrix
+ * is shared by all batches.
+ *
+ * The work is split into (batch, row block, column block) items that run in
+ * parallel on the host threads.
+ */
+template <typename T>
+class CPUBatchedMatrixMultiplication : BLASOp {
+ public:
+  CPUBatchedMatrixMultiplication(uint32_t batch, uint32_t m, uint32_t k,
+                                 uint32_t n, bool bcast_batch)
+      : batch_(batch),
+        m_(m),
+        k_(k),
+        n_(n),
+        bcast_batch_(bcast_batch),
+        strides_{m * k, bcast_batch ? 0 : k * n, m * n} {}
+
+  Result Run();
+
+  /*
+   * The epilogue sees the output as |batch| * |m| by |n| matrix i.e., element
+   * (i, j) of output[b] is element (b * |m| + i, j).
+   */
+  using BLASOp::SetEpilogue;
+
+  void SetStrides(uint32_t input0_stride, uint32_t input1_stride,
+                  uint32_t output_stride) {
+    assert(input0_stride >= m_ * k_);
+    assert(bcast_batch_ || input1_stride >= k_ * n_);
+    assert(output_stride >= m_ * n_);
+    strides_[0] = input0_stride;
+    strides_[1] = bcast_batch_ ? 0 : input1_stride;
+    strides_[2] = output_stride;
+  }
+
+  void SetBuffers(std::shared_ptr<Buffer<T>> input0,
+                  std::shared_ptr<Buffer<T>> input1,
+                  std::shared_ptr<Buffer<T>> output) {
+    assert(input0->GetNumberOfElements() >=
+           (batch_ - 1) * strides_[0] + m_ * k_);
+    assert(input1->GetNumberOfElements() >=
+           (batch_ - 1) * strides_[1] + k_ * n_);
+    assert(output->GetNumberOfElements() >=
+           (batch_ - 1) * strides_[2] + m_ * n_);
+
+    inputs_[0] = input0;
+    inputs_[1] = input1;
+    output_ = output;
+  }
+
+ private:
+  uint32_t batch_;
+  uint32_t m_;
+  uint32_t k_;
+  uint32_t n_;
+  bool bcast_batch_;
+  uint32_t strides_[3];
+  std::shared_ptr<Buffer<T>> inputs_[2];
+  std::shared_ptr<Buffer<T>> output_;
+};
+
 } /* namespace tiny */
 
 #endif /* ifndef matmul_cpu_ */
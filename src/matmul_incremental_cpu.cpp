@@ -0,0 +1,124 @@
+// Copyright (c) 2024 Jaebaek Seo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "matmul_incremental_cpu.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "matmul_cpu.h"
+#include "tt_metal/common/bfloat16.hpp"
+#include "utils.h"
+
+namespace {
+
+/* Returns [begin, end) runs of |value| in |flags|. */
+std::vector<std::pair<uint32_t, uint32_t>> GetRuns(
+    const std::vector<bool>& flags, bool value) {
+  std::vector<std::pair<uint32_t, uint32_t>> runs;
+  for (uint32_t i = 0; i < flags.size();) {
+    if (flags[i] != value) {
+      ++i;
+      continue;
+    }
+    uint32_t begin = i;
+    while (i < flags.size() && flags[i] == value) ++i;
+    runs.push_back({begin, i});
+  }
+  return runs;
+}
+
+} /* namespace */
+
+namespace tiny {
+
+template <typename T>
+Result CPUIncrementalMatrixMultiplication<T>::Run() {
+  assert(!inputs_[0]->IsTilized());
+  assert(!inputs_[1]->IsTilized());
+
+  const T* a = inputs_[0]->GetVector().data();
+  const T* b = inputs_[1]->GetVector().data();
+  T* c = output_->GetVector().data();
+
+  if (!computed_) {
+    inputs_[0]->ClearDirty();
+    inputs_[1]->ClearDirty();
+    computed_ = true;
+    skipped_fraction_ = 0.0;
+    return Gemm<T>({.m = m_, .n = n_, .k = k_, .lda = k_, .ldb = n_,
+                    .ldc = n_},
+                   a, b, c);
+  }
+
+  // Output rows affected by the dirty elements of A.
+  std::vector<bool> dirty_rows(m_, false);
+  for (const auto& range : inputs_[0]->GetDirtyRanges()) {
+    const uint32_t last_row = (range.second - 1) / k_;
+    for (uint32_t i = range.first / k_; i <= last_row; ++i) {
+      dirty_rows[i] = true;
+    }
+  }
+
+  // Output column tiles affected by the dirty elements of B. A range that
+  // covers a whole row of B dirties every column.
+  const uint32_t tiles_n = (n_ + TileWidth() - 1) / TileWidth();
+  std::vector<bool> dirty_tiles(tiles_n, false);
+  for (const auto& range : inputs_[1]->GetDirtyRanges()) {
+    uint32_t first_col = range.first % n_;
+    uint32_t last_col = (range.second - 1) % n_;
+    if (range.second - range.first >= n_ || first_col > last_col) {
+      first_col = 0;
+      last_col = n_ - 1;
+    }
+    for (uint32_t tile = first_col / TileWidth();
+         tile <= last_col / TileWidth(); ++tile) {
+      dirty_tiles[tile] = true;
+    }
+  }
+  inputs_[0]->ClearDirty();
+  inputs_[1]->ClearDirty();
+
+  size_t recomputed = 0;
+  for (const auto& rows : GetRuns(dirty_rows, true)) {
+    const uint32_t height = rows.second - rows.first;
+    Gemm<T>({.m = height, .n = n_, .k = k_, .lda = k_, .ldb = n_, .ldc = n_},
+            a + static_cast<size_t>(rows.first) * k_, b,
+            c + static_cast<size_t>(rows.first) * n_);
+    recomputed += static_cast<size_t>(height) * n_;
+  }
+
+  const auto column_runs = GetRuns(dirty_tiles, true);
+  for (const auto& rows : GetRuns(dirty_rows, false)) {
+    const uint32_t height = rows.second - rows.first;
+    for (const auto& tiles : column_runs) {
+      const uint32_t col0 = tiles.first * TileWidth();
+      const uint32_t width = std::min(tiles.second * TileWidth(), n_) - col0;
+      Gemm<T>({.m = height, .n = width, .k = k_, .lda = k_, .ldb = n_,
+               .ldc = n_},
+              a + static_cast<size_t>(rows.first) * k_, b + col0,
+              c + static_cast<size_t>(rows.first) * n_ + col0);
+      recomputed += static_cast<size_t>(height) * width;
+    }
+  }
+
+  skipped_fraction_ =
+      1.0 - static_cast<double>(recomputed) / (static_cast<double>(m_) * n_);
+  return Result::kSuccess;
+}
+
+template class CPUIncrementalMatrixMultiplication<float>;
+template class CPUIncrementalMatrixMultiplication<bfloat16>;
+
+} /* namespace tiny */
@@ -0,0 +1,76 @@
+// Copyright (c) 2024 Jaebaek Seo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef matmul_incremental_cpu_h_
+#define matmul_incremental_cpu_h_
+
+#include <cassert>
+#include <cstdint>
+#include <memory>
+
+#include "blas_op.h"
+#include "buffer.h"
+
+namespace tiny {
+
+/*
+ * Matrix multiplication between |m| by |k| matrix A and |k| by |n| matrix B
+ * that recomputes only the part of the output affected by the inputs changed
+ * since the previous Run().
+ *
+ * Writers mark changed elements with Buffer::MarkDirty(). A changed element
+ * in row i of A affects only row i of the output, and a changed element in
+ * column j of B affects column j. So Run() recomputes the dirty rows of the
+ * output, and the dirty column tiles (TileWidth() columns) of the remaining
+ * rows, and keeps the rest of the output from the previous Run(). The first
+ * Run() after SetBuffers() computes everything. The output must not be
+ * changed by anyone else between runs.
+ */
+template <typename T>
+class CPUIncrementalMatrixMultiplication : BLASOp {
+ public:
+  CPUIncrementalMatrixMultiplication(uint32_t m, uint32_t k, uint32_t n)
+      : m_(m), k_(k), n_(n) {}
+
+  Result Run();
+
+  void SetBuffers(std::shared_ptr<Buffer<T>> input0,
+                  std::shared_ptr<Buffer<T>> input1,
+                  std::shared_ptr<Buffer<T>> output) {
+    assert(input0->GetNumberOfElements() == m_ * k_);
+    assert(input1->GetNumberOfElements() == k_ * n_);
+    assert(output->GetNumberOfElements() == m_ * n_);
+
+    inputs_[0] = input0;
+    inputs_[1] = input1;
+    output_ = output;
+    computed_ = false;
+  }
+
+  /* Fraction of the output elements that the last Run() did not recompute. */
+  double GetSkippedFraction() const { return skipped_fraction_; }
+
+ private:
+  uint32_t m_;
+  uint32_t k_;
+  uint32_t n_;
+  std::shared_ptr<Buffer<T>> inputs_[2];
+  std::shared_ptr<Buffer<T>> output_;
+  bool computed_ = false;
+  double skipped_fraction_ = 0.0;
+};
+
+} /* namespace tiny */
+
+#endif /* ifndef matmul_incremental_cpu_h_ */
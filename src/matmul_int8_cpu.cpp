@@ -0,0 +1,225 @@
+// Copyright (c) 2024 Jaebaek Seo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "matmul_int8_cpu.h"
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "parallel.h"
+
+namespace {
+
+#if defined(__AVX512VNNI__) && defined(__AVX512BW__)
+#define TINY_INT8_AVX512_VNNI 1
+#elif defined(__AVXVNNI__)
+#define TINY_INT8_AVX_VNNI 1
+#elif defined(__AVX2__)
+#define TINY_INT8_AVX2 1
+#endif
+
+/*
+ * vpdpbusd multiplies unsigned bytes by signed bytes. The VNNI paths store
+ * the first input as |a| + 128 and subtract 128 * (sum of the column of the
+ * second input) from each dot product.
+ */
+#if defined(TINY_INT8_AVX512_VNNI) || defined(TINY_INT8_AVX_VNNI)
+static constexpr bool kUnsignedFirstInput = true;
+#else
+static constexpr bool kUnsignedFirstInput = false;
+#endif
+
+/* Packed rows are padded with zeros to a multiple of this. */
+static constexpr uint32_t kKAlignment = 64;
+
+/* Number of columns of the second input used by a single dot product call. */
+static constexpr uint32_t kColumnsPerDot = 4;
+
+/* Number of output rows that a single host thread computes at once. */
+static constexpr uint32_t kRowBlock = 16;
+
+inline uint32_t AlignK(uint32_t k) {
+  return (k + kKAlignment - 1) / kKAlignment * kKAlignment;
+}
+
+#if defined(TINY_INT8_AVX512_VNNI)
+inline int32_t ReduceAdd(__m512i v) { return _mm512_reduce_add_epi32(v); }
+#elif defined(TINY_INT8_AVX_VNNI) || defined(TINY_INT8_AVX2)
+inline int32_t ReduceAdd(__m256i v) {
+  __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(v),
+                              _mm256_extracti128_si256(v, 1));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_cvtsi128_si32(sum);
+}
+#endif
+
+/*
+ * Dot products between a packed row |a| and |kColumnsPerDot| packed columns
+ * starting from |b|. |k| is a multiple of kKAlignment.
+ */
+inline void Dot(const int8_t* a, const int8_t* b, uint32_t k,
+                int32_t* results) {
+#if defined(TINY_INT8_AVX512_VNNI)
+  __m512i acc[kColumnsPerDot] = {};
+  for (uint32_t i = 0; i < k; i += 64) {
+    __m512i va = _mm512_loadu_si512(a + i);
+    for (uint32_t c = 0; c < kColumnsPerDot; ++c) {
+      __m512i vb = _mm512_loadu_si512(b + c * k + i);
+      acc[c] = _mm512_dpbusd_epi32(acc[c], va, vb);
+    }
+  }
+#elif defined(TINY_INT8_AVX_VNNI)
+  __m256i acc[kColumnsPerDot] = {};
+  for (uint32_t i = 0; i < k; i += 32) {
+    __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+    for (uint32_t c = 0; c < kColumnsPerDot; ++c) {
+      __m256i vb =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + c * k + i));
+      acc[c] = _mm256_dpbusd_avx_epi32(acc[c], va, vb);
+    }
+  }
+#elif defined(TINY_INT8_AVX2)
+  // vpmaddubsw saturates at int16, so sign-extend to int16 and use vpmaddwd
+  // which keeps the exact sum of each pair in int32.
+  __m256i acc[kColumnsPerDot] = {};
+  for (uint32_t i = 0; i < k; i += 16) {
+    __m256i va = _mm256_cvtepi8_epi16(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)));
+    for (uint32_t c = 0; c < kColumnsPerDot; ++c) {
+      __m256i vb = _mm256_cvtepi8_epi16(
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + c * k + i)));
+      acc[c] = _mm256_add_epi32(acc[c], _mm256_madd_epi16(va, vb));
+    }
+  }
+#else
+  int32_t acc[kColumnsPerDot] = {};
+  for (uint32_t i = 0; i < k; ++i) {
+    for (uint32_t c = 0; c < kColumnsPerDot; ++c) {
+      acc[c] += static_cast<int32_t>(a[i]) * b[c * k + i];
+    }
+  }
+#endif
+
+  for (uint32_t c = 0; c < kColumnsPerDot; ++c) {
+#if defined(TINY_INT8_AVX512_VNNI) || defined(TINY_INT8_AVX_VNNI) || \
+    defined(TINY_INT8_AVX2)
+    results[c] = ReduceAdd(acc[c]);
+#else
+    results[c] = acc[c];
+#endif
+  }
+}
+
+/*
+ * Packs |rows| by |k| int8 matrix into rows of |k_padded| elements. With
+ * kUnsignedFirstInput, the values are stored as |value| + 128 i.e., uint8_t
+ * bits in int8_t.
+ */
+std::vector<int8_t> PackRows(const std::vector<int8_t>& input, uint32_t rows,
+                             uint32_t k, uint32_t k_padded,
+                             bool to_unsigned) {
+  // The zero padding must stay zero after the +128 shift, so pad with -128.
+  std::vector<int8_t> packed(rows * k_padded,
+                             to_unsigned ? static_cast<int8_t>(-128) : 0);
+  for (uint32_t i = 0; i < rows; ++i) {
+    for (uint32_t j = 0; j < k; ++j) {
+      int8_t value = input[i * k + j];
+      packed[i * k_padded + j] =
+          to_unsigned ? static_cast<int8_t>(static_cast<uint8_t>(value) ^ 0x80)
+                      : value;
+    }
+  }
+  return packed;
+}
+
+/*
+ * Packs |k| by |n| int8 matrix column by column. The number of packed
+ * columns is rounded up to a multiple of kColumnsPerDot.
+ */
+std::vector<int8_t> PackColumns(const std::vector<int8_t>& input, uint32_t k,
+                                uint32_t n, uint32_t n_padded,
+                                uint32_t k_padded) {
+  std::vector<int8_t> packed(n_padded * k_padded, 0);
+  for (uint32_t i = 0; i < k; ++i) {
+    for (uint32_t j = 0; j < n; ++j) {
+      packed[j * k_padded + i] = input[i * n + j];
+    }
+  }
+  return packed;
+}
+
+} /* namespace */
+
+namespace tiny {
+
+const char* CPUInt8MatrixMultiplication::GetKernelName() {
+#if defined(TINY_INT8_AVX512_VNNI)
+  return "avx512-vnni";
+#elif defined(TINY_INT8_AVX_VNNI)
+  return "avx-vnni";
+#elif defined(TINY_INT8_AVX2)
+  return "avx2";
+#else
+  return "scalar";
+#endif
+}
+
+Result CPUInt8MatrixMultiplication::Run() {
+  assert(!inputs_[0]->IsTilized());
+  assert(!inputs_[1]->IsTilized());
+
+  const uint32_t k_padded = AlignK(k_);
+  const uint32_t n_padded =
+      (n_ + kColumnsPerDot - 1) / kColumnsPerDot * kColumnsPerDot;
+  std::vector<int8_t> packed0 = PackRows(inputs_[0]->GetVector(), m_, k_,
+                                         k_padded, kUnsignedFirstInput);
+  std::vector<int8_t> packed1 =
+      PackColumns(inputs_[1]->GetVector(), k_, n_, n_padded, k_padded);
+
+  // Compensation for the +128 shift of the first input.
+  std::vector<int32_t> compensation(n_padded, 0);
+  if (kUnsignedFirstInput) {
+    for (uint32_t j = 0; j < n_; ++j) {
+      int32_t column_sum = 0;
+      for (uint32_t i = 0; i < k_; ++i) column_sum += packed1[j * k_padded + i];
+      compensation[j] = 128 * column_sum;
+    }
+  }
+
+  auto& output_vec = output_->GetVector();
+  const uint32_t row_blocks = (m_ + kRowBlock - 1) / kRowBlock;
+  ParallelFor(row_blocks, [&](uint32_t block) {
+    const uint32_t row_end = std::min(m_, (block + 1) * kRowBlock);
+    int32_t results[kColumnsPerDot];
+    for (uint32_t i = block * kRowBlock; i < row_end; ++i) {
+      const int8_t* a = packed0.data() + i * k_padded;
+      for (uint32_t j = 0; j < n_padded; j += kColumnsPerDot) {
+        Dot(a, packed1.data() + j * k_padded, k_padded, results);
+        for (uint32_t c = 0; c < kColumnsPerDot && j + c < n_; ++c) {
+          output_vec[i * n_ + j + c] = results[c] - compensation[j + c];
+        }
+      }
+    }
+  });
+
+  return Result::kSuccess;
+}
+
+} /* namespace tiny */
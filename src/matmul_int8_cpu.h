@@ -0,0 +1,73 @@
+// Copyright (c) 2024 Jaebaek Seo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef matmul_int8_cpu_h_
+#define matmul_int8_cpu_h_
+
+#include <cassert>
+#include <cstdint>
+#include <memory>
+
+#include "blas_op.h"
+#include "buffer.h"
+
+namespace tiny {
+
+/*
+ * Matrix multiplication between |m| by |k| int8 matrix and |k| by |n| int8
+ * matrix with int32 accumulation. It is the reference for quantized layers
+ * whose inputs come from QuantizePerTensor()/QuantizePerChannel() in
+ * buffer.h; Dequantize() converts the int32 output back to float or
+ * bfloat16.
+ *
+ * The second input is packed column by column before the multiplication, so
+ * that each output element is a dot product of two contiguous vectors. The dot
+ * product uses AVX512-VNNI or AVX-VNNI (vpdpbusd) when the host compiler
+ * targets it (see ENABLE_NATIVE_ARCH), AVX2 (vpmaddwd on sign-extended
+ * values) otherwise, and scalar code as the last fallback. All paths compute
+ * the exact int32 result.
+ */
+class CPUInt8MatrixMultiplication : BLASOp {
+ public:
+  CPUInt8MatrixMultiplication(uint32_t m, uint32_t k, uint32_t n)
+      : m_(m), k_(k), n_(n) {}
+
+  Result Run();
+
+  void SetBuffers(std::shared_ptr<Buffer<int8_t>> input0,
+                  std::shared_ptr<Buffer<int8_t>> input1,
+                  std::shared_ptr<Buffer<int>> output) {
+    assert(input0->GetNumberOfElements() == m_ * k_);
+    assert(input1->GetNumberOfElements() == k_ * n_);
+    assert(output->GetNumberOfElements() == m_ * n_);
+
+    inputs_[0] = input0;
+    inputs_[1] = input1;
+    output_ = output;
+  }
+
+  /* Name of the dot product implementation selected at build time. */
+  static const char* GetKernelName();
+
+ private:
+  uint32_t m_;
+  uint32_t k_;
+  uint32_t n_;
+  std::shared_ptr<Buffer<int8_t>> inputs_[2];
+  std::shared_ptr<Buffer<int>> output_;
+};
+
+} /* namespace tiny */
+
+#endif /* ifndef matmul_int8_cpu_h_ */
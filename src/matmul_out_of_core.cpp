@@ -0,0 +1,225 @@
+// Copyright (c) 2024 Jaebaek Seo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "matmul_out_of_core.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+#include "matmul_cpu.h"
+#include "tt_metal/common/bfloat16.hpp"
+#include "utils.h"
+
+namespace {
+
+/* K panel width. Bytes read do not depend on it, so keep it small. */
+static constexpr uint32_t kBlockKOutOfCore = 256;
+
+/* Lower bound of the C block size, even for a tiny budget. */
+static constexpr uint32_t kMinBlockOutOfCore = 32;
+
+/* Read-only or read-write mapping of a whole file. */
+class MappedFile {
+ public:
+  ~MappedFile() {
+    if (data_ != nullptr) munmap(data_, size_);
+    if (fd_ >= 0) close(fd_);
+  }
+
+  bool OpenForRead(const std::string& path, size_t size) {
+    fd_ = open(path.c_str(), O_RDONLY);
+    if (fd_ < 0 || lseek(fd_, 0, SEEK_END) < static_cast<off_t>(size)) {
+      return false;
+    }
+    return Map(size, PROT_READ);
+  }
+
+  bool OpenForWrite(const std::string& path, size_t size) {
+    fd_ = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd_ < 0 || ftruncate(fd_, size) != 0) return false;
+    return Map(size, PROT_READ | PROT_WRITE);
+  }
+
+  char* GetData() const { return static_cast<char*>(data_); }
+
+  /* Drops pages of [|offset|, |offset| + |length|) from the resident set. */
+  void Release(size_t offset, size_t length) {
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t begin = offset / page * page;
+    madvise(GetData() + begin, offset + length - begin, MADV_DONTNEED);
+  }
+
+  /* Writes back [|offset|, |offset| + |length|) and drops its pages. */
+  void SyncAndRelease(size_t offset, size_t length) {
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t begin = offset / page * page;
+    msync(GetData() + begin, offset + length - begin, MS_SYNC);
+    Release(offset, length);
+  }
+
+ private:
+  bool Map(size_t size, int protection) {
+    size_ = size;
+    data_ = mmap(nullptr, size, protection, MAP_SHARED, fd_, 0);
+    if (data_ == MAP_FAILED) {
+      data_ = nullptr;
+      return false;
+    }
+    return true;
+  }
+
+  int fd_ = -1;
+  void* data_ = nullptr;
+  size_t size_ = 0;
+};
+
+double SecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+/*
+ * Copies |rows| by |cols| sub-matrix from (|row0|, |col0|) of a row-major
+ * matrix with |ld| elements per row in |file| to |panel| as floats, then
+ * releases the pages of the rows.
+ */
+template <typename T>
+void ReadPanel(MappedFile& file, uint32_t ld, uint32_t row0, uint32_t rows,
+               uint32_t col0, uint32_t cols, std::vector<float>& panel) {
+  panel.resize(static_cast<size_t>(rows) * cols);
+  const T* data = reinterpret_cast<const T*>(file.GetData());
+  for (uint32_t i = 0; i < rows; ++i) {
+    const T* src = data + static_cast<size_t>(row0 + i) * ld + col0;
+    float* dst = panel.data() + static_cast<size_t>(i) * cols;
+    for (uint32_t j = 0; j < cols; ++j) dst[j] = tiny::ToFloat<T>(src[j]);
+    file.Release((static_cast<size_t>(row0 + i) * ld + col0) * sizeof(T),
+                 cols * sizeof(T));
+  }
+}
+
+} /* namespace */
+
+namespace tiny {
+
+template <typename T>
+OutOfCoreMatrixMultiplication<T>::OutOfCoreMatrixMultiplication(
+    uint32_t m, uint32_t k, uint32_t n, size_t memory_budget)
+    : m_(m), k_(k), n_(n) {
+  // The float C block (b * b) and the float A and B panels (2 * b * block_k)
+  // share the budget: 4 * (b * b + 2 * b * block_k) <= |memory_budget|.
+  block_k_ = std::min(k, kBlockKOutOfCore);
+  double bk = block_k_;
+  double b = -bk + std::sqrt(bk * bk + memory_budget / 4.0);
+  uint32_t block = std::max(kMinBlockOutOfCore, static_cast<uint32_t>(b));
+  block_m_ = std::min(m, block);
+  block_n_ = std::min(n, block);
+}
+
+template <typename T>
+Result OutOfCoreMatrixMultiplication<T>::Run() {
+  statistics_ = Statistics();
+
+  MappedFile a_file;
+  MappedFile b_file;
+  MappedFile c_file;
+  if (!a_file.OpenForRead(input_files_[0],
+                          static_cast<size_t>(m_) * k_ * sizeof(T)) ||
+      !b_file.OpenForRead(input_files_[1],
+                          static_cast<size_t>(k_) * n_ * sizeof(T)) ||
+      !c_file.OpenForWrite(output_file_,
+                           static_cast<size_t>(m_) * n_ * sizeof(T))) {
+    return Result::kFail;
+  }
+
+  std::vector<float> a_panel;
+  std::vector<float> b_panel;
+  std::vector<float> c_block;
+  const uint32_t k_panels = (k_ + block_k_ - 1) / block_k_;
+
+  // (row, K panel) of the A panel kept in |a_panel|.
+  int64_t a_panel_row = -1;
+  int64_t a_panel_index = -1;
+
+  for (uint32_t row = 0; row < m_; row += block_m_) {
+    const uint32_t rows = std::min(block_m_, m_ - row);
+    for (uint32_t col = 0, block_col = 0; col < n_;
+         col += block_n_, ++block_col) {
+      const uint32_t cols = std::min(block_n_, n_ - col);
+      c_block.assign(static_cast<size_t>(rows) * cols, 0.0f);
+
+      for (uint32_t step = 0; step < k_panels; ++step) {
+        const uint32_t panel =
+            (block_col % 2 == 0) ? step : k_panels - 1 - step;
+        const uint32_t k0 = panel * block_k_;
+        const uint32_t depth = std::min(block_k_, k_ - k0);
+
+        auto io_start = std::chrono::steady_clock::now();
+        if (a_panel_row != row || a_panel_index != panel) {
+          ReadPanel<T>(a_file, k_, row, rows, k0, depth, a_panel);
+          statistics_.bytes_read += static_cast<size_t>(rows) * depth *
+                                    sizeof(T);
+          a_panel_row = row;
+          a_panel_index = panel;
+        }
+        ReadPanel<T>(b_file, n_, k0, depth, col, cols, b_panel);
+        statistics_.bytes_read += static_cast<size_t>(depth) * cols *
+                                  sizeof(T);
+        statistics_.io_seconds += SecondsSince(io_start);
+
+        auto compute_start = std::chrono::steady_clock::now();
+        GemmParams params = {.m = rows,
+                             .n = cols,
+                             .k = depth,
+                             .lda = depth,
+                             .ldb = cols,
+                             .ldc = cols,
+                             .beta = 1.0f};
+        Gemm<float>(params, a_panel.data(), b_panel.data(), c_block.data());
+        statistics_.compute_seconds += SecondsSince(compute_start);
+        statistics_.flops += 2ull * rows * cols * depth;
+      }
+
+      auto io_start = std::chrono::steady_clock::now();
+      T* c = reinterpret_cast<T*>(c_file.GetData());
+      for (uint32_t i = 0; i < rows; ++i) {
+        T* dst = c + static_cast<size_t>(row + i) * n_ + col;
+        const float* src = c_block.data() + static_cast<size_t>(i) * cols;
+        for (uint32_t j = 0; j < cols; ++j) dst[j] = FromFloat<T>(src[j]);
+      }
+      statistics_.bytes_written += static_cast<size_t>(rows) * cols *
+                                   sizeof(T);
+      statistics_.io_seconds += SecondsSince(io_start);
+    }
+
+    // The block row of C is done.
+    auto io_start = std::chrono::steady_clock::now();
+    c_file.SyncAndRelease(static_cast<size_t>(row) * n_ * sizeof(T),
+                          static_cast<size_t>(rows) * n_ * sizeof(T));
+    statistics_.io_seconds += SecondsSince(io_start);
+  }
+
+  return Result::kSuccess;
+}
+
+template class OutOfCoreMatrixMultiplication<float>;
+template class OutOfCoreMatrixMultiplication<bfloat16>;
+
+} /* namespace tiny */
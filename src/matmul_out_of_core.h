@@ -0,0 +1,104 @@
+// Copyright (c) 2024 Jaebaek Seo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef matmul_out_of_core_h_
+#define matmul_out_of_core_h_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "blas_op.h"
+
+namespace tiny {
+
+/*
+ * Matrix multiplication between |m| by |k| matrix A and |k| by |n| matrix B
+ * whose operands and result do not have to fit in memory. A, B and C are
+ * files of row-major T elements (float or bfloat16) without any header.
+ *
+ * The files are memory-mapped. C is computed block by block: for each
+ * |block_m| by |block_n| block of C, panels of A (|block_m| by |block_k|) and
+ * B (|block_k| by |block_n|) are streamed from the mapped files, converted to
+ * float and multiplied with Gemm() into a float accumulator. The finished
+ * block is converted to T and written back to the C file. Pages of the
+ * mapped files are released right after use, so the resident memory stays
+ * around |memory_budget| bytes.
+ *
+ * Total bytes read are about |m|*|k|*ceil(|n|/|block_n|) + |k|*|n|*
+ * ceil(|m|/|block_m|), independent of |block_k|. So the planner uses a small
+ * |block_k| and spends the budget on square C blocks. The K panels are
+ * visited in a serpentine order (forward for even block columns, backward
+ * for odd ones), so the A panel that ends a block is reused to start the
+ * next block without being read again.
+ */
+template <typename T>
+class OutOfCoreMatrixMultiplication : BLASOp {
+ public:
+  struct Statistics {
+    size_t bytes_read = 0;
+    size_t bytes_written = 0;
+    double io_seconds = 0.0;
+    double compute_seconds = 0.0;
+    uint64_t flops = 0;
+
+    /* Throughputs in GB/s and GFLOP/s. */
+    double GetIOThroughput() const {
+      return io_seconds == 0.0
+                 ? 0.0
+                 : (bytes_read + bytes_written) / io_seconds * 1e-9;
+    }
+    double GetComputeThroughput() const {
+      return compute_seconds == 0.0 ? 0.0 : flops / compute_seconds * 1e-9;
+    }
+  };
+
+  OutOfCoreMatrixMultiplication(uint32_t m, uint32_t k, uint32_t n,
+                                size_t memory_budget);
+
+  /*
+   * |input0| and |input1| must exist. |output| is created (or truncated) by
+   * Run().
+   */
+  void SetFiles(const std::string& input0, const std::string& input1,
+                const std::string& output) {
+    input_files_[0] = input0;
+    input_files_[1] = input1;
+    output_file_ = output;
+  }
+
+  /* Returns kFail when a file cannot be opened or mapped. */
+  Result Run();
+
+  const Statistics& GetStatistics() const { return statistics_; }
+
+  uint32_t GetBlockM() const { return block_m_; }
+  uint32_t GetBlockN() const { return block_n_; }
+  uint32_t GetBlockK() const { return block_k_; }
+
+ private:
+  uint32_t m_;
+  uint32_t k_;
+  uint32_t n_;
+  uint32_t block_m_;
+  uint32_t block_n_;
+  uint32_t block_k_;
+  std::string input_files_[2];
+  std::string output_file_;
+  Statistics statistics_;
+};
+
+} /* namespace tiny */
+
+#endif /* ifndef matmul_out_of_core_h_ */
@@ -0,0 +1,111 @@
+// Copyright (c) 2024 Jaebaek Seo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "matmul_split_k.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "autotune.h"
+#include "epilogue.h"
+#include "matmul_cpu.h"
+#include "parallel.h"
+#include "tt_metal/common/bfloat16.hpp"
+#include "utils.h"
+
+namespace tiny {
+
+SplitKPlan PlanSplitK(uint32_t m, uint32_t k, uint32_t n,
+                      uint32_t num_workers) {
+  const uint32_t output_tiles = ((m + TileHeight() - 1) / TileHeight()) *
+                                ((n + TileWidth() - 1) / TileWidth());
+  const uint32_t min_chunk = ReductionChunkSize();
+
+  uint32_t split = 1;
+  if (output_tiles < num_workers) {
+    split = (num_workers + output_tiles - 1) / output_tiles;
+    split = std::max(1u, std::min(split, k / min_chunk));
+  }
+
+  uint32_t chunk = (k + split - 1) / split;
+  if (split > 1) {
+    if (IsDeterministicReduction()) {
+      uint32_t aligned = min_chunk;
+      while (aligned < chunk) aligned *= 2;
+      chunk = aligned;
+    } else {
+      chunk = (chunk + min_chunk - 1) / min_chunk * min_chunk;
+    }
+    split = (k + chunk - 1) / chunk;
+  }
+
+  return {.split_k = split,
+          .chunk_k = chunk,
+          .workers_per_split = std::max(1u, num_workers / split)};
+}
+
+template <typename T>
+CPUSplitKMatrixMultiplication<T>::CPUSplitKMatrixMultiplication(uint32_t m,
+                                                                uint32_t k,
+                                                                uint32_t n)
+    : m_(m), k_(k), n_(n), plan_(PlanSplitK(m, k, n,
+                                            GetNumberOfHostThreads())) {}
+
+template <typename T>
+Result CPUSplitKMatrixMultiplication<T>::Run() {
+  assert(!inputs_[0]->IsTilized());
+  assert(!inputs_[1]->IsTilized());
+
+  const T* a = inputs_[0]->GetVector().data();
+  const T* b = inputs_[1]->GetVector().data();
+  T* c = output_->GetVector().data();
+
+  // Each slice stores its float accumulators to its partial output through
+  // an epilogue, so that bfloat16 partial sums are not rounded.
+  std::vector<float> result(static_cast<size_t>(m_) * n_);
+  ParallelReduce(
+      plan_.split_k, result.size(),
+      [&](uint32_t slice, float* partial) {
+        const uint32_t k0 = slice * plan_.chunk_k;
+        if (k0 >= k_) return;
+        GemmParams params = {.m = m_,
+                             .n = n_,
+                             .k = std::min(plan_.chunk_k, k_ - k0),
+                             .lda = k_,
+                             .ldb = n_,
+                             .ldc = n_};
+        CPUGemmConfig config =
+            GetCPUGemmConfig(ClassifyGemmShape(m_, n_, params.k));
+        config.num_threads = plan_.workers_per_split;
+
+        Epilogue store;
+        store.SetOutput(partial, n_);
+        GemmWithConfig<T>(params, config, a + k0,
+                          b + static_cast<size_t>(k0) * n_, c, &store);
+      },
+      result.data());
+
+  const Epilogue* epilogue = epilogue_.get();
+  ParallelFor(m_, [&](uint32_t i) {
+    const size_t offset = static_cast<size_t>(i) * n_;
+    StoreTileRow<T>(epilogue, i, 0, result.data() + offset, n_, c + offset);
+  });
+
+  return Result::kSuccess;
+}
+
+template class CPUSplitKMatrixMultiplication<float>;
+template class CPUSplitKMatrixMultiplication<bfloat16>;
+
+} /* namespace tiny */
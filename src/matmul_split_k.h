@@ -0,0 +1,103 @@
+// Copyright (c) 2024 Jaebaek Seo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef matmul_split_k_h_
+#define matmul_split_k_h_
+
+#include <cassert>
+#include <cstdint>
+#include <memory>
+
+#include "blas_op.h"
+#include "buffer.h"
+
+namespace tiny {
+
+/*
+ * Split-K work plan of |m| by |k| times |k| by |n| matrix multiplication.
+ *
+ * When the output is too small to give every worker (a core or a host
+ * thread) its own output tiles, K is divided into |split_k| slices of
+ * |chunk_k| (the last one can be shorter). Each slice produces a partial |m|
+ * by |n| output on |workers_per_split| workers, and the partial outputs are
+ * summed at the end.
+ */
+struct SplitKPlan {
+  uint32_t split_k;
+  uint32_t chunk_k;
+  uint32_t workers_per_split;
+};
+
+/*
+ * Chooses the split factor for |num_workers| workers. Output tiles
+ * (TileHeight() by TileWidth()) are the unit of the work, so K is split only
+ * when there are fewer output tiles than workers, and only as much as needed
+ * to give each worker some work. A slice has at least ReductionChunkSize()
+ * elements of K (a multiple of it), because each slice costs an extra
+ * partial output to write and reduce. In the deterministic reduction mode,
+ * |chunk_k| is ReductionChunkSize() times a power of two, so that the
+ * reduction of the slices follows the same pairwise tree as an unsplit
+ * Gemm().
+ */
+SplitKPlan PlanSplitK(uint32_t m, uint32_t k, uint32_t n,
+                      uint32_t num_workers);
+
+/*
+ * Split-K matrix multiplication on host threads. The slices of the plan run
+ * in parallel with Gemm() into float partial outputs, which are reduced with
+ * a SIMD pairwise reduction (see ParallelReduce()). The epilogue is applied
+ * once to the reduced output.
+ */
+template <typename T>
+class CPUSplitKMatrixMultiplication : BLASOp {
+ public:
+  CPUSplitKMatrixMultiplication(uint32_t m, uint32_t k, uint32_t n);
+
+  Result Run();
+
+  using BLASOp::SetEpilogue;
+
+  const SplitKPlan& GetPlan() const { return plan_; }
+
+  /* Overrides the plan chosen by PlanSplitK(). */
+  void SetPlan(const SplitKPlan& plan) {
+    assert(plan.split_k > 0 && plan.chunk_k > 0);
+    assert(static_cast<uint64_t>(plan.split_k) * plan.chunk_k >= k_);
+    plan_ = plan;
+  }
+
+  void SetBuffers(std::shared_ptr<Buffer<T>> input0,
+                  std::shared_ptr<Buffer<T>> input1,
+                  std::shared_ptr<Buffer<T>> output) {
+    assert(input0->GetNumberOfElements() == m_ * k_);
+    assert(input1->GetNumberOfElements() == k_ * n_);
+    assert(output->GetNumberOfElements() == m_ * n_);
+
+    inputs_[0] = input0;
+    inputs_[1] = input1;
+    output_ = output;
+  }
+
+ private:
+  uint32_t m_;
+  uint32_t k_;
+  uint32_t n_;
+  SplitKPlan plan_;
+  std::shared_ptr<Buffer<T>> inputs_[2];
+  std::shared_ptr<Buffer<T>> output_;
+};
+
+} /* namespace tiny */
+
+#endif /* ifndef matmul_split_k_h_ */
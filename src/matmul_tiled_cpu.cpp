@@ -0,0 +1,130 @@
+// Copyright (c) 2024 Jaebaek Seo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "matmul_tiled_cpu.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "parallel.h"
+#include "tt_metal/common/bfloat16.hpp"
+
+namespace {
+
+/*
+ * Number of consecutive output tiles in a work item. It is a 4 by 4 block of
+ * tiles in TileOrder::kMorton.
+ */
+static constexpr uint32_t kTilesPerItemCPU = 16;
+
+/*
+ * Converts a tile in the layout of TilizeForTTDevice() to |rows| (a
+ * row-major float tile) and back.
+ */
+template <typename T>
+void UnpackTile(const T* tile, float* rows) {
+  tiny::ForEachElementOnTile(0, tiny::TileWidth(), [&](uint32_t i, uint32_t j) {
+    rows[i] = tiny::ToFloat<T>(tile[j]);
+  });
+}
+
+template <typename T>
+void PackTile(const float* rows, T* tile) {
+  tiny::ForEachElementOnTile(0, tiny::TileWidth(), [&](uint32_t i, uint32_t j) {
+    tile[j] = tiny::FromFloat<T>(rows[i]);
+  });
+}
+
+/* Returns the index of each tile (in row-major) in the storage order. */
+std::vector<uint32_t> GetTilePositions(uint32_t tiles_per_row,
+                                       uint32_t tiles_per_column,
+                                       tiny::TileOrder order) {
+  std::vector<uint32_t> sequence =
+      tiny::GetTileSequence(tiles_per_row, tiles_per_column, order);
+  std::vector<uint32_t> positions(sequence.size());
+  for (uint32_t i = 0; i < sequence.size(); ++i) positions[sequence[i]] = i;
+  return positions;
+}
+
+} /* namespace */
+
+namespace tiny {
+
+template <typename T>
+Result CPUTiledMatrixMultiplication<T>::Run() {
+  assert(inputs_[0]->IsTilized());
+  assert(inputs_[1]->IsTilized());
+
+  const uint32_t tile_w = TileWidth();
+  const uint32_t tile_h = TileHeight();
+  const size_t tile_size = tile_w * tile_h;
+  const uint32_t tiles_m = m_ / tile_h;
+  const uint32_t tiles_k = k_ / tile_w;
+  const uint32_t tiles_n = n_ / tile_w;
+
+  const std::vector<uint32_t> a_positions =
+      GetTilePositions(tiles_k, tiles_m, inputs_[0]->GetTileOrder());
+  const std::vector<uint32_t> b_positions =
+      GetTilePositions(tiles_n, tiles_k, inputs_[1]->GetTileOrder());
+  const std::vector<uint32_t> c_sequence =
+      GetTileSequence(tiles_n, tiles_m, output_order_);
+
+  const T* a = inputs_[0]->GetVector().data();
+  const T* b = inputs_[1]->GetVector().data();
+  T* c = output_->GetVector().data();
+
+  const uint32_t items =
+      (c_sequence.size() + kTilesPerItemCPU - 1) / kTilesPerItemCPU;
+  ParallelFor(items, [&](uint32_t item) {
+    thread_local std::vector<float> a_tile, b_tile, c_tile;
+    a_tile.resize(tile_size);
+    b_tile.resize(tile_size);
+    c_tile.resize(tile_size);
+
+    const uint32_t end = std::min<uint32_t>((item + 1) * kTilesPerItemCPU,
+                                            c_sequence.size());
+    for (uint32_t position = item * kTilesPerItemCPU; position < end;
+         ++position) {
+      const uint32_t tile_row = c_sequence[position] / tiles_n;
+      const uint32_t tile_col = c_sequence[position] % tiles_n;
+
+      std::fill(c_tile.begin(), c_tile.end(), 0.0f);
+      for (uint32_t kt = 0; kt < tiles_k; ++kt) {
+        UnpackTile<T>(a + a_positions[tile_row * tiles_k + kt] * tile_size,
+                      a_tile.data());
+        UnpackTile<T>(b + b_positions[kt * tiles_n + tile_col] * tile_size,
+                      b_tile.data());
+        for (uint32_t i = 0; i < tile_h; ++i) {
+          float* c_row = c_tile.data() + i * tile_w;
+          for (uint32_t kk = 0; kk < tile_w; ++kk) {
+            const float a_value = a_tile[i * tile_w + kk];
+            const float* b_row = b_tile.data() + kk * tile_w;
+            for (uint32_t j = 0; j < tile_w; ++j) {
+              c_row[j] += tiny::MultiplyAsFloat<T>(a_value, b_row[j]);
+            }
+          }
+        }
+      }
+      PackTile<T>(c_tile.data(), c + position * tile_size);
+    }
+  });
+
+  output_->SetTilized(output_order_);
+  return Result::kSuccess;
+}
+
+template class CPUTiledMatrixMultiplication<float>;
+template class CPUTiledMatrixMultiplication<bfloat16>;
+
+} /* namespace tiny */
@@ -0,0 +1,76 @@
+// Copyright (c) 2024 Jaebaek Seo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef matmul_tiled_cpu_h_
+#define matmul_tiled_cpu_h_
+
+#include <cassert>
+#include <cstdint>
+#include <memory>
+
+#include "blas_op.h"
+#include "buffer.h"
+#include "utils.h"
+
+namespace tiny {
+
+/*
+ * Matrix multiplication between tilized |m| by |k| matrix and tilized |k| by
+ * |n| matrix on host threads, without untilizing them. |m|, |k| and |n| must
+ * be multiples of the tile size. The inputs can be in either tile order (see
+ * TileOrder), and the output is written tilized in |output_order|.
+ *
+ * Output tiles are computed in their storage order, and each work item is a
+ * run of consecutive output tiles. With TileOrder::kMorton, a run is a
+ * square block of tiles, so the tiles of the inputs it reads are reused
+ * within the run and stay in cache. A tile is multiplied as a whole, with
+ * its four sub-tiles unpacked into a row-major float tile first.
+ */
+template <typename T>
+class CPUTiledMatrixMultiplication : BLASOp {
+ public:
+  CPUTiledMatrixMultiplication(uint32_t m, uint32_t k, uint32_t n,
+                               TileOrder output_order = TileOrder::kMorton)
+      : m_(m), k_(k), n_(n), output_order_(output_order) {
+    assert(m % TileHeight() == 0);
+    assert(k % TileWidth() == 0 && k % TileHeight() == 0);
+    assert(n % TileWidth() == 0);
+  }
+
+  Result Run();
+
+  void SetBuffers(std::shared_ptr<Buffer<T>> input0,
+                  std::shared_ptr<Buffer<T>> input1,
+                  std::shared_ptr<Buffer<T>> output) {
+    assert(input0->GetNumberOfElements() == m_ * k_);
+    assert(input1->GetNumberOfElements() == k_ * n_);
+    assert(output->GetNumberOfElements() == m_ * n_);
+
+    inputs_[0] = input0;
+    inputs_[1] = input1;
+    output_ = output;
+  }
+
+ private:
+  uint32_t m_;
+  uint32_t k_;
+  uint32_t n_;
+  TileOrder output_order_;
+  std::shared_ptr<Buffer<T>> inputs_[2];
+  std::shared_ptr<Buffer<T>> output_;
+};
+
+} /* namespace tiny */
+
+#endif /* ifndef matmul_tiled_cpu_h_ */
@@ -0,0 +1,182 @@
+// Copyright (c) 2024 Jaebaek Seo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "matmul_verify.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <random>
+
+#include "parallel.h"
+#include "tt_metal/common/bfloat16.hpp"
+#include "utils.h"
+
+namespace {
+
+/* Element-wise tolerance (absolute or relative) of an output element. */
+template <typename T>
+double GetElementTolerance() {
+  return 0.008;
+}
+
+template <>
+double GetElementTolerance<bfloat16>() {
+  return 0.04;
+}
+
+/* Chance that a correct output row fails a single probe. */
+static constexpr double kFalseRejectProbabilityCPU = 1e-9;
+
+} /* namespace */
+
+namespace tiny {
+
+template <typename T>
+MatrixMultiplicationCheck VerifyMatrixMultiplication(
+    std::shared_ptr<Buffer<T>> a, std::shared_ptr<Buffer<T>> b,
+    std::shared_ptr<Buffer<T>> c, uint32_t m, uint32_t k, uint32_t n,
+    double false_accept_probability, uint32_t seed) {
+  assert(a->GetNumberOfElements() == m * k);
+  assert(b->GetNumberOfElements() == k * n);
+  assert(c->GetNumberOfElements() == m * n);
+  assert(!a->IsTilized() && !b->IsTilized() && !c->IsTilized());
+  assert(false_accept_probability > 0.0 && false_accept_probability < 1.0);
+
+  const T* a_data = a->GetVector().data();
+  const T* b_data = b->GetVector().data();
+  const T* c_data = c->GetVector().data();
+  const double tolerance = GetElementTolerance<T>();
+
+  MatrixMultiplicationCheck check;
+  check.rounds = static_cast<uint32_t>(
+      std::ceil(std::log2(1.0 / false_accept_probability)));
+
+  // By Hoeffding's inequality, sum_j e_j * r_j with |e_j| <= bound_j and
+  // random signs r_j exceeds z * sqrt(sum_j bound_j^2) with probability at
+  // most 2 * exp(-z^2 / 2). bound_j = tolerance * max(1, (|A||B|)_ij) comes
+  // from the inputs only, so a wrong element of C cannot widen its own bound.
+  // sum_j (|A||B|)_ij^2 is at most (sum_l |a_il| * ||b_l||)^2, where b_l is
+  // row l of B.
+  const double z = std::sqrt(2.0 * std::log(2.0 / kFalseRejectProbabilityCPU));
+  std::vector<double> b_row_norms(k);
+  ParallelFor(k, [&](uint32_t l) {
+    double sum = 0.0;
+    for (uint32_t j = 0; j < n; ++j) {
+      const double value = ToFloat(b_data[l * n + j]);
+      sum += value * value;
+    }
+    b_row_norms[l] = std::sqrt(sum);
+  });
+
+  // Not std::vector<bool>, whose elements cannot be set from many threads.
+  std::vector<uint8_t> bad_row(m, 0);
+  std::vector<double> thresholds(m);
+  ParallelFor(m, [&](uint32_t i) {
+    double magnitude = 0.0;
+    for (uint32_t l = 0; l < k; ++l) {
+      magnitude += std::fabs(ToFloat(a_data[i * k + l])) * b_row_norms[l];
+    }
+    thresholds[i] = z * tolerance * std::sqrt(n + magnitude * magnitude);
+    // A non-finite element is wrong whatever the probes say.
+    for (uint32_t j = 0; j < n; ++j) {
+      if (!std::isfinite(ToFloat(c_data[i * n + j]))) {
+        bad_row[i] = 1;
+        break;
+      }
+    }
+  });
+
+  std::mt19937 generator(seed);
+  std::bernoulli_distribution coin(0.5);
+  std::vector<double> r(n);
+  std::vector<double> br(k);
+  for (uint32_t round = 0; round < check.rounds; ++round) {
+    for (uint32_t j = 0; j < n; ++j) r[j] = coin(generator) ? 1.0 : -1.0;
+
+    ParallelFor(k, [&](uint32_t l) {
+      double sum = 0.0;
+      for (uint32_t j = 0; j < n; ++j) sum += ToFloat(b_data[l * n + j]) * r[j];
+      br[l] = sum;
+    });
+
+    ParallelFor(m, [&](uint32_t i) {
+      double abr = 0.0;
+      for (uint32_t l = 0; l < k; ++l) {
+        abr += ToFloat(a_data[i * k + l]) * br[l];
+      }
+      double cr = 0.0;
+      for (uint32_t j = 0; j < n; ++j) cr += ToFloat(c_data[i * n + j]) * r[j];
+      // NaN fails the comparison as well.
+      if (!(std::fabs(abr - cr) <= thresholds[i])) bad_row[i] = 1;
+    });
+  }
+
+  for (uint32_t i = 0; i < m; ++i) {
+    if (bad_row[i]) check.bad_rows.push_back(i);
+  }
+  check.passed = check.bad_rows.empty();
+
+  // Localize the bad rows to tiles by recomputing them.
+  const uint32_t num_localized_rows = std::min(
+      static_cast<uint32_t>(check.bad_rows.size()), kMaxLocalizedRowsCPU);
+  const uint32_t tiles_per_row = (n + TileWidth() - 1) / TileWidth();
+  std::vector<std::vector<bool>> bad_tiles_of_row(
+      num_localized_rows, std::vector<bool>(tiles_per_row, false));
+  ParallelFor(num_localized_rows, [&](uint32_t index) {
+    const uint32_t i = check.bad_rows[index];
+    std::vector<double> row(n, 0.0);
+    std::vector<double> magnitudes(n, 0.0);
+    for (uint32_t l = 0; l < k; ++l) {
+      const double value = ToFloat(a_data[i * k + l]);
+      for (uint32_t j = 0; j < n; ++j) {
+        const double product = value * ToFloat(b_data[l * n + j]);
+        row[j] += product;
+        magnitudes[j] += std::fabs(product);
+      }
+    }
+    for (uint32_t j = 0; j < n; ++j) {
+      // NaN and infinite elements fail the comparison as well.
+      const double error = std::fabs(row[j] - ToFloat(c_data[i * n + j]));
+      if (!(error <= tolerance * std::max(1.0, magnitudes[j]))) {
+        bad_tiles_of_row[index][j / TileWidth()] = true;
+      }
+    }
+  });
+
+  for (uint32_t index = 0; index < num_localized_rows; ++index) {
+    const uint32_t tile_row = check.bad_rows[index] / TileHeight();
+    for (uint32_t tile_col = 0; tile_col < tiles_per_row; ++tile_col) {
+      if (bad_tiles_of_row[index][tile_col]) {
+        check.bad_tiles.push_back({tile_row, tile_col});
+      }
+    }
+  }
+  std::sort(check.bad_tiles.begin(), check.bad_tiles.end());
+  check.bad_tiles.erase(
+      std::unique(check.bad_tiles.begin(), check.bad_tiles.end()),
+      check.bad_tiles.end());
+  return check;
+}
+
+template MatrixMultiplicationCheck VerifyMatrixMultiplication<float>(
+    std::shared_ptr<Buffer<float>> a, std::shared_ptr<Buffer<float>> b,
+    std::shared_ptr<Buffer<float>> c, uint32_t m, uint32_t k, uint32_t n,
+    double false_accept_probability, uint32_t seed);
+template MatrixMultiplicationCheck VerifyMatrixMultiplication<bfloat16>(
+    std::shared_ptr<Buffer<bfloat16>> a, std::shared_ptr<Buffer<bfloat16>> b,
+    std::shared_ptr<Buffer<bfloat16>> c, uint32_t m, uint32_t k, uint32_t n,
+    double false_accept_probability, uint32_t seed);
+
+} /* namespace tiny */
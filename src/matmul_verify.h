@@ -0,0 +1,80 @@
+// Copyright (c) 2024 Jaebaek Seo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef matmul_verify_h_
+#define matmul_verify_h_
+
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "buffer.h"
+
+namespace tiny {
+
+/* Result of VerifyMatrixMultiplication(). */
+struct MatrixMultiplicationCheck {
+  bool passed = true;
+
+  /* Number of random probes used. */
+  uint32_t rounds = 0;
+
+  /* Output rows that failed a probe, in ascending order. */
+  std::vector<uint32_t> bad_rows;
+
+  /*
+   * (tile row, tile column) of the output tiles that have an element out of
+   * the tolerance, in ascending order. Only the first
+   * kMaxLocalizedRowsCPU of |bad_rows| are localized to tiles.
+   */
+  std::vector<std::pair<uint32_t, uint32_t>> bad_tiles;
+};
+
+static constexpr uint32_t kMaxLocalizedRowsCPU = 256;
+
+/*
+ * Checks that the row-major |m| by |n| matrix |c| is the product of the |m| by
+ * |k| matrix |a| and the |k| by |n| matrix |b| with Freivalds' algorithm,
+ * without computing the product.
+ *
+ * Each round draws a random vector r of +1 and -1 and compares A(Br) with Cr,
+ * which costs O(mk + kn + mn) instead of O(mkn). When a row of C is wrong,
+ * the row of Cr misses the error with probability at most 1/2, so
+ * ceil(log2(1 / |false_accept_probability|)) rounds are used.
+ *
+ * Elements of C may differ from the exact product by the same tolerance as
+ * the element-wise comparison of the tests (0.008 for float and 0.04 for
+ * bfloat16), absolute or relative to (|A||B|)_ij = sum_l |a_il||b_lj|. The
+ * bounds depend only on A and B, so a huge or non-finite element of C cannot
+ * widen its own bound, and rows with a non-finite element always fail. With
+ * random signs, the rounding errors of a correct row sum to a small multiple
+ * of their norm, so a row fails only when its error is beyond that bound
+ * (the chance that a correct row fails is below 1e-9 per round). An error on
+ * a single element must therefore be larger than about sqrt(n) times the
+ * element tolerance to be caught; use the full reference when finer
+ * differences matter.
+ *
+ * The rows that fail are localized to output tiles by recomputing only those
+ * rows exactly.
+ */
+template <typename T>
+MatrixMultiplicationCheck VerifyMatrixMultiplication(
+    std::shared_ptr<Buffer<T>> a, std::shared_ptr<Buffer<T>> b,
+    std::shared_ptr<Buffer<T>> c, uint32_t m, uint32_t k, uint32_t n,
+    double false_accept_probability = 1e-6, uint32_t seed = 0);
+
+} /* namespace tiny */
+
+#endif /* ifndef matmul_verify_h_ */
@@ -0,0 +1,139 @@
+// Copyright (c) 2024 Jaebaek Seo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+namespace tiny {
+
+namespace {
+
+/* Number of floats of a work item of the parallel PairwiseReduce(). */
+static constexpr size_t kReductionSliceWidth = 4096;
+
+std::atomic<uint32_t> num_threads_override(0);
+
+std::atomic<bool> deterministic_reduction([] {
+  const char* env = std::getenv("TINY_DETERMINISTIC_REDUCTION");
+  return env != nullptr && std::atoi(env) == 1;
+}());
+
+/* |dst|[j] += |src|[j] for j in [0, |count|). */
+inline void AddFloats(float* dst, const float* src, size_t count) {
+  size_t j = 0;
+#if defined(__AVX512F__)
+  for (; j + 16 <= count; j += 16) {
+    _mm512_storeu_ps(dst + j, _mm512_add_ps(_mm512_loadu_ps(dst + j),
+                                            _mm512_loadu_ps(src + j)));
+  }
+#elif defined(__AVX__)
+  for (; j + 8 <= count; j += 8) {
+    _mm256_storeu_ps(dst + j, _mm256_add_ps(_mm256_loadu_ps(dst + j),
+                                            _mm256_loadu_ps(src + j)));
+  }
+#endif
+  for (; j < count; ++j) dst[j] += src[j];
+}
+
+/*
+ * PairwiseReduce() of elements [|begin|, |end|) of each of |count| partials.
+ */
+void PairwiseReduceRange(float* partials, uint32_t count, size_t width,
+                         size_t begin, size_t end) {
+  for (uint32_t step = 1; step < count; step *= 2) {
+    for (uint32_t i = step; i < count; i += 2 * step) {
+      AddFloats(partials + (i - step) * width + begin,
+                partials + i * width + begin, end - begin);
+    }
+  }
+}
+
+} /* namespace */
+
+uint32_t GetNumberOfHostThreads() {
+  static const uint32_t num_threads = []() -> uint32_t {
+    const char* env = std::getenv("TINY_NUM_THREADS");
+    if (env != nullptr && std::atoi(env) > 0) return std::atoi(env);
+    return std::max(1u, std::thread::hardware_concurrency());
+  }();
+  uint32_t override = num_threads_override;
+  return override != 0 ? override : num_threads;
+}
+
+void SetNumberOfHostThreads(uint32_t num_threads) {
+  num_threads_override = num_threads;
+}
+
+void ParallelFor(uint32_t count, const std::function<void(uint32_t)>& func,
+                 uint32_t num_threads) {
+  if (num_threads == 0) num_threads = GetNumberOfHostThreads();
+  num_threads = std::min(num_threads, count);
+
+  if (num_threads <= 1) {
+    for (uint32_t i = 0; i < count; ++i) func(i);
+    return;
+  }
+
+  std::atomic<uint32_t> next_item(0);
+  auto worker = [&]() {
+    for (uint32_t i = next_item++; i < count; i = next_item++) func(i);
+  };
+
+  // The calling thread works as one of the workers.
+  std::vector<std::thread> threads;
+  for (uint32_t i = 1; i < num_threads; ++i) threads.emplace_back(worker);
+  worker();
+  for (auto& thread : threads) thread.join();
+}
+
+void SetDeterministicReduction(bool enable) {
+  deterministic_reduction = enable;
+}
+
+bool IsDeterministicReduction() { return deterministic_reduction; }
+
+void PairwiseReduce(float* partials, uint32_t count, size_t width) {
+  PairwiseReduceRange(partials, count, width, 0, width);
+}
+
+void ParallelReduce(uint32_t count, size_t width,
+                    const std::function<void(uint32_t, float*)>& func,
+                    float* result) {
+  std::vector<float> partials(count * width, 0.0f);
+  ParallelFor(count, [&](uint32_t chunk) {
+    func(chunk, partials.data() + chunk * width);
+  });
+
+  // Elements are independent, so slices of all partials are reduced in
+  // parallel, each with the same tree.
+  const uint32_t slices =
+      (width + kReductionSliceWidth - 1) / kReductionSliceWidth;
+  ParallelFor(slices, [&](uint32_t slice) {
+    const size_t begin = slice * kReductionSliceWidth;
+    PairwiseReduceRange(partials.data(), count, width, begin,
+                        std::min(begin + kReductionSliceWidth, width));
+  });
+  std::copy_n(partials.data(), width, result);
+}
+
+} /* namespace tiny */
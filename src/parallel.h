@@ -0,0 +1,87 @@
+// Copyright (c) 2024 Jaebaek Seo.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef parallel_h_
+#define parallel_h_
+
+#include <cstdint>
+#include <functional>
+
+namespace tiny {
+
+/*
+ * Returns the number of host threads used by CPU ops. It is
+ * std::thread::hardware_concurrency() unless TINY_NUM_THREADS environment
+ * variable is set.
+ */
+uint32_t GetNumberOfHostThreads();
+
+/*
+ * Overrides the number of host threads e.g., to compare results between
+ * different numbers of threads. 0 restores the default.
+ */
+void SetNumberOfHostThreads(uint32_t num_threads);
+
+/*
+ * Calls |func(i)| for every i in [0, |count|) on up to |num_threads| host
+ * threads. Work items are handed out one by one, so items with uneven costs
+ * are still balanced. |num_threads| = 0 means GetNumberOfHostThreads().
+ */
+void ParallelFor(uint32_t count, const std::function<void(uint32_t)>& func,
+                 uint32_t num_threads = 0);
+
+/*
+ * Deterministic reduction mode. Float additions are not associative, so a sum
+ * depends on the order of its terms. In this mode, every reduction over a
+ * long dimension (e.g., K of GEMM) uses the same fixed order:
+ *
+ *  1. The dimension is split into chunks of ReductionChunkSize() elements.
+ *     The size does not depend on the number of threads or on how the work
+ *     is split between them.
+ *  2. Each chunk is summed sequentially from zero.
+ *  3. The chunk sums are combined with PairwiseReduce().
+ *
+ * So a result is bitwise identical no matter how many threads compute it or
+ * whether the chunks are computed by different threads (e.g., split-K). It
+ * is disabled by default unless TINY_DETERMINISTIC_REDUCTION environment
+ * variable is set to 1.
+ */
+void SetDeterministicReduction(bool enable);
+
+bool IsDeterministicReduction();
+
+inline uint32_t ReductionChunkSize() { return 256; }
+
+/*
+ * Reduces |count| partial results of |width| floats stored back to back in
+ * |partials| into the first one, with a fixed pairwise tree. On level l
+ * (starting from 0), partial i is added to partial i - 2^l for every i that
+ * is an odd multiple of 2^l, e.g., ((p0 + p1) + (p2 + p3)) + p4 for 5
+ * partials. The order depends only on |count|.
+ */
+void PairwiseReduce(float* partials, uint32_t count, size_t width);
+
+/*
+ * Calls |func(chunk, partial)| for every chunk in [0, |count|) on host
+ * threads, where |partial| is |width| floats initialized to zeros, and writes
+ * their PairwiseReduce() to |result|. The result is bitwise identical for any
+ * number of threads.
+ */
+void ParallelReduce(uint32_t count, size_t width,
+                    const std::function<void(uint32_t, float*)>& func,
+                    float* result);
+
+} /* namespace tiny */
+
+#endif /* ifndef parallel_h_ */
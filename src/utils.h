@@ -15,7 +15,9 @@
 #ifndef utils_h
 #define utils_h
 
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
 #include <vector>
 
 #include "tt_metal/host_api.hpp"
@@ -33,6 +35,96 @@ inline uint32_t SingleTileSize() {
   return sizeof(T) * TileWidth() * TileHeight();
 }
 
+/*
+ * Order of tiles in a tilized buffer.
+ *  - kRowMajor: tiles from left to right, and tile rows from top to bottom.
+ *  - kMorton: tiles in Z-order (Morton order) i.e., ordered by the code that
+ *    interleaves the bits of the tile column (even bits) and the tile row
+ *    (odd bits). Each 2^l by 2^l block of tiles is contiguous, so a blocked
+ *    or recursive kernel that walks a block column does not stride across
+ *    whole tile rows. When the number of tile rows or columns is not a power
+ *    of two, the missing codes are skipped.
+ */
+enum class TileOrder {
+  kRowMajor,
+  kMorton,
+};
+
+inline uint64_t GetMortonCode(uint32_t tile_row, uint32_t tile_col) {
+  uint64_t code = 0;
+  for (uint32_t bit = 0; bit < 32; ++bit) {
+    code |= static_cast<uint64_t>((tile_col >> bit) & 1) << (2 * bit);
+    code |= static_cast<uint64_t>((tile_row >> bit) & 1) << (2 * bit + 1);
+  }
+  return code;
+}
+
+/*
+ * Returns the row-major index (tile_row * |tiles_per_row| + tile_col) of each
+ * tile in the order of |order|, for a matrix with |tiles_per_row| by
+ * |tiles_per_column| tiles.
+ */
+inline std::vector<uint32_t> GetTileSequence(uint32_t tiles_per_row,
+                                             uint32_t tiles_per_column,
+                                             TileOrder order) {
+  std::vector<uint32_t> sequence(tiles_per_row * tiles_per_column);
+  for (uint32_t i = 0; i < sequence.size(); ++i) sequence[i] = i;
+  if (order == TileOrder::kMorton) {
+    std::sort(sequence.begin(), sequence.end(),
+              [tiles_per_row](uint32_t tile0, uint32_t tile1) {
+                return GetMortonCode(tile0 / tiles_per_row,
+                                     tile0 % tiles_per_row) <
+                       GetMortonCode(tile1 / tiles_per_row,
+                                     tile1 % tiles_per_row);
+              });
+  }
+  return sequence;
+}
+
+/*
+ * Calls |func(i, j)| for every element of the tile whose left-top corner is
+ * element |left_top_corner_on_tile| of a row-major matrix with |width|
+ * columns, where i is the index of the element in the row-major matrix and
+ * j is its index in the tile.
+ */
+template <typename F>
+void ForEachElementOnTile(uint32_t left_top_corner_on_tile, uint32_t width,
+                          F&& func) {
+  // Width and height of a sub-tile in a single tile.
+  const uint32_t subTileWidth = TileWidth() / 2;
+  const uint32_t subTileHeight = TileHeight() / 2;
+
+  uint32_t index_on_tile = 0;
+
+  // Left-top sub-tile.
+  for (uint32_t r = 0; r < subTileHeight; r++) {
+    for (uint32_t c = 0; c < subTileWidth; c++) {
+      func(left_top_corner_on_tile + r * width + c, index_on_tile++);
+    }
+  }
+
+  // Right-top sub-tile.
+  for (uint32_t r = 0; r < subTileHeight; r++) {
+    for (uint32_t c = subTileWidth; c < TileWidth(); c++) {
+      func(left_top_corner_on_tile + r * width + c, index_on_tile++);
+    }
+  }
+
+  // Left-bottom sub-tile.
+  for (uint32_t r = subTileHeight; r < TileHeight(); r++) {
+    for (uint32_t c = 0; c < subTileWidth; c++) {
+      func(left_top_corner_on_tile + r * width + c, index_on_tile++);
+    }
+  }
+
+  // Right-bottom sub-tile.
+  for (uint32_t r = subTileHeight; r < TileHeight(); r++) {
+    for (uint32_t c = subTileWidth; c < TileWidth(); c++) {
+      func(left_top_corner_on_tile + r * width + c, index_on_tile++);
+    }
+  }
+}
+
 /*
  * For a given |height| by |width| matrix |buffer|, this function tilizes its
  * elements. The size of a tile on Tenstorrent Grayskull is 32x32. |height|
@@ -67,68 +159,35 @@ inline uint32_t SingleTileSize() {
  *  tilization. The hardware ISA (TT_OP_MOP) seems to require the 4
  *  sub-matrices of each tile.
  *
+ *  With |order| = TileOrder::kMorton, the tiles are placed in Z-order instead
+ *  of the row-major order above. Elements in each tile do not change.
+ *
  * Ref:
  *  https://github.com/tenstorrent/tt-llk-gs/blob/568714a19033ad55d0f6d5a525cdb0eadaaa7e1e/common/inc/ckernel_ops.h#L286
  *  https://github.com/tenstorrent/tt-metal/blob/1b415c3487fdc59e1f8301fd44ce1d1df1f8a0bf/tt_metal/programming_examples/matmul_multi_core/matmul_multi_core.cpp
  *  https://github.com/tenstorrent/tt-metal/blob/1b415c3487fdc59e1f8301fd44ce1d1df1f8a0bf/tt_metal/common/tilize_untilize.hpp
  */
 template <typename T>
-void TilizeForTTDevice(std::vector<T>& buffer, uint32_t width,
-                       uint32_t height) {
+void TilizeForTTDevice(std::vector<T>& buffer, uint32_t width, uint32_t height,
+                       TileOrder order = TileOrder::kRowMajor) {
   assert(buffer.size() == width * height);
   assert(width % TileWidth() == 0);
   assert(height % TileHeight() == 0);
 
   std::vector<T> tilized_buffer(buffer.size());
-  uint32_t tilized_buffer_index = 0;
-
-  // Width and height of a sub-tile in a single tile.
-  const uint32_t subTileWidth = TileWidth() / 2;
-  const uint32_t subTileHeight = TileHeight() / 2;
+  T* tile = tilized_buffer.data();
 
-  // Iterate tiles from the first row to the last row. Because of the tile size,
-  // the outer loop interates TileHeight() rows at once.
-  uint32_t elements_on_tile_row = width * TileHeight();
-  for (uint32_t next_tile = 0; next_tile < buffer.size();
-       next_tile += elements_on_tile_row) {
-    // Access tiles from left to right. The left-top corner element index of the
-    // first tile is |next_tile|.
-    uint32_t right_top_corner_on_last_tile_on_row = next_tile + width;
-    for (uint32_t left_top_corner_on_tile = next_tile;
-         left_top_corner_on_tile < right_top_corner_on_last_tile_on_row;
-         left_top_corner_on_tile += TileWidth()) {
-      // Left-top sub-tile.
-      for (uint32_t r = 0; r < subTileHeight; r++) {
-        for (uint32_t c = 0; c < subTileWidth; c++) {
-          uint32_t i = left_top_corner_on_tile + r * width + c;
-          tilized_buffer[tilized_buffer_index++] = buffer[i];
-        }
-      }
-
-      // Right-top sub-tile.
-      for (uint32_t r = 0; r < subTileHeight; r++) {
-        for (uint32_t c = subTileWidth; c < TileWidth(); c++) {
-          uint32_t i = left_top_corner_on_tile + r * width + c;
-          tilized_buffer[tilized_buffer_index++] = buffer[i];
-        }
-      }
-
-      // Left-bottom sub-tile.
-      for (uint32_t r = subTileHeight; r < TileHeight(); r++) {
-        for (uint32_t c = 0; c < subTileWidth; c++) {
-          uint32_t i = left_top_corner_on_tile + r * width + c;
-          tilized_buffer[tilized_buffer_index++] = buffer[i];
-        }
-      }
-
-      // Right-bottom sub-tile.
-      for (uint32_t r = subTileHeight; r < TileHeight(); r++) {
-        for (uint32_t c = subTileWidth; c < TileWidth(); c++) {
-          uint32_t i = left_top_corner_on_tile + r * width + c;
-          tilized_buffer[tilized_buffer_index++] = buffer[i];
-        }
-      }
-    }
+  // Access tiles in |order|. The left-top corner element index of a tile is
+  // computed from its tile row and tile column.
+  const uint32_t tiles_per_row = width / TileWidth();
+  for (uint32_t index : GetTileSequence(tiles_per_row, height / TileHeight(),
+                                        order)) {
+    uint32_t left_top_corner_on_tile =
+        (index / tiles_per_row) * TileHeight() * width +
+        (index % tiles_per_row) * TileWidth();
+    ForEachElementOnTile(left_top_corner_on_tile, width,
+                         [&](uint32_t i, uint32_t j) { tile[j] = buffer[i]; });
+    tile += TileWidth() * TileHeight();
   }
 
   buffer = std::move(tilized_buffer);
@@ -136,66 +195,73 @@ void TilizeForTTDevice(std::vector<T>& buffer, uint32_t width,
 
 template <typename T>
 void UnTilizeForTTDevice(std::vector<T>& buffer, uint32_t width,
-                         uint32_t height) {
+                         uint32_t height,
+                         TileOrder order = TileOrder::kRowMajor) {
   assert(buffer.size() == width * height);
   assert(width % TileWidth() == 0);
   assert(height % TileHeight() == 0);
 
   std::vector<T> untilized_buffer(buffer.size());
-  uint32_t tilized_buffer_index = 0;
-
-  // Width and height of a sub-tile in a single tile.
-  const uint32_t subTileWidth = TileWidth() / 2;
-  const uint32_t subTileHeight = TileHeight() / 2;
+  const T* tile = buffer.data();
 
-  // Iterate tiles from the first row to the last row. Because of the tile size,
-  // the outer loop interates TileHeight() rows at once.
-  uint32_t elements_on_tile_row = width * TileHeight();
-  for (uint32_t next_tile = 0; next_tile < buffer.size();
-       next_tile += elements_on_tile_row) {
-    // Access tiles from left to right. The left-top corner element index of the
-    // first tile is |next_tile|.
-    uint32_t right_top_corner_on_last_tile_on_row = next_tile + width;
-    for (uint32_t left_top_corner_on_tile = next_tile;
-         left_top_corner_on_tile < right_top_corner_on_last_tile_on_row;
-         left_top_corner_on_tile += TileWidth()) {
-      // Left-top sub-tile.
-      for (uint32_t r = 0; r < subTileHeight; r++) {
-        for (uint32_t c = 0; c < subTileWidth; c++) {
-          uint32_t i = left_top_corner_on_tile + r * width + c;
-          untilized_buffer[i] = buffer[tilized_buffer_index++];
-        }
-      }
-
-      // Right-top sub-tile.
-      for (uint32_t r = 0; r < subTileHeight; r++) {
-        for (uint32_t c = subTileWidth; c < TileWidth(); c++) {
-          uint32_t i = left_top_corner_on_tile + r * width + c;
-          untilized_buffer[i] = buffer[tilized_buffer_index++];
-        }
-      }
-
-      // Left-bottom sub-tile.
-      for (uint32_t r = subTileHeight; r < TileHeight(); r++) {
-        for (uint32_t c = 0; c < subTileWidth; c++) {
-          uint32_t i = left_top_corner_on_tile + r * width + c;
-          untilized_buffer[i] = buffer[tilized_buffer_index++];
-        }
-      }
-
-      // Right-bottom sub-tile.
-      for (uint32_t r = subTileHeight; r < TileHeight(); r++) {
-        for (uint32_t c = subTileWidth; c < TileWidth(); c++) {
-          uint32_t i = left_top_corner_on_tile + r * width + c;
-          untilized_buffer[i] = buffer[tilized_buffer_index++];
-        }
-      }
-    }
+  const uint32_t tiles_per_row = width / TileWidth();
+  for (uint32_t index : GetTileSequence(tiles_per_row, height / TileHeight(),
+                                        order)) {
+    uint32_t left_top_corner_on_tile =
+        (index / tiles_per_row) * TileHeight() * width +
+        (index % tiles_per_row) * TileWidth();
+    ForEachElementOnTile(
+        left_top_corner_on_tile, width,
+        [&](uint32_t i, uint32_t j) { untilized_buffer[i] = tile[j]; });
+    tile += TileWidth() * TileHeight();
   }
 
   buffer = std::move(untilized_buffer);
 }
 
+/* Conversions between an element of Buffer<T> and a float accumulator. */
+template <typename T>
+inline float ToFloat(const T& value) {
+  return static_cast<float>(value);
+}
+
+template <>
+inline float ToFloat<bfloat16>(const bfloat16& value) {
+  return value.to_float();
+}
+
+template <typename T>
+inline T FromFloat(float value) {
+  return static_cast<T>(value);
+}
+
+template <>
+inline bfloat16 FromFloat<bfloat16>(float value) {
+  return bfloat16(value);
+}
+
+/*
+ * Product of two elements of T, given as floats, to be accumulated in float.
+ * With bfloat16, the product is rounded to bfloat16 before the accumulation
+ * to follow the bfloat16 arithmetic of the device. CPU kernels that convert
+ * their operands to float ahead of the inner loop use it to agree with
+ * Gemm().
+ */
+template <typename T>
+inline float MultiplyAsFloat(float a, float b) {
+  return a * b;
+}
+
+template <>
+inline float MultiplyAsFloat<bfloat16>(float a, float b) {
+  return bfloat16(a * b).to_float();
+}
+
+template <typename T>
+inline float Multiply(const T& a, const T& b) {
+  return MultiplyAsFloat<T>(ToFloat<T>(a), ToFloat<T>(b));
+}
+
 template <typename T>
 tt::DataFormat GetDataFormat() {
   if (typeid(T) == typeid(bfloat16)) {
@@ -204,6 +270,8 @@ tt::DataFormat GetDataFormat() {
     return tt::DataFormat::Float32;
   } else if (typeid(T) == typeid(int)) {
     return tt::DataFormat::Int32;
+  } else if (typeid(T) == typeid(int8_t)) {
+    return tt::DataFormat::Int8;
   }
   return tt::DataFormat::Invalid;
 }